@@ -0,0 +1,319 @@
+/*
+    This file is part of libkleopatra's test suite.
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "fakeassuanserver.h"
+
+#include <Libkleo/Assuan>
+#include <Libkleo/AssuanCommand>
+#include <Libkleo/Test>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QObject>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QThread>
+
+#include <gpgme++/error.h>
+#include <gpgme++/global.h>
+
+#include <gpg-error.h>
+
+#include <memory>
+
+using namespace Kleo;
+using namespace std::chrono_literals;
+
+class AssuanCommandTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        mGnupgHome = std::make_unique<QTemporaryDir>();
+        QVERIFY(mGnupgHome->isValid());
+        qputenv("GNUPGHOME", mGnupgHome->path().toLocal8Bit());
+        GpgME::initializeLibrary();
+
+        // the fake server has to listen on the socket the Assuan engine of gpgme connects to
+        mSocketPath = QString::fromLocal8Bit(GpgME::dirInfo("agent-socket"));
+        if (mSocketPath.isEmpty()) {
+            QSKIP("The socket of the agent is unknown");
+        }
+        const QString socketDir = QFileInfo{mSocketPath}.absolutePath();
+        mCreatedSocketDir = !QFileInfo::exists(socketDir);
+        QVERIFY(QDir{}.mkpath(socketDir));
+    }
+
+    void cleanupTestCase()
+    {
+        if (mCreatedSocketDir) {
+            QDir{}.rmdir(QFileInfo{mSocketPath}.absolutePath());
+        }
+        mGnupgHome.reset();
+        qunsetenv("GNUPGHOME");
+    }
+
+    void init()
+    {
+        mServer = std::make_unique<FakeAssuanServer>();
+    }
+
+    void cleanup()
+    {
+        // the pooled connections would be connected to the server of the finished test
+        Assuan::closeIdleConnections();
+        mServer.reset();
+    }
+
+    void test_dataIsReturned()
+    {
+        mServer->setResponse("GETINFO version", {.data = "2.5.0"});
+        QVERIFY(mServer->listen(mSocketPath));
+
+        AssuanCommand command{"GETINFO version"};
+        command.setLaunchAgent(false);
+        QSignalSpy finishedSpy{&command, &AssuanCommand::finished};
+        command.start();
+        QVERIFY(command.isRunning());
+
+        QVERIFY(finishedSpy.wait());
+        QVERIFY(!command.isRunning());
+        QVERIFY(!command.error());
+        QCOMPARE(command.data(), "2.5.0");
+        QCOMPARE(mServer->receivedCommands(), QByteArrayList{"GETINFO version"});
+    }
+
+    void test_statusIsReturned()
+    {
+        mServer->setResponse("SCD GETATTR SERIALNO", {.statusLines = {{"SERIALNO", "D2760001240103040006123456780000"}}});
+        QVERIFY(mServer->listen(mSocketPath));
+
+        AssuanCommand command{"SCD GETATTR SERIALNO"};
+        command.setLaunchAgent(false);
+        QSignalSpy finishedSpy{&command, &AssuanCommand::finished};
+        command.start();
+
+        QVERIFY(finishedSpy.wait());
+        QVERIFY(!command.error());
+        QCOMPARE(command.statusLines().size(), 1);
+        QCOMPARE(command.status(), "D2760001240103040006123456780000");
+    }
+
+    void test_errorIsReported()
+    {
+        mServer->setResponse("SCD SERIALNO", {.errorCode = GPG_ERR_CARD_NOT_PRESENT});
+        QVERIFY(mServer->listen(mSocketPath));
+
+        AssuanCommand command{"SCD SERIALNO"};
+        command.setLaunchAgent(false);
+        QSignalSpy finishedSpy{&command, &AssuanCommand::finished};
+        command.start();
+
+        QVERIFY(finishedSpy.wait());
+        QCOMPARE(command.error().code(), GPG_ERR_CARD_NOT_PRESENT);
+    }
+
+    void test_connectionIsReused()
+    {
+        mServer->setResponse("SCD GETATTR SERIALNO", {.statusLines = {{"SERIALNO", "D2760001240103040006123456780000"}}});
+        mServer->setResponse("SCD GETATTR KEY-FPR", {.statusLines = {{"KEY-FPR", "1 0123456789ABCDEF0123456789ABCDEF01234567"}}});
+        mServer->setResponse("SCD SERIALNO", {.errorCode = GPG_ERR_CARD_NOT_PRESENT});
+        QVERIFY(mServer->listen(mSocketPath));
+
+        for (const auto cmd : {"SCD GETATTR SERIALNO", "SCD SERIALNO", "SCD GETATTR KEY-FPR"}) {
+            AssuanCommand command{cmd};
+            command.setLaunchAgent(false);
+            QSignalSpy finishedSpy{&command, &AssuanCommand::finished};
+            command.start();
+            QVERIFY(finishedSpy.wait());
+        }
+        // errors reported by the agent don't close the connection
+        QCOMPARE(mServer->receivedCommands().size(), 3);
+        QCOMPARE(mServer->connectionCount(), 1);
+
+        // after closing the idle connections a new connection is used
+        Assuan::closeIdleConnections();
+        AssuanCommand command{"SCD GETATTR SERIALNO"};
+        command.setLaunchAgent(false);
+        QSignalSpy finishedSpy{&command, &AssuanCommand::finished};
+        command.start();
+        QVERIFY(finishedSpy.wait());
+        QVERIFY(!command.error());
+        QCOMPARE(mServer->connectionCount(), 2);
+    }
+
+    void test_connectionIsResetBeforeReuse()
+    {
+        mServer->setResponse("OPTION ttyname=/dev/pts/1", {});
+        QVERIFY(mServer->listen(mSocketPath));
+
+        AssuanCommand command{"OPTION ttyname=/dev/pts/1"};
+        command.setLaunchAgent(false);
+        QSignalSpy finishedSpy{&command, &AssuanCommand::finished};
+        command.start();
+        QVERIFY(finishedSpy.wait());
+        QVERIFY(!command.error());
+        // the session state is reset before the connection is put back into the pool
+        QTRY_COMPARE(mServer->resetCount(), 1);
+    }
+
+    void test_commandIsRetriedIfReusedConnectionIsBroken()
+    {
+        mServer->setResponse("GETINFO version", {.data = "2.5.0"});
+        QVERIFY(mServer->listen(mSocketPath));
+
+        {
+            AssuanCommand command{"GETINFO version"};
+            command.setLaunchAgent(false);
+            QSignalSpy finishedSpy{&command, &AssuanCommand::finished};
+            command.start();
+            QVERIFY(finishedSpy.wait());
+            QVERIFY(!command.error());
+        }
+        QTRY_COMPARE(mServer->resetCount(), 1);
+
+        // the agent closes the idle connection, e.g. because it was restarted
+        mServer->disconnectClients();
+        QTest::qWait(100);
+
+        AssuanCommand command{"GETINFO version"};
+        command.setLaunchAgent(false);
+        QSignalSpy finishedSpy{&command, &AssuanCommand::finished};
+        command.start();
+        QVERIFY(finishedSpy.wait());
+        QVERIFY(!command.error());
+        QCOMPARE(command.data(), "2.5.0");
+        QCOMPARE(mServer->connectionCount(), 2);
+    }
+
+    void test_batchIsSentOverOneConnection()
+    {
+        mServer->setResponse("SCD GETATTR SERIALNO", {.statusLines = {{"SERIALNO", "D2760001240103040006123456780000"}}});
+        mServer->setResponse("SCD GETATTR KEY-FPR",
+                             {.statusLines = {{"KEY-FPR", "1 0123456789ABCDEF0123456789ABCDEF01234567"}, {"KEY-FPR", "2 89ABCDEF0123456789ABCDEF0123456789ABCDEF"}}});
+        mServer->setResponse("SCD GETATTR DISP-NAME", {.errorCode = GPG_ERR_INV_VALUE});
+        mServer->setResponse("GETINFO version", {.data = "2.5.0"});
+        QVERIFY(mServer->listen(mSocketPath));
+
+        // the batch blocks; therefore, it's sent from a different thread while the server runs in this thread
+        GpgME::Error err;
+        Assuan::BatchResult result;
+        std::unique_ptr<QThread> thread{QThread::create([&err, &result]() {
+            result = Assuan::sendCommands({"SCD GETATTR SERIALNO", "SCD GETATTR DISP-NAME", "SCD GETATTR KEY-FPR", "GETINFO version"}, err);
+        })};
+        thread->start();
+        QTRY_VERIFY_WITH_TIMEOUT(thread->isFinished(), 5000);
+
+        QVERIFY(!err);
+        QCOMPARE(result.size(), 4);
+        QCOMPARE(result.command(0), "SCD GETATTR SERIALNO");
+        QVERIFY(!result.error(0));
+        QCOMPARE(result.status(0), "D2760001240103040006123456780000");
+        // an error reported by the agent doesn't stop the batch
+        QCOMPARE(result.error(1).code(), GPG_ERR_INV_VALUE);
+        QVERIFY(result.statusLines(1).empty());
+        QVERIFY(!result.error(2));
+        const auto keyFprs = result.statusLines(2);
+        QCOMPARE(keyFprs.size(), 2);
+        QCOMPARE(keyFprs[1].first, "KEY-FPR");
+        QCOMPARE(keyFprs[1].second, "2 89ABCDEF0123456789ABCDEF0123456789ABCDEF");
+        QCOMPARE(result.data(2), "");
+        QCOMPARE(result.data(3), "2.5.0");
+        QCOMPARE(mServer->receivedCommands().size(), 4);
+        QCOMPARE(mServer->connectionCount(), 1);
+    }
+
+    void test_callerIsNotBlockedWhileWaitingForAgent()
+    {
+        Tests::AssuanRetriesOnHold retries;
+        mServer->setResponse("GETINFO version", {.data = "2.5.0"});
+
+        AssuanCommand command{"GETINFO version"};
+        command.setLaunchAgent(false);
+        QSignalSpy finishedSpy{&command, &AssuanCommand::finished};
+        command.start();
+        QVERIFY(command.isRunning());
+
+        // the command waits for the agent while the event loop keeps running
+        QTRY_COMPARE(retries.waitingCommands(), 1);
+        QCOMPARE(finishedSpy.size(), 0);
+
+        // the agent "starts"; the retry succeeds
+        QVERIFY(mServer->listen(mSocketPath));
+        retries.release();
+        QVERIFY(finishedSpy.wait(5000));
+        QVERIFY(!command.error());
+        QCOMPARE(command.data(), "2.5.0");
+        QCOMPARE(retries.waitCount(), 1);
+    }
+
+    void test_cancelWhileWaitingForAgent()
+    {
+        Tests::AssuanRetriesOnHold retries;
+
+        AssuanCommand command{"GETINFO version"};
+        command.setLaunchAgent(false);
+        QSignalSpy finishedSpy{&command, &AssuanCommand::finished};
+        command.start();
+        QTRY_COMPARE(retries.waitingCommands(), 1);
+
+        // the retries are never released; the command finishes only if the waiting is aborted
+        command.cancel();
+        QVERIFY(finishedSpy.wait(5000));
+        QCOMPARE(command.error().code(), GPG_ERR_CANCELED);
+        QVERIFY(!command.isRunning());
+        QCOMPARE(retries.waitCount(), 1);
+    }
+
+    void test_cancelWhileWaitingForResponse()
+    {
+        mServer->setResponse("SCD LEARN --force", {.statusLines = {{"SERIALNO", "D2760001240103040006123456780000"}}, .delay = 500ms});
+        QVERIFY(mServer->listen(mSocketPath));
+
+        AssuanCommand command{"SCD LEARN --force"};
+        command.setLaunchAgent(false);
+        QSignalSpy finishedSpy{&command, &AssuanCommand::finished};
+        QSignalSpy commandReceivedSpy{mServer.get(), &FakeAssuanServer::commandReceived};
+        command.start();
+        QVERIFY(commandReceivedSpy.wait());
+        command.cancel();
+
+        // the transaction is aborted when the response arrives
+        QVERIFY(finishedSpy.wait(5000));
+        QCOMPARE(command.error().code(), GPG_ERR_CANCELED);
+        QVERIFY(command.statusLines().empty());
+    }
+
+    void test_commandCanBeDeletedWhileRunning()
+    {
+        Tests::AssuanRetriesOnHold retries;
+
+        auto command = std::make_unique<AssuanCommand>("GETINFO version");
+        command->setLaunchAgent(false);
+        command->start();
+        QTRY_COMPARE(retries.waitingCommands(), 1);
+        command.reset();
+
+        // deleting the command aborts the waiting; the worker must not report
+        // the result to the deleted command
+        QTRY_COMPARE(retries.waitingCommands(), 0);
+        QCOMPARE(retries.waitCount(), 1);
+        QCOMPARE(mServer->connectionCount(), 0);
+    }
+
+private:
+    std::unique_ptr<QTemporaryDir> mGnupgHome;
+    QString mSocketPath;
+    bool mCreatedSocketDir = false;
+    std::unique_ptr<FakeAssuanServer> mServer;
+};
+
+QTEST_MAIN(AssuanCommandTest)
+#include "assuancommandtest.moc"
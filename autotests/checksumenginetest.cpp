@@ -0,0 +1,252 @@
+/*
+    This file is part of libkleopatra's test suite.
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <Libkleo/ChecksumDefinition>
+#include <Libkleo/ChecksumEngine>
+
+#include <QDir>
+#include <QFile>
+#include <QObject>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+
+using namespace Kleo;
+
+namespace
+{
+constexpr auto sha256OfAbc = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+constexpr auto sha1OfAbc = "a9993e364706816aba3e25717850c26c9cd0d89d";
+
+bool writeFile(const QString &fileName, const QByteArray &content)
+{
+    QFile file{fileName};
+    return file.open(QIODevice::WriteOnly) && file.write(content) == content.size();
+}
+
+QByteArray readFile(const QString &fileName)
+{
+    QFile file{fileName};
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray{};
+}
+
+class FakeChecksumDefinition : public ChecksumDefinition
+{
+public:
+    explicit FakeChecksumDefinition(const QString &id)
+        : ChecksumDefinition(id, id, id + QLatin1StringView(".txt"), {QStringLiteral("*.txt")})
+    {
+    }
+
+private:
+    QString doGetCreateCommand() const override
+    {
+        return {};
+    }
+    QString doGetVerifyCommand() const override
+    {
+        return {};
+    }
+    QStringList doGetCreateArguments(const QStringList &) const override
+    {
+        return {};
+    }
+    QStringList doGetVerifyArguments(const QStringList &) const override
+    {
+        return {};
+    }
+};
+
+bool waitForFinished(QSignalSpy &spy)
+{
+    return spy.size() > 0 || spy.wait(10000);
+}
+}
+
+class ChecksumEngineTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init()
+    {
+        mTmpDir = std::make_unique<QTemporaryDir>();
+        QVERIFY(mTmpDir->isValid());
+        QVERIFY(writeFile(mTmpDir->filePath(QStringLiteral("abc.txt")), "abc"));
+        QVERIFY(writeFile(mTmpDir->filePath(QStringLiteral("empty.txt")), {}));
+        QVERIFY(QDir{mTmpDir->path()}.mkdir(QStringLiteral("sub")));
+        // larger than the read buffer of the engine
+        QVERIFY(writeFile(mTmpDir->filePath(QStringLiteral("sub/large.bin")), QByteArray(3 * 1024 * 1024 + 17, 'x')));
+    }
+
+    void cleanup()
+    {
+        mTmpDir.reset();
+    }
+
+    void test_checksum()
+    {
+        QCOMPARE(ChecksumEngine::checksum(mTmpDir->filePath(QStringLiteral("abc.txt")), QCryptographicHash::Sha256), QByteArray{sha256OfAbc});
+        QCOMPARE(ChecksumEngine::checksum(mTmpDir->filePath(QStringLiteral("abc.txt")), QCryptographicHash::Sha1), QByteArray{sha1OfAbc});
+        QCOMPARE(ChecksumEngine::checksum(mTmpDir->filePath(QStringLiteral("sub/large.bin")), QCryptographicHash::Sha256),
+                 QCryptographicHash::hash(QByteArray(3 * 1024 * 1024 + 17, 'x'), QCryptographicHash::Sha256).toHex());
+        QCOMPARE(ChecksumEngine::checksum(mTmpDir->filePath(QStringLiteral("missing.txt")), QCryptographicHash::Sha256), std::nullopt);
+    }
+
+    void test_engineOfChecksumDefinition()
+    {
+        const auto engine = FakeChecksumDefinition{QStringLiteral("sha256sum")}.createEngine();
+        QVERIFY(engine);
+        QCOMPARE(engine->algorithm(), QCryptographicHash::Sha256);
+        QCOMPARE(FakeChecksumDefinition{QStringLiteral("md5sum")}.createEngine()->algorithm(), QCryptographicHash::Md5);
+        QVERIFY(!FakeChecksumDefinition{QStringLiteral("b2sum")}.createEngine());
+    }
+
+    void test_createAndVerify()
+    {
+        const QStringList files = {QStringLiteral("abc.txt"), QStringLiteral("empty.txt"), QStringLiteral("sub/large.bin")};
+        {
+            ChecksumEngine engine{QCryptographicHash::Sha256};
+            QSignalSpy fileFinishedSpy{&engine, &ChecksumEngine::fileFinished};
+            QSignalSpy finishedSpy{&engine, &ChecksumEngine::finished};
+            engine.startCreate(mTmpDir->path(), files, QStringLiteral("sha256sum.txt"));
+            QVERIFY(engine.isRunning());
+            QVERIFY(waitForFinished(finishedSpy));
+            QCOMPARE(finishedSpy.constFirst().constFirst().toBool(), true);
+            QVERIFY(!engine.isRunning());
+            QCOMPARE(fileFinishedSpy.size(), files.size());
+
+            const auto results = engine.results();
+            QCOMPARE(results.size(), files.size());
+            for (int i = 0; i < files.size(); ++i) {
+                QCOMPARE(results[i].fileName, files[i]);
+                QCOMPARE(results[i].status, ChecksumEngine::Ok);
+            }
+            QCOMPARE(results[0].checksum, QByteArray{sha256OfAbc});
+
+            const QByteArray content = readFile(mTmpDir->filePath(QStringLiteral("sha256sum.txt")));
+            QVERIFY(content.startsWith(QByteArray{sha256OfAbc} + "  abc.txt\n"));
+            QCOMPARE(content.count('\n'), files.size());
+        }
+        {
+            ChecksumEngine engine{QCryptographicHash::Sha256};
+            engine.setMaximumThreadCount(1);
+            QSignalSpy finishedSpy{&engine, &ChecksumEngine::finished};
+            engine.startVerify(mTmpDir->filePath(QStringLiteral("sha256sum.txt")));
+            QVERIFY(waitForFinished(finishedSpy));
+            QCOMPARE(finishedSpy.constFirst().constFirst().toBool(), true);
+            for (const auto &result : engine.results()) {
+                QCOMPARE(result.status, ChecksumEngine::Ok);
+            }
+        }
+    }
+
+    void test_verifyDetectsMismatchAndMissingFiles()
+    {
+        QVERIFY(writeFile(mTmpDir->filePath(QStringLiteral("sha1sum.txt")),
+                          QByteArray{sha1OfAbc} + "  abc.txt\n" //
+                              + QByteArray{sha1OfAbc} + " *empty.txt\n" //
+                              + QByteArray{sha1OfAbc} + "  missing.txt\n" //
+                              + "not a checksum line\n"));
+        ChecksumEngine engine{QCryptographicHash::Sha1};
+        QSignalSpy finishedSpy{&engine, &ChecksumEngine::finished};
+        engine.startVerify(mTmpDir->filePath(QStringLiteral("sha1sum.txt")));
+        QVERIFY(waitForFinished(finishedSpy));
+        QCOMPARE(finishedSpy.constFirst().constFirst().toBool(), false);
+
+        const auto results = engine.results();
+        QCOMPARE(results.size(), 3);
+        QCOMPARE(results[0].status, ChecksumEngine::Ok);
+        QCOMPARE(results[1].fileName, QStringLiteral("empty.txt"));
+        QCOMPARE(results[1].status, ChecksumEngine::Mismatch);
+        QCOMPARE(results[2].status, ChecksumEngine::ReadError);
+        QVERIFY(!results[2].errorString.isEmpty());
+    }
+
+    void test_verifyFailsForMissingChecksumFile()
+    {
+        ChecksumEngine engine{QCryptographicHash::Sha256};
+        QSignalSpy finishedSpy{&engine, &ChecksumEngine::finished};
+        engine.startVerify(mTmpDir->filePath(QStringLiteral("missing.txt")));
+        QVERIFY(waitForFinished(finishedSpy));
+        QCOMPARE(finishedSpy.constFirst().constFirst().toBool(), false);
+        QVERIFY(!engine.errorString().isEmpty());
+    }
+
+    void test_escapedFileNames()
+    {
+        const std::vector<ChecksumEngine::FileResult> results = {
+            {QStringLiteral("plain"), "00ff", ChecksumEngine::Ok, {}},
+            {QStringLiteral("back\\slash"), "11ee", ChecksumEngine::Ok, {}},
+            {QStringLiteral("line\nbreak\r"), "22dd", ChecksumEngine::Ok, {}},
+            {QStringLiteral("unreadable"), {}, ChecksumEngine::ReadError, {}},
+        };
+        const QByteArray content = ChecksumEngine::formatChecksumFile(results);
+        QCOMPARE(content, QByteArray{"00ff  plain\n\\11ee  back\\\\slash\n\\22dd  line\\nbreak\\r\n"});
+
+        int invalidLines = -1;
+        const auto entries = ChecksumEngine::parseChecksumFile(content, &invalidLines);
+        QCOMPARE(invalidLines, 0);
+        QCOMPARE(entries.size(), 3);
+        for (std::size_t i = 0; i < entries.size(); ++i) {
+            QCOMPARE(entries[i].fileName, results[i].fileName);
+            QCOMPARE(entries[i].checksum, results[i].checksum);
+        }
+    }
+
+    void test_parseChecksumFile_data()
+    {
+        QTest::addColumn<QByteArray>("content");
+        QTest::addColumn<int>("validLines");
+        QTest::addColumn<int>("invalidLines");
+
+        QTest::newRow("empty") << QByteArray{} << 0 << 0;
+        QTest::newRow("text mode") << QByteArray{"ABCdef  file\n"} << 1 << 0;
+        QTest::newRow("binary mode") << QByteArray{"abcdef *file\n"} << 1 << 0;
+        QTest::newRow("CRLF") << QByteArray{"abcdef  file\r\n"} << 1 << 0;
+        QTest::newRow("no trailing line break") << QByteArray{"abcdef  file"} << 1 << 0;
+        QTest::newRow("single space") << QByteArray{"abcdef file\n"} << 0 << 1;
+        QTest::newRow("missing file name") << QByteArray{"abcdef  \n"} << 0 << 1;
+        QTest::newRow("non-hex checksum") << QByteArray{"xyz  file\n"} << 0 << 1;
+        QTest::newRow("invalid escape") << QByteArray{"\\abcdef  fi\\le\n"} << 0 << 1;
+        QTest::newRow("mixed") << QByteArray{"abcdef  file\ngarbage\n\n012345  other\n"} << 2 << 1;
+    }
+
+    void test_parseChecksumFile()
+    {
+        QFETCH(QByteArray, content);
+        QFETCH(int, validLines);
+        QFETCH(int, invalidLines);
+
+        int invalid = -1;
+        const auto entries = ChecksumEngine::parseChecksumFile(content, &invalid);
+        QCOMPARE(int(entries.size()), validLines);
+        QCOMPARE(invalid, invalidLines);
+        for (const auto &entry : entries) {
+            QCOMPARE(entry.checksum, entry.checksum.toLower());
+        }
+    }
+
+    void test_cancel()
+    {
+        ChecksumEngine engine{QCryptographicHash::Sha256};
+        QSignalSpy finishedSpy{&engine, &ChecksumEngine::finished};
+        engine.startCreate(mTmpDir->path(), {QStringLiteral("sub/large.bin")}, QStringLiteral("sha256sum.txt"));
+        engine.cancel();
+        QVERIFY(waitForFinished(finishedSpy));
+        QCOMPARE(finishedSpy.constFirst().constFirst().toBool(), false);
+        QVERIFY(!QFile::exists(mTmpDir->filePath(QStringLiteral("sha256sum.txt"))));
+    }
+
+private:
+    std::unique_ptr<QTemporaryDir> mTmpDir;
+};
+
+QTEST_MAIN(ChecksumEngineTest)
+#include "checksumenginetest.moc"
@@ -7,12 +7,62 @@
 */
 
 #include <Libkleo/Classify>
+
+#include <QGpgME/DataProvider>
+
+#include <QRandomGenerator>
 #include <QTemporaryDir>
 #include <QTemporaryFile>
 #include <QTest>
 
+#include <gpgme++/data.h>
+
 using namespace Qt::Literals::StringLiterals;
 
+namespace
+{
+// the classification of content done purely by gpgme
+unsigned int classifyContentWithGpgME(const QByteArray &data)
+{
+    QGpgME::QByteArrayDataProvider dp(data);
+    GpgME::Data gpgmeData(&dp);
+    switch (gpgmeData.type()) {
+    case GpgME::Data::PGPSigned:
+        return Kleo::Class::OpenPGP | Kleo::Class::OpaqueSignature;
+    case GpgME::Data::PGPOther:
+        return Kleo::Class::OpenPGP | Kleo::Class::CipherText;
+    case GpgME::Data::PGPKey:
+        return Kleo::Class::OpenPGP | Kleo::Class::Certificate;
+    case GpgME::Data::CMSSigned:
+        return Kleo::Class::CMS | Kleo::Class::AnySignature;
+    case GpgME::Data::CMSEncrypted:
+        return Kleo::Class::CMS | Kleo::Class::CipherText;
+    case GpgME::Data::CMSOther:
+        return Kleo::Class::CMS | Kleo::Class::CipherText;
+    case GpgME::Data::X509Cert:
+        return Kleo::Class::CMS | Kleo::Class::Certificate;
+    case GpgME::Data::PKCS12:
+        return Kleo::Class::CMS | Kleo::Class::Binary | Kleo::Class::ExportedPSM;
+    case GpgME::Data::PGPEncrypted:
+        return Kleo::Class::OpenPGP | Kleo::Class::CipherText;
+    case GpgME::Data::PGPSignature:
+        return Kleo::Class::OpenPGP | Kleo::Class::DetachedSignature;
+    default:
+        return Kleo::Class::NoClass;
+    }
+}
+
+QByteArray armored(const char *label)
+{
+    return "-----BEGIN "_ba + label + "-----\n\nbWVzc2FnZSBtZXNzYWdlIG1lc3NhZ2UgbWVzc2FnZQ==\n-----END "_ba + label + "-----\n";
+}
+
+QByteArray packet(const QByteArray &header, qsizetype bodyLength)
+{
+    return header + QByteArray(bodyLength, '\x01');
+}
+}
+
 class ClassifyTest : public QObject
 {
     Q_OBJECT
@@ -63,6 +113,116 @@ private Q_SLOTS:
         QVERIFY(Kleo::isMimeFile(fileName1));
     }
 
+    void test_classifyFiles()
+    {
+        QTemporaryDir dir;
+        QStringList fileNames;
+        for (const auto &name : {u"file.sig"_s, u"other.SIG"_s, u"msg.asc"_s, u"file.crl"_s, u"file.eml"_s, u"file.unknown"_s}) {
+            QFile file{dir.filePath(name)};
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            fileNames.push_back(file.fileName());
+        }
+        fileNames.push_back(dir.filePath(u"does-not-exist.sig"_s));
+
+        const auto result = Kleo::classifyFiles(fileNames);
+        QCOMPARE(result.classifications.size(), std::size_t(fileNames.size()));
+        for (qsizetype i = 0; i < fileNames.size(); ++i) {
+            QCOMPARE(result.classifications[i], Kleo::classify(fileNames[i]));
+        }
+        QCOMPARE(result.combined, Kleo::classify(fileNames));
+        QCOMPARE(result.combined, 0U);
+
+        const QStringList signatures{dir.filePath(u"file.sig"_s), dir.filePath(u"other.SIG"_s)};
+        QCOMPARE(Kleo::classifyFiles(signatures).combined, unsigned(Kleo::Class::OpenPGP | Kleo::Class::AnyFormat | Kleo::Class::DetachedSignature));
+        QCOMPARE(Kleo::classify(signatures), unsigned(Kleo::Class::OpenPGP | Kleo::Class::AnyFormat | Kleo::Class::DetachedSignature));
+    }
+
+    void test_classifyFiles_empty()
+    {
+        const auto result = Kleo::classifyFiles({});
+        QVERIFY(result.classifications.empty());
+        QCOMPARE(result.combined, 0U);
+        QCOMPARE(Kleo::classify(QStringList{}), 0U);
+    }
+
+    void test_classifyContent_data()
+    {
+        QTest::addColumn<QByteArray>("data");
+
+        QTest::newRow("empty") << QByteArray{};
+        QTest::newRow("short text") << "Hello"_ba;
+        QTest::newRow("short armor") << "-----BEGIN PGP SIGNATURE"_ba;
+        QTest::newRow("text") << "This is some text which is long enough to be examined.\nAnd a second line.\n"_ba;
+        QTest::newRow("checksum file") << "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855  empty.txt\n"
+                                          "5891b5b522d5df086d0ff0b110fbd9d21bb4fc7163af34d08286a2e846f6be03  hello.txt\n"_ba;
+        QTest::newRow("PDF header") << "%PDF-1.7\n%\xe2\xe3\xcf\xd3\n1 0 obj\n<< /Type /Catalog >>\nendobj\n"_ba;
+        QTest::newRow("PNG header") << "\x89PNG\r\n\x1a\n\0\0\0\rIHDR\0\0\0\x10\0\0\0\x10\x08\x06\0\0\0"_ba;
+        QTest::newRow("JPEG header") << "\xff\xd8\xff\xe0\0\x10JFIF\0\x01\x01\0\0\x01\0\x01\0\0\xff\xdb\0C\0"_ba;
+        QTest::newRow("UTF-8 BOM") << "\xef\xbb\xbf" + armored("PGP SIGNATURE");
+
+        for (const char *label : {"PGP SIGNATURE",
+                                  "PGP SIGNED MESSAGE",
+                                  "PGP PUBLIC KEY BLOCK",
+                                  "PGP PRIVATE KEY BLOCK",
+                                  "PGP SECRET KEY BLOCK",
+                                  "PGP MESSAGE",
+                                  "PGP ARMORED FILE",
+                                  "SIGNED OBJECT",
+                                  "ENCRYPTED MESSAGE",
+                                  "CERTIFICATE",
+                                  "CERTIFICATE REQUEST",
+                                  "NEW CERTIFICATE REQUEST",
+                                  "X509 CRL",
+                                  "PKCS12",
+                                  "SOMETHING ELSE"}) {
+            QTest::addRow("armored %s", label) << armored(label);
+            QTest::addRow("armored %s after text", label) << "Some text\nbefore the armor\n" + armored(label);
+            QTest::addRow("armored %s with CRLF", label) << armored(label).replace("\n", "\r\n");
+        }
+        QTest::newRow("armor not at start of line") << "Some text before the armor " + armored("PGP SIGNATURE");
+        QTest::newRow("armor after NUL") << "Some text\n"_ba + '\0' + "\n" + armored("PGP SIGNATURE");
+        QTest::newRow("armor at offset 1500") << QByteArray(1499, 'a') + '\n' + armored("PGP SIGNATURE");
+        QTest::newRow("armor at end of sample") << QByteArray(2040, 'a') + '\n' + armored("PGP SIGNATURE");
+        QTest::newRow("armor at offset 3000") << QByteArray(2999, 'a') + '\n' + armored("PGP SIGNATURE");
+        QTest::newRow("long text") << QByteArray(4096, 'a');
+
+        // binary OpenPGP data
+        QTest::newRow("PKESK (old format)") << packet("\x85\x01\x0c"_ba, 268);
+        QTest::newRow("PKESK (new format)") << packet("\xc1\xc0\x4c"_ba, 268);
+        QTest::newRow("SKESK (new format)") << packet("\xc3\x2e"_ba, 46);
+        QTest::newRow("one-pass signature") << packet("\x90\x0d"_ba, 13);
+        QTest::newRow("secret key") << packet("\x95\x03\xc6"_ba, 966);
+        QTest::newRow("public key") << packet("\xc6\x33"_ba, 51);
+        QTest::newRow("public key (4 byte length)") << packet("\xc6\xff\0\0\0\x33"_ba, 51);
+        QTest::newRow("signature") << packet("\x89\x01\x33"_ba, 307);
+        QTest::newRow("compressed") << packet("\xa3\x01"_ba, 100);
+        QTest::newRow("literal data") << packet("\xcb\x20"_ba, 32);
+        QTest::newRow("truncated public key") << packet("\x99\x01\xa2"_ba, 100);
+        QTest::newRow("public key longer than sample") << packet("\x99\x0f\xa2"_ba, 4002);
+        QTest::newRow("partial length") << packet("\xc6\xe5"_ba, 100);
+        QTest::newRow("indeterminate length") << packet("\x9b"_ba, 100);
+
+        // DER encoded data
+        QTest::newRow("DER sequence") << packet("\x30\x82\x01\x00\x06\x09\x2a\x86\x48\x86\xf7\x0d\x01\x07\x02"_ba, 241);
+        QTest::newRow("DER sequence of sequence") << packet("\x30\x82\x01\x00\x30\x81\xfc"_ba, 249);
+
+        QRandomGenerator generator{42};
+        for (int i = 0; i < 50; ++i) {
+            QByteArray data(generator.bounded(1, 4096), Qt::Uninitialized);
+            for (auto &ch : data) {
+                ch = static_cast<char>(generator.bounded(256));
+            }
+            QTest::addRow("random %d", i) << data;
+        }
+    }
+
+    void test_classifyContent()
+    {
+        QFETCH(QByteArray, data);
+
+        QCOMPARE(Kleo::classifyContent(data), classifyContentWithGpgME(data));
+    }
+
     void test_mayBeMimeFile_fileName_data()
     {
         QTest::addColumn<QString>("fileName");
@@ -121,6 +281,44 @@ private Q_SLOTS:
         QCOMPARE(fi.baseName() + QStringLiteral(".sig"), signatures[0]);
     }
 
+    void test_pairSignaturesWithSignedData()
+    {
+        QTemporaryDir dir;
+        for (const auto &name : {u"a.txt"_s,
+                                 u"a.txt.asc"_s,
+                                 u"a.txt.sig"_s,
+                                 u"b.tar.gz"_s,
+                                 u"b.tar.gz.p7s"_s,
+                                 u"c.txt"_s,
+                                 u"orphan.sig"_s,
+                                 u"unrelated.sig.txt"_s}) {
+            QFile file{dir.filePath(name)};
+            QVERIFY(file.open(QIODevice::WriteOnly));
+        }
+
+        const auto pairs = Kleo::pairSignaturesWithSignedDataInDirectory(dir.path());
+        QCOMPARE(pairs.size(), 2);
+        QCOMPARE(pairs[0].signedDataFileName, dir.filePath(u"a.txt"_s));
+        QCOMPARE(pairs[0].signatureFileNames, Kleo::findSignatures(dir.filePath(u"a.txt"_s)));
+        QCOMPARE(pairs[0].signatureFileNames, QStringList({dir.filePath(u"a.txt.asc"_s), dir.filePath(u"a.txt.sig"_s)}));
+        QCOMPARE(pairs[1].signedDataFileName, dir.filePath(u"b.tar.gz"_s));
+        QCOMPARE(pairs[1].signatureFileNames, Kleo::findSignatures(dir.filePath(u"b.tar.gz"_s)));
+    }
+
+    void test_pairSignaturesWithSignedData_fileList()
+    {
+        // the files don't need to exist
+        const QStringList fileNames{u"x.sig"_s, u"y"_s, u"x"_s, u"y.asc"_s, u"z.asc"_s};
+        const auto pairs = Kleo::pairSignaturesWithSignedData(fileNames);
+        QCOMPARE(pairs.size(), 2);
+        QCOMPARE(pairs[0].signedDataFileName, u"y"_s);
+        QCOMPARE(pairs[0].signatureFileNames, QStringList{u"y.asc"_s});
+        QCOMPARE(pairs[1].signedDataFileName, u"x"_s);
+        QCOMPARE(pairs[1].signatureFileNames, QStringList{u"x.sig"_s});
+
+        QVERIFY(Kleo::pairSignaturesWithSignedData({}).empty());
+    }
+
     void test_outputFileName_data()
     {
         QTest::addColumn<QString>("fileName");
@@ -9,6 +9,7 @@
 #include <config-libkleo.h>
 
 #include <Libkleo/Compliance>
+#include <Libkleo/CryptoConfig>
 #include <Libkleo/GnuPG>
 #include <Libkleo/Test>
 
@@ -122,6 +123,57 @@ private Q_SLOTS:
         QCOMPARE(DeVSCompliance::name(true), u"VS-NfD compliant (beta) (for tests only)"_s);
         QCOMPARE(DeVSCompliance::name(false), u"Not VS-NfD compliant (for tests only)"_s);
     }
+
+    void test_state_is_updated_when_config_changes()
+    {
+        {
+            Tests::FakeCryptoConfigStringValue fakeCompliance{"gpg", "compliance", QStringLiteral("de-vs")};
+            Tests::FakeCryptoConfigIntValue fakeDeVsCompliance{"gpg", "compliance_de_vs", 0};
+            QVERIFY(DeVSCompliance::isActive());
+            QVERIFY(!DeVSCompliance::isCompliant());
+        }
+        {
+            Tests::FakeCryptoConfigStringValue fakeCompliance{"gpg", "compliance", QStringLiteral("de-vs")};
+            Tests::FakeCryptoConfigIntValue fakeDeVsCompliance{"gpg", "compliance_de_vs", 1};
+            QVERIFY(DeVSCompliance::isActive());
+            QVERIFY(DeVSCompliance::isCompliant());
+        }
+        {
+            Tests::FakeCryptoConfigStringValue fakeCompliance{"gpg", "compliance", QStringLiteral("gnupg")};
+            QVERIFY(!DeVSCompliance::isActive());
+            QVERIFY(!DeVSCompliance::isCompliant());
+        }
+    }
+
+    void test_state_is_updated_when_preloaded_config_becomes_available()
+    {
+        Tests::FakeGpgConf gpgconf{{
+            {"gpg", "compliance", u"de-vs"_s},
+            {"gpg", "compliance_de_vs", 23},
+        }};
+        // the state is determined with QGpgME::cryptoConfig() while the configuration isn't preloaded;
+        // in the test environment the compliance mode isn't configured
+        QVERIFY(!cryptoConfigIsLoaded());
+        QVERIFY(!DeVSCompliance::isActive());
+
+        preloadCryptoConfig();
+        gpgconf.finishLoading();
+        QTRY_VERIFY(cryptoConfigIsLoaded());
+        QVERIFY(DeVSCompliance::isActive());
+        QVERIFY(DeVSCompliance::isCompliant());
+
+        // the state determined while the configuration is reloaded mustn't stick
+        gpgconf.setOptions({
+            {"gpg", "compliance", u"de-vs"_s},
+            {"gpg", "compliance_de_vs", 23},
+        });
+        (void)DeVSCompliance::isActive();
+        gpgconf.finishLoading();
+        QTRY_VERIFY(cryptoConfigIsLoaded());
+        QVERIFY(DeVSCompliance::isActive());
+        QVERIFY(DeVSCompliance::isCompliant());
+        QCOMPARE(gpgconf.loadCount(), 2);
+    }
 };
 
 QTEST_MAIN(ComplianceTest)
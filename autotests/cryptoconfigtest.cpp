@@ -0,0 +1,105 @@
+/*
+    This file is part of libkleopatra's test suite.
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <Libkleo/CryptoConfig>
+#include <Libkleo/Test>
+
+#include <QObject>
+#include <QTest>
+
+using namespace Kleo;
+using namespace Qt::Literals::StringLiterals;
+
+class CryptoConfigTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void test_preloadInBackground()
+    {
+        Tests::FakeGpgConf gpgconf{{
+            {"gpg", "compliance", u"de-vs"_s},
+            {"gpg", "compliance_de_vs", 23},
+            {"dirmngr", "use-tor", true},
+        }};
+        QVERIFY(!cryptoConfigIsLoaded());
+
+        preloadCryptoConfig();
+        // while loading, the non-blocking functions return the default values
+        QVERIFY(!cryptoConfigIsLoaded());
+        QCOMPARE(peekCryptoConfigIntValue("gpg", "compliance_de_vs", -1), -1);
+        QCOMPARE(peekCryptoConfigStringValue("gpg", "compliance", u"default"_s), u"default"_s);
+        QCOMPARE(peekCryptoConfigBoolValue("dirmngr", "use-tor"), false);
+
+        gpgconf.finishLoading();
+        QTRY_VERIFY(cryptoConfigIsLoaded());
+        QCOMPARE(gpgconf.loadCount(), 1);
+
+        QCOMPARE(peekCryptoConfigIntValue("gpg", "compliance_de_vs", -1), 23);
+        QCOMPARE(peekCryptoConfigStringValue("gpg", "compliance", u"default"_s), u"de-vs"_s);
+        QCOMPARE(peekCryptoConfigBoolValue("dirmngr", "use-tor"), true);
+        // unknown options and options of other types give the default value
+        QCOMPARE(peekCryptoConfigIntValue("gpg", "unknown", -1), -1);
+        QCOMPARE(peekCryptoConfigIntValue("unknown", "compliance_de_vs", -1), -1);
+        QCOMPARE(peekCryptoConfigIntValue("gpg", "compliance", -1), -1);
+
+        // the blocking functions use the preloaded values
+        QCOMPARE(getCryptoConfigIntValue("gpg", "compliance_de_vs", -1), 23);
+        QCOMPARE(getCryptoConfigStringValue("gpg", "compliance"), u"de-vs"_s);
+        QCOMPARE(getCryptoConfigBoolValue("dirmngr", "use-tor"), true);
+        QCOMPARE(getCryptoConfigBoolValue("gpg", "compliance_de_vs"), false);
+
+        // preloading again does nothing
+        preloadCryptoConfig();
+        QVERIFY(cryptoConfigIsLoaded());
+        QCOMPARE(gpgconf.loadCount(), 1);
+    }
+
+    void test_reloadAfterConfigChange()
+    {
+        Tests::FakeGpgConf gpgconf{{
+            {"gpg", "compliance_de_vs", 23},
+        }};
+        preloadCryptoConfig();
+        gpgconf.finishLoading();
+        QTRY_VERIFY(cryptoConfigIsLoaded());
+
+        gpgconf.setOptions({
+            {"gpg", "compliance_de_vs", 42},
+        });
+        QVERIFY(!cryptoConfigIsLoaded());
+        // while reloading, the previously loaded values are returned
+        QCOMPARE(peekCryptoConfigIntValue("gpg", "compliance_de_vs", -1), 23);
+        QCOMPARE(getCryptoConfigIntValue("gpg", "compliance_de_vs", -1), 23);
+
+        gpgconf.finishLoading();
+        QTRY_VERIFY(cryptoConfigIsLoaded());
+        QCOMPARE(gpgconf.loadCount(), 2);
+        QCOMPARE(peekCryptoConfigIntValue("gpg", "compliance_de_vs", -1), 42);
+    }
+
+    void test_fakeValuesTakePrecedence()
+    {
+        Tests::FakeGpgConf gpgconf{{
+            {"gpg", "compliance_de_vs", 23},
+        }};
+        preloadCryptoConfig();
+        gpgconf.finishLoading();
+        QTRY_VERIFY(cryptoConfigIsLoaded());
+
+        Tests::FakeCryptoConfigIntValue fakeDeVsCompliance{"gpg", "compliance_de_vs", 1};
+        QCOMPARE(peekCryptoConfigIntValue("gpg", "compliance_de_vs", -1), 1);
+        QCOMPARE(getCryptoConfigIntValue("gpg", "compliance_de_vs", -1), 1);
+
+        Tests::FakeCryptoConfigBoolValue fakeUseTor{"dirmngr", "use-tor", true};
+        QCOMPARE(peekCryptoConfigBoolValue("dirmngr", "use-tor"), true);
+        QCOMPARE(getCryptoConfigBoolValue("dirmngr", "use-tor"), true);
+    }
+};
+
+QTEST_MAIN(CryptoConfigTest)
+#include "cryptoconfigtest.moc"
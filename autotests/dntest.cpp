@@ -0,0 +1,117 @@
+/*
+    This file is part of libkleopatra's test suite.
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <Libkleo/Dn>
+#include <Libkleo/OidMap>
+
+#include <QTest>
+
+using namespace Kleo;
+using namespace Qt::StringLiterals;
+
+QT_WARNING_PUSH
+QT_WARNING_DISABLE_DEPRECATED
+static QStringList attributes(const char *utf8DN)
+{
+    QStringList result;
+    const DN dn{utf8DN};
+    for (const auto &attribute : dn) {
+        result.push_back(attribute.name() + u'=' + attribute.value());
+    }
+    return result;
+}
+QT_WARNING_POP
+
+class DNTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void test_attributeNameForOID()
+    {
+        QCOMPARE(attributeNameForOID("0.2.262.1.10.7.20"), "NameDistinguisher");
+        QCOMPARE(attributeNameForOID("1.2.840.113549.1.9.1"), "EMAIL");
+        QCOMPARE(attributeNameForOID("2.5.4.4"), "SN");
+        QCOMPARE(attributeNameForOID("2.5.4.42"), "GN");
+        QCOMPARE(attributeNameForOID("2.5.4.65"), "Pseudo");
+        QCOMPARE(attributeNameForOID("ST"), "SP");
+        QCOMPARE(attributeNameForOID("st"), "SP");
+        QCOMPARE(attributeNameForOID(std::string_view{"2.5.4.42=Ada", 8}), "GN");
+        QVERIFY(!attributeNameForOID("2.5.4.3"));
+        QVERIFY(!attributeNameForOID("CN"));
+        QVERIFY(!attributeNameForOID(""));
+        QVERIFY(!attributeNameForOID(static_cast<const char *>(nullptr)));
+    }
+
+    void test_oidForAttributeName()
+    {
+        QCOMPARE(oidForAttributeName(u"EMAIL"_s), "1.2.840.113549.1.9.1");
+        QCOMPARE(oidForAttributeName(u"email"_s), "1.2.840.113549.1.9.1");
+        QCOMPARE(oidForAttributeName(u"SP"_s), "ST");
+        QVERIFY(!oidForAttributeName(u"CN"_s));
+    }
+
+    void test_parsing_data()
+    {
+        QTest::addColumn<QByteArray>("dn");
+        QTest::addColumn<QStringList>("expected");
+
+        QTest::newRow("empty") << QByteArray{""} << QStringList{};
+        QTest::newRow("simple") << QByteArray{"CN=Test,O=KDAB,C=US"} << QStringList{u"CN=Test"_s, u"O=KDAB"_s, u"C=US"_s};
+        QTest::newRow("spaces") << QByteArray{" CN = Test , O=KDAB"} << QStringList{u"CN= Test "_s, u"O=KDAB"_s};
+        QTest::newRow("other delimiters") << QByteArray{"CN=Test;O=KDAB+C=US"} << QStringList{u"CN=Test"_s, u"O=KDAB"_s, u"C=US"_s};
+        QTest::newRow("OIDs") << QByteArray{"1.2.840.113549.1.9.1=test@example.net,2.5.4.42=Ada,ST=Berlin"}
+                              << QStringList{u"EMAIL=test@example.net"_s, u"GN=Ada"_s, u"SP=Berlin"_s};
+        QTest::newRow("unknown OID") << QByteArray{"2.5.4.3=Test"} << QStringList{u"2.5.4.3=Test"_s};
+        QTest::newRow("lower-case name") << QByteArray{"cn=Test"} << QStringList{u"CN=Test"_s};
+        QTest::newRow("empty value") << QByteArray{"CN=,O=KDAB"} << QStringList{u"CN="_s, u"O=KDAB"_s};
+        QTest::newRow("hex string") << QByteArray{"CN=#414243,O=KDAB"} << QStringList{u"CN=ABC"_s, u"O=KDAB"_s};
+        QTest::newRow("escaped special characters") << QByteArray{"CN=a\\,b\\+c\\\"d\\\\e"} << QStringList{u"CN=a,b+c\"d\\e"_s};
+        QTest::newRow("escaped hex pairs") << QByteArray{"CN=\\41B\\c3\\a4"} << QStringList{u"CN=ABä"_s};
+        QTest::newRow("UTF-8") << QByteArray{"CN=Ärger,O=Straße"} << QStringList{u"CN=Ärger"_s, u"O=Straße"_s};
+        QTest::newRow("escaped null character") << QByteArray{"CN=a\\00b,O=KDAB"} << QStringList{u"CN=a"_s, u"O=KDAB"_s};
+        QTest::newRow("odd number of hex digits") << QByteArray{"CN=#41424,O=KDAB"} << QStringList{};
+        QTest::newRow("empty hex string") << QByteArray{"CN=#,O=KDAB"} << QStringList{};
+        QTest::newRow("invalid escape sequence") << QByteArray{"CN=a\\xb"} << QStringList{};
+        QTest::newRow("quote") << QByteArray{"CN=\"Test\""} << QStringList{};
+        QTest::newRow("missing value") << QByteArray{"CN"} << QStringList{};
+        QTest::newRow("invalid delimiter") << QByteArray{"CN=#4142 O=KDAB"} << QStringList{};
+    }
+
+    void test_parsing()
+    {
+        QFETCH(QByteArray, dn);
+        QFETCH(QStringList, expected);
+
+        QCOMPARE(attributes(dn.constData()), expected);
+    }
+
+    void test_parsing_of_truncated_and_corrupted_dns()
+    {
+        // the parser must cope with arbitrary input; feed it all prefixes and
+        // single byte corruptions of a DN using all features of the syntax
+        const QByteArray dn{"CN=Test \\2C \\\"quoted\\\",1.2.840.113549.1.9.1=#7465737440,OU=a\\+b+O=KDAB;C=US"};
+        for (qsizetype i = 0; i <= dn.size(); ++i) {
+            (void)attributes(dn.left(i).constData());
+            for (const char c : {'\0', '\\', '#', '=', ',', '"', ' ', '\xff'}) {
+                QByteArray corrupted = dn;
+                corrupted[i < dn.size() ? i : 0] = c;
+                (void)attributes(corrupted.constData());
+            }
+        }
+    }
+
+    void benchmark_parsing()
+    {
+        const QByteArray dn{"CN=Ada Lovelace,EMAIL=ada@example.net,OU=Analytical Engines,O=Babbage \\26 Co.,L=London,ST=Greater London,C=UK"};
+        QBENCHMARK {
+            (void)attributes(dn.constData());
+        }
+    }
+};
+
+QTEST_MAIN(DNTest)
+#include "dntest.moc"
@@ -22,6 +22,8 @@
 #include <QTemporaryDir>
 #include <QTest>
 
+#include <algorithm>
+
 using namespace Kleo;
 using namespace GpgME;
 using namespace Qt::StringLiterals;
@@ -39,6 +41,12 @@ public:
     {
     }
 
+    void setDateTime(const QDateTime &dateTime)
+    {
+        mCurrentDate = dateTime.date();
+        mCurrentTime = dateTime.toSecsSinceEpoch();
+    }
+
     qint64 currentTime() const override
     {
         return mCurrentTime;
@@ -60,6 +68,13 @@ private:
     qint64 mCurrentTime;
 };
 
+    }
+
+private:
+    QDateTime mStartTime;
+    QElapsedTimer mTimer;
+};
+
 class ExpiryCheckerTest : public QObject
 {
     Q_OBJECT
@@ -662,6 +677,147 @@ private Q_SLOTS:
         }
     }
 
+    void checkKeys()
+    {
+        const auto neverExpiringKey = testKey("test@kolab.org", GpgME::OpenPGP);
+        const auto certificate = testKey("9E99817D12280C9677674430492EDA1DCE2E4C63", GpgME::CMS);
+        const auto issuer = testKey("3193786A48BDF2D4D20B8FC6501F4DE8BE231B05", GpgME::CMS);
+        const auto checkFlags = ExpiryChecker::CheckFlags{ExpiryChecker::CertificationKey | ExpiryChecker::CheckChain};
+
+        ExpiryChecker checker(ExpiryCheckerSettings{days{1}, days{10}, days{10}, days{10}});
+        // 5 days before expiration date of the certificate; the issuer expired 336 days ago
+        checker.setTimeProviderForTest(std::make_shared<FakeTimeProvider>(QDateTime{{2020, 5, 25}, {}, QTimeZone::UTC}));
+        QSignalSpy spy(&checker, &ExpiryChecker::expiryMessage);
+
+        const auto results = checker.checkKeys({neverExpiringKey, certificate, issuer}, checkFlags, days{10});
+
+        QCOMPARE(spy.count(), 0);
+        QCOMPARE(results.size(), 2);
+        QCOMPARE(results[0].checkFlags, checkFlags);
+        QCOMPARE(results[0].expiration.certificate, certificate);
+        QCOMPARE(results[0].expiration.status, ExpiryChecker::ExpiresSoon);
+        QCOMPARE(results[0].expiration.duration, days{5});
+        QCOMPARE(results[0].chainExpiration.size(), 1);
+        QCOMPARE(results[0].chainExpiration[0].certificate, issuer);
+        QCOMPARE(results[0].chainExpiration[0].status, ExpiryChecker::Expired);
+        QCOMPARE(results[0].chainExpiration[0].duration, days{336});
+        QCOMPARE(results[1].expiration.certificate, issuer);
+        QCOMPARE(results[1].expiration.status, ExpiryChecker::Expired);
+        // the chain of the issuer ends before the issuer occurs again
+        QCOMPARE(results[1].chainExpiration.size(), 1);
+        QCOMPARE(results[1].chainExpiration[0].certificate, certificate);
+        QCOMPARE(results[1].chainExpiration[0].status, ExpiryChecker::ExpiresSoon);
+
+        const auto checkKeyResult = checker.checkKey(certificate, checkFlags);
+        QCOMPARE(spy.count(), 2);
+        QCOMPARE(ExpiryChecker::formatMessage(results[0], results[0].expiration), spy.at(0).at(1).toString());
+        QCOMPARE(ExpiryChecker::formatMessage(results[0], results[0].chainExpiration[0]), spy.at(1).at(1).toString());
+        QCOMPARE(checkKeyResult.chainExpiration.size(), results[0].chainExpiration.size());
+    }
+
+    void certificateChainIsMemoized()
+    {
+        const auto certificate = testKey("9E99817D12280C9677674430492EDA1DCE2E4C63", GpgME::CMS);
+        const auto issuer = testKey("3193786A48BDF2D4D20B8FC6501F4DE8BE231B05", GpgME::CMS);
+        const auto checkFlags = ExpiryChecker::CheckFlags{ExpiryChecker::CertificationKey | ExpiryChecker::CheckChain};
+
+        ExpiryChecker checker(ExpiryCheckerSettings{days{1}, days{10}, days{10}, days{10}});
+        // 5 days before expiration date of the certificate; the issuer expired 336 days ago
+        checker.setTimeProviderForTest(std::make_shared<FakeTimeProvider>(QDateTime{{2020, 5, 25}, {}, QTimeZone::UTC}));
+        QSignalSpy spy(&checker, &ExpiryChecker::expiryMessage);
+
+        const auto firstResult = checker.checkKey(certificate, checkFlags);
+        QCOMPARE(firstResult.chainExpiration.size(), 1);
+        QCOMPARE(firstResult.chainExpiration[0].certificate, issuer);
+        QCOMPARE(spy.count(), 2);
+
+        // the memoized chain is used; the messages for the chain are still emitted
+        const auto secondResult = checker.checkKey(certificate, checkFlags);
+        QCOMPARE(secondResult.chainExpiration.size(), 1);
+        QCOMPARE(secondResult.chainExpiration[0].certificate, issuer);
+        QCOMPARE(secondResult.chainExpiration[0].status, ExpiryChecker::Expired);
+        QCOMPARE(secondResult.chainExpiration[0].duration, days{336});
+        QCOMPARE(spy.count(), 4);
+        QCOMPARE(spy.at(3).at(0).value<GpgME::Key>(), issuer);
+        QCOMPARE(spy.at(3).at(3).toBool(), false);
+
+        // the memoized chain is used even if the issuer was removed from the key cache
+        // as long as the key cache doesn't tell that the keys have changed
+        KeyCache::mutableInstance()->remove(issuer, KeyCache::NoNotifications);
+        const auto thirdResult = checker.checkKey(certificate, checkFlags);
+        QCOMPARE(thirdResult.chainExpiration.size(), 1);
+        QCOMPARE(thirdResult.chainExpiration[0].certificate, issuer);
+        QCOMPARE(spy.count(), 6);
+
+        // the memoized chains are dropped if the keys change
+        KeyCache::mutableInstance()->remove(issuer);
+        const auto fourthResult = checker.checkKey(certificate, checkFlags);
+        QCOMPARE(fourthResult.chainExpiration.size(), 0);
+        QCOMPARE(spy.count(), 7);
+
+        KeyCache::mutableInstance()->insert(issuer);
+        const auto fifthResult = checker.checkKey(certificate, checkFlags);
+        QCOMPARE(fifthResult.chainExpiration.size(), 1);
+        QCOMPARE(fifthResult.chainExpiration[0].certificate, issuer);
+        QCOMPARE(spy.count(), 9);
+    }
+
+    void keysByExpirationTime()
+    {
+        const auto neverExpiringKey = testKey("test@kolab.org", GpgME::OpenPGP);
+        const auto keyWithExpiringEncryptionSubkey = testKey("encr-expires@example.net", GpgME::OpenPGP);
+        const auto keyWithExpiringPrimaryKey = testKey("expires@example.net", GpgME::OpenPGP);
+
+        const auto index = mKeyCache->keysByExpirationTime(KeyCache::KeyUsage::Encrypt);
+
+        QVERIFY(std::is_sorted(index.begin(), index.end(), [](const auto &lhs, const auto &rhs) {
+            return lhs.expirationTime < rhs.expirationTime;
+        }));
+        const auto findKey = [&index](const GpgME::Key &key) {
+            return std::find_if(index.begin(), index.end(), [&key](const auto &expiringKey) {
+                return qstrcmp(expiringKey.key.primaryFingerprint(), key.primaryFingerprint()) == 0;
+            });
+        };
+        QCOMPARE(findKey(neverExpiringKey), index.end());
+        // the expiration of the encryption subkey is used
+        const auto it1 = findKey(keyWithExpiringEncryptionSubkey);
+        QVERIFY(it1 != index.end());
+        QCOMPARE(it1->expirationTime, qint64(keyWithExpiringEncryptionSubkey.subkey(1).expirationTime()));
+        // the non-expiring encryption subkey inherits the expiration of the primary key
+        const auto it2 = findKey(keyWithExpiringPrimaryKey);
+        QVERIFY(it2 != index.end());
+        QCOMPARE(it2->expirationTime, qint64(keyWithExpiringPrimaryKey.subkey(0).expirationTime()));
+    }
+
+    void expiryNotifications()
+    {
+        const auto key = testKey("encr-expires@example.net", GpgME::OpenPGP);
+
+        ExpiryChecker checker(ExpiryCheckerSettings{days{9}, days{9}, days{9}, days{9}});
+        // one second before the encryption subkey comes within 9 days of its expiration
+        const auto timeProvider = std::make_shared<FakeTimeProvider>(QDateTime{{2023, 4, 17}, {23, 59, 59}, QTimeZone::UTC});
+        checker.setTimeProviderForTest(timeProvider);
+        QSignalSpy spy(&checker, &ExpiryChecker::expiryMessage);
+
+        checker.startExpiryNotifications(ExpiryChecker::EncryptionKey);
+        QCOMPARE(spy.count(), 0);
+        checker.checkExpiryNotificationsForTest();
+        QCOMPARE(spy.count(), 0);
+
+        timeProvider->setDateTime(QDateTime{{2023, 4, 18}, {0, 0, 0}, QTimeZone::UTC});
+        checker.checkExpiryNotificationsForTest();
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(spy.at(0).at(0).value<GpgME::Key>().primaryFingerprint(), key.primaryFingerprint());
+        QVERIFY(spy.at(0).at(1).toString().contains(u"expires in 9 days"_s));
+
+        // the key is reported only once
+        timeProvider->setDateTime(QDateTime{{2023, 4, 18}, {12, 0, 0}, QTimeZone::UTC});
+        checker.checkExpiryNotificationsForTest();
+        QCOMPARE(spy.count(), 1);
+
+        checker.stopExpiryNotifications();
+    }
+
     void noSuitableSubkey_data()
     {
         QTest::addColumn<GpgME::Key>("key");
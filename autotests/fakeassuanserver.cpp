@@ -0,0 +1,173 @@
+/*
+    This file is part of libkleopatra's test suite.
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "fakeassuanserver.h"
+
+#include <QFile>
+#include <QLocalSocket>
+#include <QTimer>
+
+#include <gpg-error.h>
+
+namespace
+{
+// the maximum length of a line (without the line feed) defined by the Assuan protocol
+constexpr qsizetype maxLineLength = 1000;
+
+// splits @p data into escaped data lines
+QByteArrayList dataLines(QByteArrayView data)
+{
+    QByteArrayList result;
+    QByteArray line = "D ";
+    for (const char ch : data) {
+        if (line.size() + 3 > maxLineLength) {
+            result.push_back(line + '\n');
+            line = "D ";
+        }
+        if (ch == '%' || ch == '\r' || ch == '\n') {
+            line += '%' + QByteArray::number(static_cast<unsigned char>(ch), 16).rightJustified(2, '0').toUpper();
+        } else {
+            line += ch;
+        }
+    }
+    if (line.size() > 2) {
+        result.push_back(line + '\n');
+    }
+    return result;
+}
+
+const char *busyProperty = "busy";
+}
+
+FakeAssuanServer::FakeAssuanServer(QObject *parent)
+    : QObject{parent}
+{
+    connect(&mServer, &QLocalServer::newConnection, this, &FakeAssuanServer::handleNewConnection);
+}
+
+FakeAssuanServer::~FakeAssuanServer()
+{
+    close();
+}
+
+bool FakeAssuanServer::listen(const QString &socketPath)
+{
+    QLocalServer::removeServer(socketPath);
+    mServer.setSocketOptions(QLocalServer::UserAccessOption);
+    if (!mServer.listen(socketPath)) {
+        return false;
+    }
+    mSocketPath = socketPath;
+    return true;
+}
+
+void FakeAssuanServer::close()
+{
+    mServer.close();
+    if (!mSocketPath.isEmpty()) {
+        QFile::remove(mSocketPath);
+        mSocketPath.clear();
+    }
+}
+
+void FakeAssuanServer::disconnectClients()
+{
+    const auto sockets = mServer.findChildren<QLocalSocket *>();
+    for (QLocalSocket *socket : sockets) {
+        socket->disconnectFromServer();
+    }
+}
+
+void FakeAssuanServer::setResponse(const QByteArray &command, const Response &response)
+{
+    mResponses[command] = response;
+}
+
+QByteArrayList FakeAssuanServer::receivedCommands() const
+{
+    return mReceivedCommands;
+}
+
+int FakeAssuanServer::connectionCount() const
+{
+    return mConnectionCount;
+}
+
+int FakeAssuanServer::resetCount() const
+{
+    return mResetCount;
+}
+
+void FakeAssuanServer::handleNewConnection()
+{
+    while (QLocalSocket *socket = mServer.nextPendingConnection()) {
+        mConnectionCount++;
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            processLines(socket);
+        });
+        socket->write("OK Pleased to meet you\n");
+    }
+}
+
+void FakeAssuanServer::processLines(QLocalSocket *socket)
+{
+    while (!socket->property(busyProperty).toBool() && socket->canReadLine()) {
+        QByteArray line = socket->readLine();
+        line.chop(1);
+        if (line.endsWith('\r')) {
+            line.chop(1);
+        }
+        if (line == "BYE") {
+            socket->write("OK closing connection\n");
+            socket->disconnectFromServer();
+            return;
+        }
+        if (line == "RESET") {
+            mResetCount++;
+        }
+        if (line.startsWith("OPTION") || line == "RESET" || line == "NOP") {
+            socket->write("OK\n");
+            continue;
+        }
+        mReceivedCommands.push_back(line);
+        Q_EMIT commandReceived(line);
+        const auto it = mResponses.find(line);
+        if (it == mResponses.end()) {
+            socket->write("ERR " + QByteArray::number(GPG_ERR_ASS_UNKNOWN_CMD) + " Unknown IPC command\n");
+            continue;
+        }
+        const Response response = it->second;
+        if (response.delay.count() > 0) {
+            socket->setProperty(busyProperty, true);
+            QTimer::singleShot(response.delay, socket, [this, socket, response]() {
+                sendResponse(socket, response);
+                socket->setProperty(busyProperty, false);
+                processLines(socket);
+            });
+            return;
+        }
+        sendResponse(socket, response);
+    }
+}
+
+void FakeAssuanServer::sendResponse(QLocalSocket *socket, const Response &response)
+{
+    for (const auto &[keyword, args] : response.statusLines) {
+        socket->write("S " + keyword + ' ' + args + '\n');
+    }
+    for (const QByteArray &line : dataLines(response.data)) {
+        socket->write(line);
+    }
+    if (response.errorCode) {
+        socket->write("ERR " + QByteArray::number(response.errorCode) + " Fake error\n");
+    } else {
+        socket->write("OK\n");
+    }
+}
+
+#include "moc_fakeassuanserver.cpp"
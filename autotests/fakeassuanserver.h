@@ -0,0 +1,70 @@
+/*
+    This file is part of libkleopatra's test suite.
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayList>
+#include <QLocalServer>
+#include <QObject>
+
+#include <chrono>
+#include <map>
+#include <utility>
+#include <vector>
+
+class QLocalSocket;
+
+/**
+ * A minimal Assuan server which pretends to be the GnuPG agent. It listens
+ * on a local socket and answers commands with the responses set with
+ * setResponse(). OPTION, RESET and NOP commands are always answered with OK;
+ * other unknown commands are answered with GPG_ERR_ASS_UNKNOWN_CMD.
+ */
+class FakeAssuanServer : public QObject
+{
+    Q_OBJECT
+public:
+    struct Response {
+        std::vector<std::pair<QByteArray, QByteArray>> statusLines;
+        QByteArray data;
+        unsigned int errorCode = 0; // answer with ERR instead of OK if not 0
+        std::chrono::milliseconds delay{0};
+    };
+
+    explicit FakeAssuanServer(QObject *parent = nullptr);
+    ~FakeAssuanServer() override;
+
+    bool listen(const QString &socketPath);
+    void close();
+
+    /** Closes the connections of all clients like a restarted agent does. */
+    void disconnectClients();
+
+    void setResponse(const QByteArray &command, const Response &response);
+
+    /** Returns the received commands except for OPTION, RESET, NOP, and BYE. */
+    QByteArrayList receivedCommands() const;
+    int resetCount() const;
+    int connectionCount() const;
+
+Q_SIGNALS:
+    void commandReceived(const QByteArray &command);
+
+private:
+    void handleNewConnection();
+    void processLines(QLocalSocket *socket);
+    void sendResponse(QLocalSocket *socket, const Response &response);
+
+private:
+    QLocalServer mServer;
+    QString mSocketPath;
+    std::map<QByteArray, Response> mResponses;
+    QByteArrayList mReceivedCommands;
+    int mConnectionCount = 0;
+    int mResetCount = 0;
+};
@@ -0,0 +1,160 @@
+/*
+    This file is part of libkleopatra's test suite.
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <Libkleo/FileSystemWatcher>
+
+#include <QDir>
+#include <QFile>
+#include <QObject>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <cstdio>
+#include <memory>
+
+using namespace Kleo;
+
+namespace
+{
+// the delay of the watcher; the tests wait at most for a multiple of it
+constexpr int delay = 100;
+
+bool writeFile(const QString &fileName, const QByteArray &content)
+{
+    QFile file{fileName};
+    return file.open(QIODevice::WriteOnly) && file.write(content) == content.size();
+}
+
+// replaces @p target atomically like gpg does it when it updates a keyring
+bool renameOver(const QString &source, const QString &target)
+{
+#ifdef Q_OS_WIN
+    // rename() doesn't replace existing files on Windows
+    QFile::remove(target);
+    return QFile::rename(source, target);
+#else
+    return std::rename(QFile::encodeName(source).constData(), QFile::encodeName(target).constData()) == 0;
+#endif
+}
+}
+
+class FileSystemWatcherTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init()
+    {
+        mTmpDir = std::make_unique<QTemporaryDir>();
+        QVERIFY(mTmpDir->isValid());
+        QVERIFY(writeFile(filePath(QStringLiteral("pubring.kbx")), "keyring"));
+
+        mWatcher = std::make_unique<FileSystemWatcher>();
+        mWatcher->setDelay(delay);
+        mWatcher->setFileStateTracking(true);
+        mWatcher->whitelistFiles({QStringLiteral("pubring.kbx"), QStringLiteral("*.key")});
+        mWatcher->blacklistFiles({QStringLiteral("*.lock"), QStringLiteral("*.tmp")});
+        mWatcher->addPath(mTmpDir->path());
+        QVERIFY(mWatcher->fileStateTracking());
+    }
+
+    void cleanup()
+    {
+        mWatcher.reset();
+        mTmpDir.reset();
+    }
+
+    void test_lockAndRenameIsReportedOnce()
+    {
+        QSignalSpy triggeredSpy{mWatcher.get(), &FileSystemWatcher::triggered};
+        QSignalSpy fileChangedSpy{mWatcher.get(), &FileSystemWatcher::fileChanged};
+
+        // simulate gpg updating the keyring
+        QVERIFY(writeFile(filePath(QStringLiteral("pubring.kbx.lock")), "12345"));
+        QVERIFY(writeFile(filePath(QStringLiteral("pubring.kbx.tmp")), "updated keyring"));
+        QVERIFY(renameOver(filePath(QStringLiteral("pubring.kbx.tmp")), filePath(QStringLiteral("pubring.kbx"))));
+        QVERIFY(QFile::remove(filePath(QStringLiteral("pubring.kbx.lock"))));
+
+        QTRY_COMPARE_WITH_TIMEOUT(triggeredSpy.size(), 1, 50 * delay);
+        QVERIFY(!triggeredSpy.wait(5 * delay));
+        QCOMPARE(fileChangedSpy.size(), 1);
+        QCOMPARE(fileChangedSpy.constFirst().constFirst().toString(), filePath(QStringLiteral("pubring.kbx")));
+
+        // the replaced file is still watched
+        QVERIFY(writeFile(filePath(QStringLiteral("pubring.kbx")), "modified in place"));
+        QTRY_COMPARE_WITH_TIMEOUT(triggeredSpy.size(), 2, 50 * delay);
+        QCOMPARE(fileChangedSpy.constLast().constFirst().toString(), filePath(QStringLiteral("pubring.kbx")));
+    }
+
+    void test_blacklistedFilesAreIgnored()
+    {
+        QSignalSpy triggeredSpy{mWatcher.get(), &FileSystemWatcher::triggered};
+
+        for (int i = 0; i < 10; ++i) {
+            QVERIFY(writeFile(filePath(QStringLiteral("pubring.kbx.lock")), QByteArray::number(i)));
+            QVERIFY(QFile::remove(filePath(QStringLiteral("pubring.kbx.lock"))));
+            QVERIFY(writeFile(filePath(QStringLiteral("sometmpfile.tmp")), QByteArray::number(i)));
+            QVERIFY(QFile::remove(filePath(QStringLiteral("sometmpfile.tmp"))));
+        }
+        // files matching neither list are ignored as well
+        QVERIFY(writeFile(filePath(QStringLiteral("random.txt")), "random"));
+
+        QVERIFY(!triggeredSpy.wait(10 * delay));
+    }
+
+    void test_addedAndRemovedFiles()
+    {
+        QSignalSpy directoryChangedSpy{mWatcher.get(), &FileSystemWatcher::directoryChanged};
+        QSignalSpy fileChangedSpy{mWatcher.get(), &FileSystemWatcher::fileChanged};
+
+        // the patterns are matched case-insensitively
+        QVERIFY(writeFile(filePath(QStringLiteral("ABCDEF.KEY")), "key"));
+        QTRY_COMPARE_WITH_TIMEOUT(fileChangedSpy.size(), 1, 50 * delay);
+        QCOMPARE(fileChangedSpy.constFirst().constFirst().toString(), filePath(QStringLiteral("ABCDEF.KEY")));
+        QCOMPARE(directoryChangedSpy.size(), 1);
+        QCOMPARE(QDir{directoryChangedSpy.constFirst().constFirst().toString()}, QDir{mTmpDir->path()});
+
+        fileChangedSpy.clear();
+        QVERIFY(QFile::remove(filePath(QStringLiteral("ABCDEF.KEY"))));
+        QTRY_COMPARE_WITH_TIMEOUT(fileChangedSpy.size(), 1, 50 * delay);
+        QCOMPARE(fileChangedSpy.constFirst().constFirst().toString(), filePath(QStringLiteral("ABCDEF.KEY")));
+
+        // a file that reappears is detected as new file
+        fileChangedSpy.clear();
+        QVERIFY(writeFile(filePath(QStringLiteral("ABCDEF.KEY")), "key again"));
+        QTRY_COMPARE_WITH_TIMEOUT(fileChangedSpy.size(), 1, 50 * delay);
+    }
+
+    void test_newFileIsReportedWithoutFileStateTracking()
+    {
+        FileSystemWatcher watcher;
+        watcher.setDelay(delay);
+        watcher.whitelistFiles({QStringLiteral("*.key")});
+        watcher.addPath(mTmpDir->path());
+        QVERIFY(!watcher.fileStateTracking());
+        QSignalSpy directoryChangedSpy{&watcher, &FileSystemWatcher::directoryChanged};
+        QSignalSpy fileChangedSpy{&watcher, &FileSystemWatcher::fileChanged};
+
+        QVERIFY(writeFile(filePath(QStringLiteral("ABCDEF.key")), "key"));
+        QTRY_COMPARE_WITH_TIMEOUT(fileChangedSpy.size(), 1, 50 * delay);
+        QCOMPARE(fileChangedSpy.constFirst().constFirst().toString(), filePath(QStringLiteral("ABCDEF.key")));
+        QCOMPARE(directoryChangedSpy.size(), 1);
+    }
+
+private:
+    QString filePath(const QString &fileName) const
+    {
+        return QDir{mTmpDir->path()}.absoluteFilePath(fileName);
+    }
+
+    std::unique_ptr<QTemporaryDir> mTmpDir;
+    std::unique_ptr<FileSystemWatcher> mWatcher;
+};
+
+QTEST_MAIN(FileSystemWatcherTest)
+#include "filesystemwatchertest.moc"
@@ -0,0 +1,182 @@
+/*
+    This file is part of libkleopatra's test suite.
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <Libkleo/Fingerprint>
+#include <Libkleo/KeyCache>
+#include <Libkleo/Predicates>
+
+#include <QObject>
+#include <QTest>
+
+#include <gpgme++/key.h>
+
+#include <gpgme.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+using namespace Kleo;
+using namespace GpgME;
+using namespace std::literals;
+
+namespace QTest
+{
+template<>
+inline char *toString(const Fingerprint &fpr)
+{
+    return QTest::toString(QByteArray::fromStdString(fpr.toHex()));
+}
+}
+
+namespace
+{
+constexpr std::string_view fprV4 = "F8A1A6EC6E0E4C6D7C1DB3E5C2B1B73B5A9F1BDB";
+constexpr std::string_view fprV5 = "1DE1960C29F97E6762C4EA341820DAAC045579921E0F30567354CCC69FD42A1D";
+
+// parsing works at compile time
+static_assert(!Fingerprint::fromHex(fprV4).isNull());
+static_assert(Fingerprint::fromHex(fprV4).size() == 20);
+static_assert(Fingerprint::fromHex(fprV5).size() == 32);
+static_assert(Fingerprint::fromHex("f8a1a6ec6e0e4c6d7c1db3e5c2b1b73b5a9f1bdb"sv) == Fingerprint::fromHex(fprV4));
+static_assert(Fingerprint::fromHex("0000000000000000000000000000000000000001"sv) < Fingerprint::fromHex("0000000000000000000000000000000000000002"sv));
+
+Key createTestKey(const char *uid, const char *fpr)
+{
+    gpgme_key_t key;
+    gpgme_key_from_uid(&key, uid);
+    key->fpr = strdup(fpr);
+
+    return Key(key, false);
+}
+}
+
+class FingerprintTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void test_fromHex_data()
+    {
+        QTest::addColumn<QByteArray>("input");
+        QTest::addColumn<bool>("valid");
+
+        QTest::newRow("empty") << QByteArray{} << false;
+        QTest::newRow("v4 fingerprint") << QByteArray{fprV4.data(), qsizetype(fprV4.size())} << true;
+        QTest::newRow("v5 fingerprint") << QByteArray{fprV5.data(), qsizetype(fprV5.size())} << true;
+        QTest::newRow("lower-case") << QByteArray{fprV4.data(), qsizetype(fprV4.size())}.toLower() << true;
+        QTest::newRow("key ID") << QByteArray{"C2B1B73B5A9F1BDB"} << false;
+        QTest::newRow("too short") << QByteArray{fprV4.data(), qsizetype(fprV4.size()) - 2} << false;
+        QTest::newRow("too long") << QByteArray{fprV4.data(), qsizetype(fprV4.size())} + "00" << false;
+        QTest::newRow("invalid character") << QByteArray{"F8A1A6EC6E0E4C6D7C1DB3E5C2B1B73B5A9F1BDX"} << false;
+        QTest::newRow("space") << QByteArray{"F8A1 A6EC6E0E4C6D7C1DB3E5C2B1B73B5A9F1BDB"} << false;
+    }
+
+    void test_fromHex()
+    {
+        QFETCH(QByteArray, input);
+        QFETCH(bool, valid);
+
+        const auto fpr = Fingerprint::fromHex(input.constData());
+        QCOMPARE(!fpr.isNull(), valid);
+        QCOMPARE(Fingerprint::fromHex(QString::fromLatin1(input)), fpr);
+        if (valid) {
+            QCOMPARE(fpr.size(), std::size_t(input.size() / 2));
+            QCOMPARE(QByteArray::fromStdString(fpr.toHex()), input.toUpper());
+            QCOMPARE(fpr.toQString(), QString::fromLatin1(input.toUpper()));
+        } else {
+            QCOMPARE(fpr.size(), std::size_t(0));
+            QCOMPARE(fpr.toHex(), std::string{});
+        }
+    }
+
+    void test_fromHex_nullptr()
+    {
+        QVERIFY(Fingerprint::fromHex(static_cast<const char *>(nullptr)).isNull());
+    }
+
+    void test_fromHex_non_latin1()
+    {
+        QString s = QString::fromLatin1(fprV4.data(), fprV4.size());
+        s[0] = QChar{0x0660}; // ARABIC-INDIC DIGIT ZERO
+        QVERIFY(Fingerprint::fromHex(s).isNull());
+    }
+
+    void test_ordering_matches_ordering_of_hex_strings()
+    {
+        const std::vector<std::string> hexFprs = {
+            std::string{fprV5},
+            std::string{fprV4},
+            "0000000000000000000000000000000000000000",
+            "FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF",
+            "1DE1960C29F97E6762C4EA341820DAAC04557992",
+            "1DE1960C29F97E6762C4EA341820DAAC045579921E0F30567354CCC69FD42A1C",
+            "A000000000000000000000000000000000000000",
+            "9FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF",
+        };
+        for (const auto &lhs : hexFprs) {
+            for (const auto &rhs : hexFprs) {
+                const auto lhsFpr = Fingerprint::fromHex(lhs);
+                const auto rhsFpr = Fingerprint::fromHex(rhs);
+                QCOMPARE(lhsFpr < rhsFpr, _detail::ByFingerprint<std::less>()(lhs, rhs));
+                QCOMPARE(lhsFpr == rhsFpr, _detail::ByFingerprint<std::equal_to>()(lhs, rhs));
+            }
+        }
+    }
+
+    void test_hash()
+    {
+        const auto fpr = Fingerprint::fromHex(fprV4);
+        QCOMPARE(std::hash<Fingerprint>()(fpr), std::hash<Fingerprint>()(Fingerprint::fromHex("f8a1a6ec6e0e4c6d7c1db3e5c2b1b73b5a9f1bdb")));
+        QCOMPARE(qHash(fpr, 42), qHash(Fingerprint::fromHex("f8a1a6ec6e0e4c6d7c1db3e5c2b1b73b5a9f1bdb"), 42));
+
+        std::unordered_set<Fingerprint> set{fpr, Fingerprint::fromHex(fprV5), Fingerprint::fromHex(fprV4)};
+        QCOMPARE(set.size(), 2);
+    }
+
+    void test_toFingerprints()
+    {
+        const auto fprs = toFingerprints({QString::fromLatin1(fprV4.data(), fprV4.size()), QStringLiteral("invalid")});
+        QCOMPARE(fprs.size(), 2);
+        QCOMPARE(fprs[0], Fingerprint::fromHex(fprV4));
+        QVERIFY(fprs[1].isNull());
+    }
+
+    void test_keyCacheLookup()
+    {
+        const auto key1 = createTestKey("test1@example.net", "0000000000000000000000000000000000000001");
+        const auto key2 = createTestKey("test2@example.net", fprV5.data());
+        const auto cache = KeyCache::mutableInstance();
+        cache->setKeys({key1, key2});
+
+        QCOMPARE(cache->findByFingerprint(Fingerprint::fromKey(key1)).primaryFingerprint(), key1.primaryFingerprint());
+        QCOMPARE(cache->findByFingerprint(Fingerprint::fromHex("1de1960c29f97e6762c4ea341820daac045579921e0f30567354ccc69fd42a1d")).primaryFingerprint(),
+                 key2.primaryFingerprint());
+        QVERIFY(cache->findByFingerprint(Fingerprint::fromHex(fprV4)).isNull());
+        QVERIFY(cache->findByFingerprint(Fingerprint{}).isNull());
+
+        const auto keys = cache->findByFingerprint(std::vector<Fingerprint>{Fingerprint::fromKey(key2), Fingerprint{}, Fingerprint::fromKey(key1)});
+        QCOMPARE(keys.size(), 2);
+        QCOMPARE(keys[0].primaryFingerprint(), key2.primaryFingerprint());
+        QCOMPARE(keys[1].primaryFingerprint(), key1.primaryFingerprint());
+
+        // the index is updated after the content of the cache changed
+        cache->remove(key1);
+        QVERIFY(cache->findByFingerprint(Fingerprint::fromKey(key1)).isNull());
+        QVERIFY(!cache->findByFingerprint(Fingerprint::fromKey(key2)).isNull());
+    }
+
+    void benchmark_fromHex()
+    {
+        QBENCHMARK {
+            const auto fpr = Fingerprint::fromHex(fprV5);
+            QVERIFY(!fpr.isNull());
+        }
+    }
+};
+
+QTEST_MAIN(FingerprintTest)
+#include "fingerprinttest.moc"
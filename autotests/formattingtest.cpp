@@ -8,6 +8,7 @@
 
 #include <Libkleo/Compliance>
 #include <Libkleo/CryptoConfig>
+#include <Libkleo/DnAttributes>
 #include <Libkleo/Formatting>
 #include <Libkleo/KeyCache>
 #include <Libkleo/Test>
@@ -305,6 +306,32 @@ private Q_SLOTS:
         QCOMPARE(Formatting::prettyID(id.constData()), expected);
     }
 
+    void test_prettyDN_uses_current_attribute_order()
+    {
+        const char *dn = "C=DE,O=Example,CN=Test User,EMAIL=test@example.net";
+        const auto originalOrder = DNAttributes::order();
+
+        DNAttributes::setOrder({u"CN"_s, u"O"_s, u"C"_s});
+        QCOMPARE(Formatting::prettyDN(dn), u"CN=Test User,O=Example,C=DE"_s);
+        // the cached result is returned
+        QCOMPARE(Formatting::prettyDN(dn), u"CN=Test User,O=Example,C=DE"_s);
+
+        // changing the attribute order invalidates the cached result
+        DNAttributes::setOrder({u"C"_s, u"_X_"_s, u"CN"_s});
+        QCOMPARE(Formatting::prettyDN(dn), u"C=DE,O=Example,EMAIL=test@example.net,CN=Test User"_s);
+
+        DNAttributes::setOrder(originalOrder);
+    }
+
+    void test_prettyName_and_prettyEMail_of_smime_user_id()
+    {
+        const char *dn = "CN= Test User ,O=Example,EMAIL=test@example.net";
+
+        QCOMPARE(Formatting::prettyName(GpgME::CMS, dn, nullptr, nullptr), u"Test User"_s);
+        QCOMPARE(Formatting::prettyEMail(nullptr, dn), u"test@example.net"_s);
+        QCOMPARE(Formatting::prettyName(GpgME::CMS, "O=Example,C=DE", nullptr, nullptr), Formatting::prettyDN("O=Example,C=DE"));
+    }
+
     void test_accessibleHexID_data()
     {
         QTest::addColumn<QByteArray>("id");
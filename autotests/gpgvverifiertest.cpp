@@ -0,0 +1,235 @@
+/*
+    This file is part of libkleopatra's test suite.
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <Libkleo/GpgvVerifier>
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QObject>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <algorithm>
+#include <memory>
+
+using namespace Kleo;
+
+namespace
+{
+// A fake gpgv which reads the verdict and an optional delay from the signature
+// file. It records the number of running instances in $FAKE_GPGV_STATE.
+const char fakeGpgvScript[] = R"(#!/bin/sh
+while [ "$1" != "--" ]; do shift; done
+shift
+touch "$FAKE_GPGV_STATE/running.$$"
+ls "$FAKE_GPGV_STATE" | grep -c '^running\.' >> "$FAKE_GPGV_STATE/counts.log"
+read verdict delay < "$1"
+sleep "${delay:-0}"
+rm -f "$FAKE_GPGV_STATE/running.$$"
+echo "checked $2"
+if [ "$verdict" = "good" ]; then
+    exit 0
+fi
+echo "BAD signature" >&2
+exit 1
+)";
+}
+
+class GpgvVerifierTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        mTempDir = std::make_unique<QTemporaryDir>();
+        QVERIFY(mTempDir->isValid());
+        QVERIFY(QDir{mTempDir->path()}.mkdir(QStringLiteral("bin")));
+        QFile script{binDir() + QStringLiteral("/gpgv")};
+        QVERIFY(script.open(QIODevice::WriteOnly));
+        QVERIFY(script.write(fakeGpgvScript) > 0);
+        script.close();
+        QVERIFY(script.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner));
+    }
+
+    void init()
+    {
+        mStateDir = std::make_unique<QTemporaryDir>();
+        QVERIFY(mStateDir->isValid());
+        qputenv("FAKE_GPGV_STATE", mStateDir->path().toLocal8Bit());
+    }
+
+    void cleanup()
+    {
+        qunsetenv("FAKE_GPGV_STATE");
+        mStateDir.reset();
+    }
+
+    void test_filesAreVerified()
+    {
+        const auto goodFile = createFile(QStringLiteral("good.txt"), "good");
+        const auto badFile = createFile(QStringLiteral("bad.txt"), "bad");
+        const auto otherSignature = createFile(QStringLiteral("other.txt"), "good", QStringLiteral("other.sig"));
+        const auto unsignedFile = createFile(QStringLiteral("unsigned.txt"), {});
+
+        GpgvVerifier verifier;
+        verifier.setAdditionalSearchPaths({binDir()});
+        QSignalSpy fileVerifiedSpy{&verifier, &GpgvVerifier::fileVerified};
+        QSignalSpy finishedSpy{&verifier, &GpgvVerifier::finished};
+        verifier.start({{.filePath = goodFile}, {.filePath = badFile}, {.filePath = otherSignature, .signaturePath = filePath(QStringLiteral("other.sig"))}, {.filePath = unsignedFile}});
+        QVERIFY(verifier.isRunning());
+        // the signals are emitted asynchronously
+        QCOMPARE(fileVerifiedSpy.size(), 0);
+
+        QVERIFY(finishedSpy.wait());
+        QVERIFY(!verifier.isRunning());
+        QCOMPARE(fileVerifiedSpy.size(), 4);
+        const auto results = verifier.results();
+        QCOMPARE(results.size(), 4);
+        QCOMPARE(results[0].filePath, goodFile);
+        QCOMPARE(results[0].signaturePath, goodFile + QStringLiteral(".sig"));
+        QVERIFY(results[0].verified);
+        QCOMPARE(results[0].exitCode, 0);
+        QVERIFY(results[0].standardOutput.startsWith("checked "));
+        QVERIFY(!results[1].verified);
+        QCOMPARE(results[1].exitCode, 1);
+        QCOMPARE(results[1].standardError, "BAD signature\n");
+        QVERIFY(results[2].verified);
+        // gpgv isn't run for a file without signature
+        QVERIFY(!results[3].verified);
+        QCOMPARE(results[3].exitCode, -1);
+        QVERIFY(!results[3].errorString.isEmpty());
+    }
+
+    void test_numberOfProcessesIsLimited()
+    {
+        std::vector<GpgvVerifier::Task> tasks;
+        for (int i = 0; i < 6; ++i) {
+            tasks.push_back({.filePath = createFile(QStringLiteral("file%1.txt").arg(i), "good 0.2")});
+        }
+
+        GpgvVerifier verifier;
+        verifier.setAdditionalSearchPaths({binDir()});
+        verifier.setMaxConcurrentProcesses(2);
+        QSignalSpy finishedSpy{&verifier, &GpgvVerifier::finished};
+        QElapsedTimer timer;
+        timer.start();
+        verifier.start(tasks);
+
+        QVERIFY(finishedSpy.wait(10000));
+        const auto results = verifier.results();
+        QVERIFY(std::ranges::all_of(results, &GpgvVerifier::Result::verified));
+        // 6 files with 2 processes at a time take at least 3 rounds
+        QVERIFY(timer.elapsed() >= 600);
+        const auto counts = readFile(mStateDir->path() + QStringLiteral("/counts.log")).split('\n', Qt::SkipEmptyParts);
+        QCOMPARE(counts.size(), 6);
+        QVERIFY(std::ranges::all_of(counts, [](const auto &count) {
+            return count.toInt() <= 2;
+        }));
+    }
+
+    void test_cancel()
+    {
+        std::vector<GpgvVerifier::Task> tasks;
+        for (int i = 0; i < 4; ++i) {
+            tasks.push_back({.filePath = createFile(QStringLiteral("slow%1.txt").arg(i), "good 5")});
+        }
+
+        GpgvVerifier verifier;
+        verifier.setAdditionalSearchPaths({binDir()});
+        verifier.setMaxConcurrentProcesses(2);
+        QSignalSpy finishedSpy{&verifier, &GpgvVerifier::finished};
+        verifier.start(tasks);
+        QTest::qWait(500);
+        QElapsedTimer timer;
+        timer.start();
+        verifier.cancel();
+
+        QVERIFY(finishedSpy.wait(5000));
+        QVERIFY(timer.elapsed() < 2000);
+        const auto results = verifier.results();
+        QVERIFY(std::ranges::all_of(results, &GpgvVerifier::Result::canceled));
+        QVERIFY(std::ranges::none_of(results, &GpgvVerifier::Result::verified));
+        // the files that were still waiting haven't been checked
+        QCOMPARE(readFile(mStateDir->path() + QStringLiteral("/counts.log")).count('\n'), 2);
+    }
+
+    void test_cancelBeforeStart()
+    {
+        GpgvVerifier verifier;
+        verifier.setAdditionalSearchPaths({binDir()});
+        QSignalSpy finishedSpy{&verifier, &GpgvVerifier::finished};
+        verifier.start({{.filePath = createFile(QStringLiteral("file.txt"), "good")}});
+        verifier.cancel();
+
+        QCOMPARE(finishedSpy.size(), 1);
+        QVERIFY(!verifier.isRunning());
+        QVERIFY(verifier.results().front().canceled);
+        QTest::qWait(100);
+        QCOMPARE(finishedSpy.size(), 1);
+    }
+
+    void test_gpgvNotFound()
+    {
+        const QTemporaryDir emptyDir;
+        GpgvVerifier verifier;
+        verifier.setAdditionalSearchPaths({emptyDir.path()});
+        QSignalSpy finishedSpy{&verifier, &GpgvVerifier::finished};
+        verifier.start({{.filePath = createFile(QStringLiteral("file.txt"), "good")}});
+
+        QVERIFY(finishedSpy.wait());
+        const auto results = verifier.results();
+        QVERIFY(!results.front().verified);
+        QVERIFY(!results.front().errorString.isEmpty());
+    }
+
+private:
+    QString binDir() const
+    {
+        return mTempDir->path() + QStringLiteral("/bin");
+    }
+
+    QString filePath(const QString &fileName) const
+    {
+        return mStateDir->path() + u'/' + fileName;
+    }
+
+    // creates a file with a signature with the given contents if @p signature isn't empty
+    QString createFile(const QString &fileName, const QByteArray &signature, const QString &signatureFileName = {})
+    {
+        const QString path = filePath(fileName);
+        QFile file{path};
+        if (!file.open(QIODevice::WriteOnly) || file.write("data") < 0) {
+            return {};
+        }
+        if (!signature.isEmpty()) {
+            QFile sigFile{signatureFileName.isEmpty() ? path + QStringLiteral(".sig") : filePath(signatureFileName)};
+            if (!sigFile.open(QIODevice::WriteOnly) || sigFile.write(signature + '\n') < 0) {
+                return {};
+            }
+        }
+        return path;
+    }
+
+    static QByteArray readFile(const QString &path)
+    {
+        QFile file{path};
+        if (!file.open(QIODevice::ReadOnly)) {
+            return {};
+        }
+        return file.readAll();
+    }
+
+private:
+    std::unique_ptr<QTemporaryDir> mTempDir;
+    std::unique_ptr<QTemporaryDir> mStateDir;
+};
+
+QTEST_MAIN(GpgvVerifierTest)
+#include "gpgvverifiertest.moc"
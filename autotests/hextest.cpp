@@ -8,8 +8,13 @@
 
 #include <Libkleo/Hex>
 
+#include <Libkleo/KleoException>
+
+#include <QRandomGenerator>
 #include <QTest>
 
+#include <optional>
+
 using namespace Kleo;
 
 namespace QTest
@@ -19,6 +24,94 @@ inline char *toString(const std::string &s)
 {
     return qstrdup(('"' + s + '"').c_str());
 }
+
+template<>
+inline char *toString(const std::optional<std::string> &s)
+{
+    return s ? toString(*s) : qstrdup("std::nullopt");
+}
+}
+
+namespace
+{
+// the former byte-wise implementation of hexdecode() and hexencode(); used as reference
+std::optional<std::string> referenceHexdecode(const std::string &in)
+{
+    const auto unhex = [](unsigned char ch) -> int {
+        if (ch >= '0' && ch <= '9') {
+            return ch - '0';
+        }
+        if (ch >= 'A' && ch <= 'F') {
+            return ch - 'A' + 10;
+        }
+        if (ch >= 'a' && ch <= 'f') {
+            return ch - 'a' + 10;
+        }
+        return -1;
+    };
+    std::string result;
+    for (auto it = in.begin(), end = in.end(); it != end; ++it) {
+        if (*it == '%') {
+            if (++it == end) {
+                return std::nullopt;
+            }
+            const int high = unhex(*it);
+            if (high < 0 || ++it == end) {
+                return std::nullopt;
+            }
+            const int low = unhex(*it);
+            if (low < 0) {
+                return std::nullopt;
+            }
+            result.push_back(char(high << 4 | low));
+        } else if (*it == '+') {
+            result += ' ';
+        } else {
+            result.push_back(*it);
+        }
+    }
+    return result;
+}
+
+std::string referenceHexencode(const std::string &in)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    std::string result;
+    for (const unsigned char ch : in) {
+        switch (ch) {
+        default:
+            if ((ch >= '!' && ch <= '~') || ch > 0xA0) {
+                result += ch;
+                break;
+            }
+            [[fallthrough]];
+        case ' ':
+            result += '+';
+            break;
+        case '"':
+        case '#':
+        case '$':
+        case '%':
+        case '\'':
+        case '+':
+        case '=':
+            result += '%';
+            result += hex[(ch & 0xF0) >> 4];
+            result += hex[(ch & 0x0F)];
+            break;
+        }
+    }
+    return result;
+}
+
+std::string randomString(QRandomGenerator &generator, const std::string &alphabet, int maxLength)
+{
+    std::string result(generator.bounded(maxLength + 1), '\0');
+    for (auto &ch : result) {
+        ch = alphabet[generator.bounded(int(alphabet.size()))];
+    }
+    return result;
+}
 }
 
 class HexTest : public QObject
@@ -47,6 +140,75 @@ private Q_SLOTS:
         QCOMPARE(hexdecode(std::string{"+"}), std::string{" "});
         QCOMPARE(hexdecode(QByteArray{"+"}), QByteArray{" "});
     }
+
+    void test_hexdecode_errors()
+    {
+        QVERIFY_THROWS_EXCEPTION(Kleo::Exception, hexdecode("%"));
+        QVERIFY_THROWS_EXCEPTION(Kleo::Exception, hexdecode("%2"));
+        QVERIFY_THROWS_EXCEPTION(Kleo::Exception, hexdecode("%2x"));
+        QVERIFY_THROWS_EXCEPTION(Kleo::Exception, hexdecode("%x2"));
+        QVERIFY(!tryHexdecode("%"));
+        QVERIFY(!tryHexdecode("abc%2"));
+        QVERIFY(!tryHexdecode("%2x"));
+        QVERIFY(!tryHexdecode("%x2"));
+        QCOMPARE(tryHexdecode("a%2Bb+c").value(), std::string{"a+b c"});
+        QCOMPARE(tryHexdecode("").value(), std::string{});
+    }
+
+    void test_hexencode()
+    {
+        QCOMPARE(hexencode(nullptr), std::string{});
+        QCOMPARE(hexencode("abc"), std::string{"abc"});
+        QCOMPARE(hexencode("a b"), std::string{"a+b"});
+        QCOMPARE(hexencode("a+b=c%d"), std::string{"a%2Bb%3Dc%25d"});
+        QCOMPARE(hexencode("\"#$'"), std::string{"%22%23%24%27"});
+        QCOMPARE(hexencode(QByteArray{"a\tb"}), QByteArray{"a+b"});
+    }
+
+    void test_equivalence_with_reference_implementation()
+    {
+        // all single characters
+        for (int ch = 1; ch < 256; ++ch) {
+            const std::string s(1, char(ch));
+            QCOMPARE(hexencode(s), referenceHexencode(s));
+            QCOMPARE(tryHexdecode(s), referenceHexdecode(s));
+        }
+        // random strings; the alphabet for decoding makes valid and invalid escapes likely
+        QRandomGenerator generator{42};
+        std::string allCharacters;
+        for (int ch = 0; ch < 256; ++ch) {
+            allCharacters.push_back(char(ch));
+        }
+        for (int i = 0; i < 10000; ++i) {
+            const auto s = randomString(generator, allCharacters, 40);
+            QCOMPARE(hexencode(s), referenceHexencode(s));
+            QCOMPARE(hexdecode(hexencode(s)).size(), s.size());
+            const auto encoded = randomString(generator, "%%%+09afAFgx z", 20);
+            QCOMPARE(tryHexdecode(encoded), referenceHexdecode(encoded));
+        }
+    }
+
+    void test_hexToBinary()
+    {
+        QCOMPARE(hexToBinary("").value(), std::string{});
+        QCOMPARE(hexToBinary("00ff7Fa0").value(), std::string("\x00\xff\x7f\xa0", 4));
+        QCOMPARE(hexToBinary("1BA323932B3FAA826132C79E8D9860C58F246DE6").value().size(), std::size_t{20});
+        QVERIFY(!hexToBinary("0"));
+        QVERIFY(!hexToBinary("0g"));
+        QVERIFY(!hexToBinary("g0"));
+        QVERIFY(!hexToBinary("%20"));
+    }
+
+    void benchmark_hexdecode()
+    {
+        std::string encoded;
+        for (int i = 0; i < 1000; ++i) {
+            encoded += "D%3A%5CUsers%5Cjohn+doe%5Cdocuments%5Creport.pdf%0A";
+        }
+        QBENCHMARK {
+            (void)hexdecode(encoded);
+        }
+    }
 };
 
 QTEST_MAIN(HexTest)
@@ -0,0 +1,165 @@
+/*
+    This file is part of libkleopatra's test suite.
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <Libkleo/KeyCache>
+#include <Libkleo/KeyGroup>
+#include <Libkleo/KeyGroupConfig>
+
+#include <QDir>
+#include <QFile>
+#include <QObject>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <gpgme++/key.h>
+
+#include <gpgme.h>
+
+#include <memory>
+
+using namespace Kleo;
+using namespace GpgME;
+
+namespace
+{
+Key createTestKey(const char *uid, const char *fingerprint)
+{
+    gpgme_key_t key;
+    gpgme_key_from_uid(&key, uid);
+    key->fpr = strdup(fingerprint);
+
+    return Key(key, false);
+}
+
+const char *fpr1 = "0000000000000000000000000000000000000001";
+const char *fpr2 = "0000000000000000000000000000000000000002";
+
+bool writeFile(const QString &fileName, const QByteArray &content)
+{
+    QFile file{fileName};
+    return file.open(QIODevice::WriteOnly) && file.write(content) == content.size();
+}
+
+QStringList keyFingerprints(const KeyGroup &group)
+{
+    QStringList result;
+    for (const auto &key : group.keys()) {
+        result.push_back(QString::fromLatin1(key.primaryFingerprint()));
+    }
+    return result;
+}
+}
+
+class KeyGroupConfigTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init()
+    {
+        mTmpDir = std::make_unique<QTemporaryDir>();
+        QVERIFY(mTmpDir->isValid());
+        mConfigFile = QDir{mTmpDir->path()}.absoluteFilePath(QStringLiteral("groupsrc"));
+        QVERIFY(writeFile(mConfigFile,
+                          "[Group-a]\n"
+                          "Name=Group A\n"
+                          "Keys=0000000000000000000000000000000000000001,0000000000000000000000000000000000000002\n"
+                          "\n"
+                          "[Group-b]\n"
+                          "Name=Group B\n"
+                          "Keys=0000000000000000000000000000000000000002\n"));
+        KeyCache::mutableInstance()->setKeys({
+            createTestKey("test1@example.net", fpr1),
+            createTestKey("test2@example.net", fpr2),
+        });
+    }
+
+    void cleanup()
+    {
+        mTmpDir.reset();
+    }
+
+    void test_readGroups()
+    {
+        KeyGroupConfig config{mConfigFile};
+
+        const auto groups = config.readGroups();
+        QCOMPARE(groups.size(), 2);
+        QCOMPARE(groups[0].id(), QStringLiteral("a"));
+        QCOMPARE(groups[0].name(), QStringLiteral("Group A"));
+        QCOMPARE(keyFingerprints(groups[0]), (QStringList{QLatin1StringView{fpr1}, QLatin1StringView{fpr2}}));
+        QCOMPARE(groups[1].id(), QStringLiteral("b"));
+        QCOMPARE(keyFingerprints(groups[1]), QStringList{QLatin1StringView{fpr2}});
+    }
+
+    void test_keysAreBoundAgainAfterKeyRefresh()
+    {
+        KeyGroupConfig config{mConfigFile};
+        QCOMPARE(keyFingerprints(config.readGroups()[0]).size(), 2);
+
+        KeyCache::mutableInstance()->setKeys({
+            createTestKey("test1@example.net", fpr1),
+        });
+        const auto groups = config.readGroups();
+        QCOMPARE(keyFingerprints(groups[0]), QStringList{QLatin1StringView{fpr1}});
+        QVERIFY(groups[1].keys().empty());
+    }
+
+    void test_changedConfigFileIsReadAgain()
+    {
+        KeyGroupConfig config{mConfigFile};
+        QCOMPARE(config.readGroups().size(), 2);
+
+        QVERIFY(writeFile(mConfigFile,
+                          "[Group-a]\n"
+                          "Name=Renamed Group A\n"
+                          "Keys=0000000000000000000000000000000000000001,0000000000000000000000000000000000000002\n"));
+        const auto groups = config.readGroups();
+        QCOMPARE(groups.size(), 1);
+        QCOMPARE(groups[0].name(), QStringLiteral("Renamed Group A"));
+        QCOMPARE(keyFingerprints(groups[0]).size(), 2);
+    }
+
+    void test_sameSizeChangeOfConfigFileIsReadAgain()
+    {
+        KeyGroupConfig config{mConfigFile};
+        QCOMPARE(config.readGroups()[0].name(), QStringLiteral("Group A"));
+
+        // same size and (very likely) the same modification time as before
+        QVERIFY(writeFile(mConfigFile,
+                          "[Group-a]\n"
+                          "Name=Group X\n"
+                          "Keys=0000000000000000000000000000000000000001,0000000000000000000000000000000000000002\n"
+                          "\n"
+                          "[Group-b]\n"
+                          "Name=Group B\n"
+                          "Keys=0000000000000000000000000000000000000002\n"));
+        QCOMPARE(config.readGroups()[0].name(), QStringLiteral("Group X"));
+    }
+
+    void test_writtenGroupIsRead()
+    {
+        KeyGroupConfig config{mConfigFile};
+        QCOMPARE(config.readGroups().size(), 2);
+
+        KeyGroup group{QStringLiteral("c"), QStringLiteral("Group C"), {}, KeyGroup::ApplicationConfig};
+        group.setKeys(std::vector<Key>{KeyCache::instance()->findByFingerprint(fpr1)});
+        QVERIFY(!config.writeGroup(group).isNull());
+
+        const auto groups = config.readGroups();
+        QCOMPARE(groups.size(), 3);
+        QCOMPARE(groups[2].name(), QStringLiteral("Group C"));
+        QCOMPARE(keyFingerprints(groups[2]), QStringList{QLatin1StringView{fpr1}});
+    }
+
+private:
+    std::unique_ptr<QTemporaryDir> mTmpDir;
+    QString mConfigFile;
+};
+
+QTEST_MAIN(KeyGroupConfigTest)
+#include "keygroupconfigtest.moc"
@@ -21,6 +21,7 @@
 #include <QObject>
 #include <QProcess>
 #include <QTest>
+#include <QThread>
 
 #include <gpgme++/key.h>
 
@@ -1435,6 +1436,108 @@ private Q_SLOTS:
         QCOMPARE(result.solution.signingKeys[0].primaryFingerprint(), testKey("sender-mixed@example.net", CMS).primaryFingerprint());
     }
 
+    void test_repeated_resolution_uses_memoized_results_of_key_cache()
+    {
+        const auto statisticsBefore = mKeyCache->resolutionCacheStatistics();
+        {
+            KeyResolverCore resolver(/*encrypt=*/true, /*sign=*/false);
+            resolver.setRecipients({u"prefer-openpgp@example.net"_s});
+
+            const auto result = resolver.resolve();
+
+            QCOMPARE(result.flags & KeyResolverCore::ResolvedMask, KeyResolverCore::AllResolved);
+        }
+        const auto statisticsAfterFirstResolution = mKeyCache->resolutionCacheStatistics();
+        QVERIFY(statisticsAfterFirstResolution.misses > statisticsBefore.misses);
+
+        KeyResolverCore resolver(/*encrypt=*/true, /*sign=*/false);
+        resolver.setRecipients({u"prefer-openpgp@example.net"_s});
+
+        const auto result = resolver.resolve();
+
+        QCOMPARE(result.flags & KeyResolverCore::ResolvedMask, KeyResolverCore::AllResolved);
+        QCOMPARE(result.solution.encryptionKeys.value(u"prefer-openpgp@example.net"_s)[0].primaryFingerprint(),
+                 testKey("prefer-openpgp@example.net", OpenPGP).primaryFingerprint());
+        const auto statisticsAfterSecondResolution = mKeyCache->resolutionCacheStatistics();
+        QCOMPARE(statisticsAfterSecondResolution.misses, statisticsAfterFirstResolution.misses);
+        QVERIFY(statisticsAfterSecondResolution.hits > statisticsAfterFirstResolution.hits);
+    }
+
+    void test_memoized_results_are_invalidated_when_keys_change()
+    {
+        {
+            KeyResolverCore resolver(/*encrypt=*/true, /*sign=*/false, OpenPGP);
+            resolver.setRecipients({u"prefer-openpgp@example.net"_s});
+            QCOMPARE(resolver.resolve().flags & KeyResolverCore::ResolvedMask, KeyResolverCore::AllResolved);
+        }
+
+        KeyCache::mutableInstance()->remove(testKey("prefer-openpgp@example.net", OpenPGP));
+
+        KeyResolverCore resolver(/*encrypt=*/true, /*sign=*/false, OpenPGP);
+        resolver.setRecipients({u"prefer-openpgp@example.net"_s});
+
+        const auto result = resolver.resolve();
+
+        QCOMPARE(result.flags & KeyResolverCore::ResolvedMask, KeyResolverCore::SomeUnresolved);
+        QCOMPARE(result.solution.encryptionKeys.value(u"prefer-openpgp@example.net"_s).size(), 0);
+    }
+
+    void test_resolution_in_other_thread_using_snapshot_of_key_cache()
+    {
+        KeyResolverCore resolver(/*encrypt=*/true, /*sign=*/true);
+        resolver.setSender(QStringLiteral("sender-mixed@example.net"));
+        resolver.setRecipients({u"prefer-openpgp@example.net"_s, u"prefer-smime@example.net"_s});
+        resolver.setKeyCache(mKeyCache->snapshot());
+        int lastProgress = 0;
+        int progressTotal = 0;
+        resolver.setProgressCallback([&lastProgress, &progressTotal](int current, int total) {
+            lastProgress = current;
+            progressTotal = total;
+        });
+
+        KeyResolverCore::Result result;
+        std::unique_ptr<QThread> thread{QThread::create([&resolver, &result]() {
+            result = resolver.resolve();
+        })};
+        thread->start();
+        QVERIFY(thread->wait());
+        resolver.setKeyCache({});
+
+        QCOMPARE(result.flags & KeyResolverCore::ResolvedMask, KeyResolverCore::AllResolved);
+        QCOMPARE(result.solution.encryptionKeys.size(), 3);
+        QVERIFY(lastProgress > 0);
+        QCOMPARE(progressTotal, 6);
+    }
+
+    void test_canceled_resolution_reports_error()
+    {
+        KeyResolverCore resolver(/*encrypt=*/true, /*sign=*/false);
+        resolver.setRecipients({u"prefer-openpgp@example.net"_s, u"prefer-smime@example.net"_s});
+        resolver.setProgressCallback([&resolver](int, int) {
+            resolver.cancel();
+        });
+
+        const auto result = resolver.resolve();
+
+        QVERIFY(resolver.isCanceled());
+        QCOMPARE(result.flags & KeyResolverCore::ResolvedMask, KeyResolverCore::Error);
+    }
+
+    void test_resolution_after_reset_of_cancellation_is_not_canceled()
+    {
+        KeyResolverCore resolver(/*encrypt=*/true, /*sign=*/true);
+        resolver.setAllowMixedProtocols(false);
+        resolver.setSender(QStringLiteral("sender-mixed@example.net"));
+        resolver.cancel();
+        QVERIFY(resolver.isCanceled());
+
+        resolver.resetCanceled();
+        const auto result = resolver.resolve();
+
+        QVERIFY(!resolver.isCanceled());
+        QCOMPARE(result.flags & KeyResolverCore::ResolvedMask, KeyResolverCore::AllResolved);
+    }
+
 private:
     Key testKey(const char *email, Protocol protocol = UnknownProtocol)
     {
@@ -0,0 +1,165 @@
+/*
+    This file is part of libkleopatra's test suite.
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <Libkleo/GnuPG>
+
+#include <utils/secretkeyfile_p.h>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <gpgme++/global.h>
+
+#include <memory>
+
+using namespace Kleo;
+
+namespace
+{
+const char keyGrip[] = "0123456789ABCDEF0123456789ABCDEF01234567";
+
+// a private key file in the extended key format with the given token lines
+QByteArray keyFile(const QByteArray &tokenLines, const QByteArray &lineBreak = "\n")
+{
+    QByteArray content = "Created: 20260101T120000" + lineBreak //
+        + "Key: (shadowed-private-key (ecc (curve Ed25519)" + lineBreak //
+        + " (q #40ABCDEF#)" + lineBreak //
+        + " (shadowed t1-v1 (#D2760001240103040006123456780000# OPENPGP.1))))" + lineBreak;
+    for (const auto &line : tokenLines.split('\n')) {
+        if (!line.isEmpty()) {
+            content += line + lineBreak;
+        }
+    }
+    return content;
+}
+}
+
+class SecretKeyFileTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        mGnupgHome = std::make_unique<QTemporaryDir>();
+        QVERIFY(mGnupgHome->isValid());
+        qputenv("GNUPGHOME", mGnupgHome->path().toLocal8Bit());
+        GpgME::initializeLibrary();
+    }
+
+    void cleanupTestCase()
+    {
+        mGnupgHome.reset();
+        qunsetenv("GNUPGHOME");
+    }
+
+    void test_tokenLinesAreReturned()
+    {
+        const auto lines = SecretKeyFile::scanCardTokenLines(keyFile(
+            "Token: D2760001240103040006123456780000 OPENPGP.1 - - -\n"
+            "Token: D2760001240103040006876543210000 OPENPGP.1 - - -"));
+        QCOMPARE(lines.size(), 2);
+        QCOMPARE(lines[0], "Token: D2760001240103040006123456780000 OPENPGP.1 - - -");
+        QCOMPARE(lines[1], "Token: D2760001240103040006876543210000 OPENPGP.1 - - -");
+    }
+
+    void test_lastLineWithoutLineBreak()
+    {
+        QByteArray content = keyFile({});
+        content += "Token: D2760001240103040006123456780000 OPENPGP.1 - - -";
+        const auto lines = SecretKeyFile::scanCardTokenLines(content);
+        QCOMPARE(lines.size(), 1);
+        QCOMPARE(lines[0], "Token: D2760001240103040006123456780000 OPENPGP.1 - - -");
+    }
+
+    void test_crlfLineBreaks()
+    {
+        const auto lines = SecretKeyFile::scanCardTokenLines(keyFile("Token: D2760001240103040006123456780000 OPENPGP.1 - - -", "\r\n"));
+        QCOMPARE(lines.size(), 1);
+        QCOMPARE(lines[0], "Token: D2760001240103040006123456780000 OPENPGP.1 - - -");
+    }
+
+    void test_continuationLinesAreSkipped()
+    {
+        const auto lines = SecretKeyFile::scanCardTokenLines(
+            "Key: (shadowed-private-key (rsa\n"
+            " Token: this is part of the Key item\n"
+            "\tToken: this is part of the Key item, too\n"
+            " ))\n"
+            "Token: D2760001240103040006123456780000 OPENPGP.1 - - -\n");
+        QCOMPARE(lines.size(), 1);
+        QCOMPARE(lines[0], "Token: D2760001240103040006123456780000 OPENPGP.1 - - -");
+    }
+
+    void test_fileWithoutTokens()
+    {
+        QVERIFY(SecretKeyFile::scanCardTokenLines(keyFile({})).empty());
+        QVERIFY(SecretKeyFile::scanCardTokenLines({}).empty());
+    }
+
+    void test_oldFormatIsNotScanned()
+    {
+        const auto lines = SecretKeyFile::scanCardTokenLines(
+            "(21:protected-private-key(3:rsa(1:n3:abc)\n"
+            "Token: D2760001240103040006123456780000 OPENPGP.1 - - -\n"
+            "))");
+        QVERIFY(lines.empty());
+    }
+
+    void test_resultsAreCachedUntilTheFileChanges()
+    {
+        const QString keysDir = Kleo::gnupgPrivateKeysDirectory();
+        if (!keysDir.startsWith(mGnupgHome->path())) {
+            QSKIP("The GnuPG home directory cannot be changed for the test");
+        }
+        QVERIFY(QDir{}.mkpath(keysDir));
+        const QString path = QDir{keysDir}.filePath(QLatin1StringView{keyGrip} + QLatin1StringView{".key"});
+        const QString grip = QLatin1StringView{keyGrip};
+
+        QVERIFY(writeFile(path, keyFile("Token: AAAA OPENPGP.1 - - -")));
+        QCOMPARE(SecretKeyFile::cardTokenLines(grip), std::vector<QByteArray>{"Token: AAAA OPENPGP.1 - - -"});
+
+        // a file with the same size and modification time isn't scanned again
+        const QDateTime lastModified = QFileInfo{path}.lastModified();
+        QVERIFY(writeFile(path, keyFile("Token: BBBB OPENPGP.1 - - -")));
+        QVERIFY(setLastModified(path, lastModified));
+        QCOMPARE(SecretKeyFile::cardTokenLines(grip), std::vector<QByteArray>{"Token: AAAA OPENPGP.1 - - -"});
+
+        // a file with a different size is scanned again
+        QVERIFY(writeFile(path, keyFile("Token: CCCCCC OPENPGP.1 - - -")));
+        QVERIFY(setLastModified(path, lastModified));
+        QCOMPARE(SecretKeyFile::cardTokenLines(grip), std::vector<QByteArray>{"Token: CCCCCC OPENPGP.1 - - -"});
+
+        // a removed file has no tokens
+        QVERIFY(QFile::remove(path));
+        QVERIFY(SecretKeyFile::cardTokenLines(grip).empty());
+    }
+
+private:
+    static bool writeFile(const QString &path, const QByteArray &content)
+    {
+        QFile file{path};
+        return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(content) == content.size();
+    }
+
+    static bool setLastModified(const QString &path, const QDateTime &lastModified)
+    {
+        QFile file{path};
+        return file.open(QIODevice::ReadWrite) && file.setFileTime(lastModified, QFileDevice::FileModificationTime);
+    }
+
+private:
+    std::unique_ptr<QTemporaryDir> mGnupgHome;
+};
+
+QTEST_MAIN(SecretKeyFileTest)
+#include "secretkeyfiletest.moc"
@@ -11,6 +11,7 @@
 
 #include "checksumdefinition.h"
 
+#include "checksumengine.h"
 #include "kleoexception.h"
 
 #include <libkleo_debug.h>
@@ -375,6 +376,15 @@ bool ChecksumDefinition::startVerifyCommand(QProcess *p, const QStringList &file
                          m_verifyMethod);
 }
 
+std::unique_ptr<ChecksumEngine> ChecksumDefinition::createEngine() const
+{
+    const auto algorithm = ChecksumEngine::algorithmForDefinition(*this);
+    if (!algorithm) {
+        return {};
+    }
+    return std::make_unique<ChecksumEngine>(*algorithm);
+}
+
 // static
 std::vector<std::shared_ptr<ChecksumDefinition>> ChecksumDefinition::getChecksumDefinitions()
 {
@@ -22,6 +22,8 @@ class QProcess;
 namespace Kleo
 {
 
+class ChecksumEngine;
+
 class KLEO_EXPORT ChecksumDefinition
 {
 protected:
@@ -71,6 +73,15 @@ public:
     bool startCreateCommand(QProcess *process, const QStringList &files) const;
     bool startVerifyCommand(QProcess *process, const QStringList &files) const;
 
+    /**
+     * Returns an engine that creates and verifies the checksum files of this
+     * definition in-process instead of running createCommand() and
+     * verifyCommand(), or a null pointer if the checksums of this definition
+     * cannot be computed in-process. Use outputFileName() as output file
+     * name of ChecksumEngine::startCreate().
+     */
+    std::unique_ptr<ChecksumEngine> createEngine() const;
+
     static QString installPath();
     static void setInstallPath(const QString &ip);
 
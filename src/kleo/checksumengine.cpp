@@ -0,0 +1,452 @@
+/*
+    This file is part of libkleopatra, the KDE keymanagement library
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-libkleo.h>
+
+#include "checksumengine.h"
+
+#include "checksumdefinition.h"
+
+#include <libkleo_debug.h>
+
+#include <KLocalizedString>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+
+using namespace Kleo;
+
+namespace
+{
+// the files are read in chunks of this size; each chunk is also a progress step
+constexpr qint64 bufferSize = 1024 * 1024;
+
+QByteArray encodeFileName(const QString &fileName)
+{
+#ifdef Q_OS_WIN
+    return fileName.toUtf8();
+#else
+    return QFile::encodeName(fileName);
+#endif
+}
+
+QString decodeFileName(const QByteArray &fileName)
+{
+#ifdef Q_OS_WIN
+    return QString::fromUtf8(fileName);
+#else
+    return QFile::decodeName(fileName);
+#endif
+}
+
+bool needsEscaping(const QByteArray &fileName)
+{
+    return fileName.contains('\\') || fileName.contains('\n') || fileName.contains('\r');
+}
+
+QByteArray escapeFileName(const QByteArray &fileName)
+{
+    QByteArray escaped;
+    escaped.reserve(fileName.size() + 8);
+    for (const char ch : fileName) {
+        switch (ch) {
+        case '\\':
+            escaped += "\\\\";
+            break;
+        case '\n':
+            escaped += "\\n";
+            break;
+        case '\r':
+            escaped += "\\r";
+            break;
+        default:
+            escaped += ch;
+        }
+    }
+    return escaped;
+}
+
+std::optional<QByteArray> unescapeFileName(QByteArrayView fileName)
+{
+    QByteArray unescaped;
+    unescaped.reserve(fileName.size());
+    for (qsizetype i = 0; i < fileName.size(); ++i) {
+        if (fileName[i] != '\\') {
+            unescaped += fileName[i];
+            continue;
+        }
+        if (++i == fileName.size()) {
+            return std::nullopt;
+        }
+        switch (fileName[i]) {
+        case '\\':
+            unescaped += '\\';
+            break;
+        case 'n':
+            unescaped += '\n';
+            break;
+        case 'r':
+            unescaped += '\r';
+            break;
+        default:
+            return std::nullopt;
+        }
+    }
+    return unescaped;
+}
+
+bool isHexDigit(char ch)
+{
+    return (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F');
+}
+
+using ProgressFunction = std::function<void(qint64, qint64)>;
+
+ChecksumEngine::Status hashFile(const QString &fileName,
+                                QCryptographicHash::Algorithm algorithm,
+                                const std::atomic<bool> *canceled,
+                                const ProgressFunction &progress,
+                                QByteArray &checksum,
+                                QString &errorString)
+{
+    QFile file{fileName};
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorString = file.errorString();
+        return ChecksumEngine::ReadError;
+    }
+    const qint64 total = file.size();
+    QCryptographicHash hash{algorithm};
+    QByteArray buffer{static_cast<qsizetype>(bufferSize), Qt::Uninitialized};
+    qint64 processed = 0;
+    while (true) {
+        if (canceled && canceled->load(std::memory_order_relaxed)) {
+            return ChecksumEngine::Canceled;
+        }
+        const qint64 n = file.read(buffer.data(), buffer.size());
+        if (n < 0) {
+            errorString = file.errorString();
+            return ChecksumEngine::ReadError;
+        }
+        if (n == 0) {
+            break;
+        }
+        hash.addData(QByteArrayView{buffer.constData(), static_cast<qsizetype>(n)});
+        processed += n;
+        if (progress) {
+            progress(processed, total);
+        }
+    }
+    checksum = hash.result().toHex();
+    return ChecksumEngine::Ok;
+}
+}
+
+class ChecksumEngine::Private
+{
+    friend class ::Kleo::ChecksumEngine;
+    ChecksumEngine *const q;
+
+public:
+    Private(ChecksumEngine *qq, QCryptographicHash::Algorithm algorithm)
+        : q{qq}
+        , m_algorithm{algorithm}
+    {
+    }
+
+    ~Private()
+    {
+        m_canceled = true;
+        m_pool.waitForDone();
+    }
+
+private:
+    bool prepareStart();
+    void start(const QDir &baseDirectory);
+    void fileDone(std::size_t index, const FileResult &result);
+    void finish();
+    void finishWithError(const QString &errorString);
+
+private:
+    const QCryptographicHash::Algorithm m_algorithm;
+    QThreadPool m_pool;
+    std::atomic<bool> m_canceled = false;
+    bool m_running = false;
+    std::vector<FileResult> m_results;
+    std::vector<QByteArray> m_expectedChecksums; // only set when verifying
+    std::size_t m_pendingFiles = 0;
+    QString m_outputFileName; // only set when creating
+    QString m_errorString;
+};
+
+bool ChecksumEngine::Private::prepareStart()
+{
+    if (m_running) {
+        qCWarning(LIBKLEO_LOG) << "ChecksumEngine: an operation is already running";
+        return false;
+    }
+    m_running = true;
+    m_canceled = false;
+    m_results.clear();
+    m_expectedChecksums.clear();
+    m_pendingFiles = 0;
+    m_outputFileName.clear();
+    m_errorString.clear();
+    return true;
+}
+
+void ChecksumEngine::Private::start(const QDir &baseDirectory)
+{
+    m_pendingFiles = m_results.size();
+    if (m_pendingFiles == 0) {
+        QMetaObject::invokeMethod(
+            q,
+            [this]() {
+                finish();
+            },
+            Qt::QueuedConnection);
+        return;
+    }
+    for (std::size_t i = 0; i < m_results.size(); ++i) {
+        const QString fileName = m_results[i].fileName;
+        const QString path = baseDirectory.filePath(fileName);
+        m_pool.start([this, i, fileName, path]() {
+            FileResult result{fileName, {}, Canceled, {}};
+            const auto progress = [this, &fileName](qint64 processed, qint64 total) {
+                QMetaObject::invokeMethod(
+                    q,
+                    [this, fileName, processed, total]() {
+                        Q_EMIT q->progress(fileName, processed, total);
+                    },
+                    Qt::QueuedConnection);
+            };
+            result.status = hashFile(path, m_algorithm, &m_canceled, progress, result.checksum, result.errorString);
+            QMetaObject::invokeMethod(
+                q,
+                [this, i, result]() {
+                    fileDone(i, result);
+                },
+                Qt::QueuedConnection);
+        });
+    }
+}
+
+void ChecksumEngine::Private::fileDone(std::size_t index, const FileResult &result)
+{
+    auto &fileResult = m_results[index];
+    fileResult = result;
+    if (fileResult.status == Ok && !m_expectedChecksums.empty() && fileResult.checksum != m_expectedChecksums[index]) {
+        fileResult.status = Mismatch;
+    }
+    Q_EMIT q->fileFinished(fileResult);
+    if (--m_pendingFiles == 0) {
+        finish();
+    }
+}
+
+void ChecksumEngine::Private::finish()
+{
+    bool success = !m_canceled && std::all_of(m_results.cbegin(), m_results.cend(), [](const auto &result) {
+        return result.status == Ok;
+    });
+    if (!m_canceled && !m_outputFileName.isEmpty()) {
+        QSaveFile file{m_outputFileName};
+        if (!file.open(QIODevice::WriteOnly) || file.write(formatChecksumFile(m_results)) < 0 || !file.commit()) {
+            m_errorString = i18n("Failed to write checksum file %1: %2", m_outputFileName, file.errorString());
+            success = false;
+        }
+    }
+    m_running = false;
+    Q_EMIT q->finished(success);
+}
+
+void ChecksumEngine::Private::finishWithError(const QString &errorString)
+{
+    m_errorString = errorString;
+    QMetaObject::invokeMethod(
+        q,
+        [this]() {
+            m_running = false;
+            Q_EMIT q->finished(false);
+        },
+        Qt::QueuedConnection);
+}
+
+ChecksumEngine::ChecksumEngine(QCryptographicHash::Algorithm algorithm, QObject *parent)
+    : QObject{parent}
+    , d{new Private{this, algorithm}}
+{
+}
+
+ChecksumEngine::~ChecksumEngine() = default;
+
+std::optional<QCryptographicHash::Algorithm> ChecksumEngine::algorithmForDefinition(const ChecksumDefinition &definition)
+{
+    const QString id = definition.id();
+    if (id == QLatin1StringView("sha256sum")) {
+        return QCryptographicHash::Sha256;
+    }
+    if (id == QLatin1StringView("sha1sum")) {
+        return QCryptographicHash::Sha1;
+    }
+    if (id == QLatin1StringView("sha512sum")) {
+        return QCryptographicHash::Sha512;
+    }
+    if (id == QLatin1StringView("md5sum")) {
+        return QCryptographicHash::Md5;
+    }
+    return std::nullopt;
+}
+
+QCryptographicHash::Algorithm ChecksumEngine::algorithm() const
+{
+    return d->m_algorithm;
+}
+
+void ChecksumEngine::setMaximumThreadCount(int count)
+{
+    d->m_pool.setMaxThreadCount(count);
+}
+
+void ChecksumEngine::startCreate(const QString &directory, const QStringList &files, const QString &outputFileName)
+{
+    if (!d->prepareStart()) {
+        return;
+    }
+    const QDir baseDirectory{directory};
+    d->m_outputFileName = baseDirectory.filePath(outputFileName);
+    d->m_results.reserve(files.size());
+    for (const auto &fileName : files) {
+        d->m_results.push_back({fileName, {}, Canceled, {}});
+    }
+    d->start(baseDirectory);
+}
+
+void ChecksumEngine::startVerify(const QString &checksumFileName)
+{
+    if (!d->prepareStart()) {
+        return;
+    }
+    QFile checksumFile{checksumFileName};
+    if (!checksumFile.open(QIODevice::ReadOnly)) {
+        d->finishWithError(i18n("Failed to read checksum file %1: %2", checksumFileName, checksumFile.errorString()));
+        return;
+    }
+    int invalidLines = 0;
+    const auto entries = parseChecksumFile(checksumFile.readAll(), &invalidLines);
+    const qsizetype checksumLength = 2 * QCryptographicHash::hashLength(d->m_algorithm);
+    for (const auto &entry : entries) {
+        if (entry.checksum.size() != checksumLength) {
+            ++invalidLines;
+            continue;
+        }
+        d->m_results.push_back({entry.fileName, {}, Canceled, {}});
+        d->m_expectedChecksums.push_back(entry.checksum);
+    }
+    if (invalidLines > 0) {
+        qCWarning(LIBKLEO_LOG) << "ChecksumEngine:" << checksumFileName << "contains" << invalidLines << "improperly formatted lines";
+    }
+    if (d->m_results.empty()) {
+        d->finishWithError(i18n("No properly formatted checksum lines found in %1.", checksumFileName));
+        return;
+    }
+    d->start(QFileInfo{checksumFileName}.absoluteDir());
+}
+
+void ChecksumEngine::cancel()
+{
+    d->m_canceled = true;
+}
+
+bool ChecksumEngine::isRunning() const
+{
+    return d->m_running;
+}
+
+std::vector<ChecksumEngine::FileResult> ChecksumEngine::results() const
+{
+    return d->m_results;
+}
+
+QString ChecksumEngine::errorString() const
+{
+    return d->m_errorString;
+}
+
+// static
+std::optional<QByteArray> ChecksumEngine::checksum(const QString &fileName, QCryptographicHash::Algorithm algorithm)
+{
+    QByteArray checksum;
+    QString errorString;
+    if (hashFile(fileName, algorithm, nullptr, {}, checksum, errorString) != Ok) {
+        qCDebug(LIBKLEO_LOG) << "ChecksumEngine: Failed to read" << fileName << ":" << errorString;
+        return std::nullopt;
+    }
+    return checksum;
+}
+
+// static
+QByteArray ChecksumEngine::formatChecksumFile(const std::vector<FileResult> &results)
+{
+    QByteArray content;
+    for (const auto &result : results) {
+        if (result.status != Ok && result.status != Mismatch) {
+            continue;
+        }
+        const QByteArray fileName = encodeFileName(result.fileName);
+        if (needsEscaping(fileName)) {
+            content += '\\' + result.checksum + "  " + escapeFileName(fileName) + '\n';
+        } else {
+            content += result.checksum + "  " + fileName + '\n';
+        }
+    }
+    return content;
+}
+
+// static
+std::vector<ChecksumEngine::Entry> ChecksumEngine::parseChecksumFile(const QByteArray &content, int *invalidLines)
+{
+    std::vector<Entry> entries;
+    int invalid = 0;
+    for (QByteArrayView line : QByteArrayView{content}.split('\n')) {
+        if (line.endsWith('\r')) {
+            line.chop(1);
+        }
+        if (line.isEmpty()) {
+            continue;
+        }
+        const bool escaped = line.startsWith('\\');
+        if (escaped) {
+            line = line.sliced(1);
+        }
+        const auto checksumLength = std::find_if_not(line.begin(), line.end(), isHexDigit) - line.begin();
+        // the checksum must be followed by a space and a space (text mode) or an asterisk (binary mode)
+        if (checksumLength == 0 || line.size() < checksumLength + 3 || line[checksumLength] != ' '
+            || (line[checksumLength + 1] != ' ' && line[checksumLength + 1] != '*')) {
+            ++invalid;
+            continue;
+        }
+        const auto fileName = escaped ? unescapeFileName(line.sliced(checksumLength + 2)) : line.sliced(checksumLength + 2).toByteArray();
+        if (!fileName) {
+            ++invalid;
+            continue;
+        }
+        entries.push_back({decodeFileName(*fileName), line.first(checksumLength).toByteArray().toLower()});
+    }
+    if (invalidLines) {
+        *invalidLines = invalid;
+    }
+    return entries;
+}
+
+#include "moc_checksumengine.cpp"
@@ -0,0 +1,156 @@
+/*
+    This file is part of libkleopatra, the KDE keymanagement library
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "kleo_export.h"
+
+#include <QCryptographicHash>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace Kleo
+{
+
+class ChecksumDefinition;
+
+/**
+ * In-process creation and verification of checksum files.
+ *
+ * ChecksumDefinition runs external tools like sha256sum in a single process.
+ * ChecksumEngine computes the checksums itself. Use
+ * ChecksumDefinition::createEngine() to get an engine for a definition. It hashes several files
+ * concurrently on a thread pool, reads the files with large buffers, and
+ * reports the progress per file. The checksum files it writes and reads use
+ * the format of the sha256sum, sha1sum, sha512sum, and md5sum tools, i.e.
+ * one line "<hex checksum>  <file name>" per file.
+ *
+ * The engine must be used from the thread it lives in. All signals are
+ * emitted in this thread.
+ */
+class KLEO_EXPORT ChecksumEngine : public QObject
+{
+    Q_OBJECT
+public:
+    enum Status {
+        Ok, //< the checksum was computed (and matches the expected checksum when verifying)
+        Mismatch, //< the computed checksum doesn't match the expected checksum
+        ReadError, //< the file couldn't be read
+        Canceled, //< the computation was canceled
+    };
+    Q_ENUM(Status)
+
+    struct FileResult {
+        QString fileName; // the file name as given to startCreate() or as listed in the checksum file
+        QByteArray checksum; // the computed checksum as lower-case hex string; empty if the file couldn't be read
+        Status status = Canceled;
+        QString errorString;
+    };
+
+    explicit ChecksumEngine(QCryptographicHash::Algorithm algorithm, QObject *parent = nullptr);
+    ~ChecksumEngine() override;
+
+    /**
+     * Returns the hash algorithm used by the tool of the checksum definition
+     * @a definition (identified by its id, e.g. "sha256sum") or std::nullopt
+     * if the checksums of this definition cannot be computed in-process.
+     */
+    static std::optional<QCryptographicHash::Algorithm> algorithmForDefinition(const ChecksumDefinition &definition);
+
+    QCryptographicHash::Algorithm algorithm() const;
+
+    /**
+     * Sets the maximum number of files that are hashed concurrently. The
+     * default is QThread::idealThreadCount().
+     */
+    void setMaximumThreadCount(int count);
+
+    /**
+     * Starts computing the checksums of @a files and writes them to the
+     * checksum file @a outputFileName. Relative file names are resolved
+     * relative to @a directory and are written as given to the checksum file;
+     * relative output file names are resolved relative to @a directory.
+     *
+     * The checksums of the files that could be read are written even if some
+     * files couldn't be read (like sha256sum does), but finished() reports
+     * a failure in this case.
+     */
+    void startCreate(const QString &directory, const QStringList &files, const QString &outputFileName);
+
+    /**
+     * Starts verifying the checksums listed in the checksum file
+     * @a checksumFileName. Relative file names listed in the checksum file
+     * are resolved relative to the folder of the checksum file.
+     */
+    void startVerify(const QString &checksumFileName);
+
+    /**
+     * Cancels the running operation. finished() is emitted when the files
+     * that are currently processed have been canceled.
+     */
+    void cancel();
+
+    bool isRunning() const;
+
+    /**
+     * Returns the results of the last operation in the order of the files
+     * given to startCreate() or listed in the checksum file.
+     */
+    std::vector<FileResult> results() const;
+
+    /**
+     * Returns a description of the last error that affected the operation as
+     * a whole, e.g. a failure to read or write the checksum file.
+     */
+    QString errorString() const;
+
+    /**
+     * Computes the checksum of the file @a fileName with @a algorithm in the
+     * calling thread. Returns the checksum as lower-case hex string or
+     * std::nullopt if the file couldn't be read.
+     */
+    static std::optional<QByteArray> checksum(const QString &fileName, QCryptographicHash::Algorithm algorithm);
+
+    /**
+     * Returns the content of a checksum file for the successfully computed
+     * checksums in @a results. File names containing a backslash or a line
+     * break are escaped like sha256sum does it.
+     */
+    static QByteArray formatChecksumFile(const std::vector<FileResult> &results);
+
+    struct Entry {
+        QString fileName;
+        QByteArray checksum; // lower-case hex string
+    };
+
+    /**
+     * Parses the content @a content of a checksum file. Lines that are not
+     * formatted correctly are skipped; their number is returned in
+     * @a invalidLines if it's not a null pointer.
+     */
+    static std::vector<Entry> parseChecksumFile(const QByteArray &content, int *invalidLines = nullptr);
+
+Q_SIGNALS:
+    /**
+     * Emitted repeatedly while the file @a fileName is hashed. @a total is the
+     * size of the file.
+     */
+    void progress(const QString &fileName, qint64 processed, qint64 total);
+    void fileFinished(const Kleo::ChecksumEngine::FileResult &result);
+    void finished(bool success);
+
+private:
+    class Private;
+    std::unique_ptr<Private> const d;
+};
+
+}
@@ -20,7 +20,13 @@
 
 #include "oidmap.h"
 
+#include "utils/dncache_p.h"
+
 #include <algorithm>
+#include <array>
+#include <cstring>
+#include <string>
+#include <string_view>
 
 #ifdef _MSC_VER
 #include <string.h>
@@ -37,6 +43,7 @@ public:
     Private(const Private &other)
         : attributes(other.attributes)
         , reorderedAttributes(other.reorderedAttributes)
+        , utf8DN(other.utf8DN)
         , mRefCount(0)
     {
     }
@@ -63,6 +70,8 @@ public:
 
     DN::Attribute::List attributes;
     DN::Attribute::List reorderedAttributes;
+    // the DN this DN was parsed from; cleared when the attributes are modified
+    QByteArray utf8DN;
 
 private:
     int mRefCount;
@@ -71,8 +80,8 @@ private:
 namespace
 {
 struct DnPair {
-    char *key;
-    char *value;
+    std::string_view key;
+    std::string_view value;
 };
 }
 
@@ -83,36 +92,24 @@ struct DnPair {
 #define xtoi_1(p) (*(p) <= '9' ? (*(p) - '0') : *(p) <= 'F' ? (*(p) - 'A' + 10) : (*(p) - 'a' + 10))
 #define xtoi_2(p) ((xtoi_1(p) * 16) + xtoi_1((p) + 1))
 
-static char *trim_trailing_spaces(char *string)
+static std::string_view trim_trailing_spaces(std::string_view string)
 {
-    char *p;
-    char *mark;
-
-    for (mark = nullptr, p = string; *p; p++) {
-        if (isspace(*p)) {
-            if (!mark) {
-                mark = p;
-            }
-        } else {
-            mark = nullptr;
-        }
+    while (!string.empty() && isspace(static_cast<unsigned char>(string.back()))) {
+        string.remove_suffix(1);
     }
-    if (mark) {
-        *mark = '\0';
-    }
-
     return string;
 }
 
-/* Parse a DN and return an array-ized one.  This is not a validating
-   parser and it does not support any old-stylish syntax; gpgme is
-   expected to return only rfc2253 compatible strings. */
-static const unsigned char *parse_dn_part(DnPair *array, const unsigned char *string)
+/* Parse a DN part.  The key of @p array points into @p string (or to a
+   static attribute name) and the unescaped value is appended to @p buffer
+   and the value of @p array points into @p buffer.  The caller has to
+   make sure that @p buffer has enough capacity for all values so that
+   it is never reallocated. */
+static const unsigned char *parse_dn_part(DnPair *array, const unsigned char *string, std::string &buffer)
 {
     const unsigned char *s;
     const unsigned char *s1;
     size_t n;
-    char *p;
 
     /* parse attributeType */
     for (s = string + 1; *s && *s != '='; s++) {
@@ -125,21 +122,14 @@ static const unsigned char *parse_dn_part(DnPair *array, const unsigned char *st
     if (!n) {
         return nullptr; /* empty key */
     }
-    p = (char *)malloc(n + 1);
-
-    // cppcheck-suppress nullPointerOutOfMemory
-    memcpy(p, string, n);
-    // cppcheck-suppress nullPointerOutOfMemory
-    p[n] = 0;
-    trim_trailing_spaces((char *)p);
+    array->key = trim_trailing_spaces(std::string_view{reinterpret_cast<const char *>(string), n});
     // map OIDs to their names:
-    if (const char *name = Kleo::attributeNameForOID(p)) {
-        free(p);
-        p = strdup(name);
+    if (const char *name = Kleo::attributeNameForOID(array->key)) {
+        array->key = name;
     }
-    array->key = p;
     string = s + 1;
 
+    const auto valueStart = buffer.size();
     if (*string == '#') {
         /* hexstring */
         string++;
@@ -149,24 +139,20 @@ static const unsigned char *parse_dn_part(DnPair *array, const unsigned char *st
         if (!n || (n & 1)) {
             return nullptr; /* empty or odd number of digits */
         }
-        n /= 2;
-        array->value = p = (char *)malloc(n + 1);
-
-        for (s1 = string; n; s1 += 2, n--) {
-            *p++ = xtoi_2(s1);
+        for (s1 = string; s1 != s; s1 += 2) {
+            buffer.push_back(char(xtoi_2(s1)));
         }
-        *p = 0;
     } else {
         /* regular v3 quoted string */
-        for (n = 0, s = string; *s; s++) {
+        for (s = string; *s; s++) {
             if (*s == '\\') {
                 /* pair */
                 s++;
                 if (*s == ',' || *s == '=' || *s == '+' || *s == '<' || *s == '>' || *s == '#' || *s == ';' || *s == '\\' || *s == '\"' || *s == ' ') {
-                    n++;
+                    buffer.push_back(char(*s));
                 } else if (hexdigitp(s) && hexdigitp(s + 1)) {
+                    buffer.push_back(char(xtoi_2(s)));
                     s++;
-                    n++;
                 } else {
                     return nullptr; /* invalid escape sequence */
                 }
@@ -175,28 +161,41 @@ static const unsigned char *parse_dn_part(DnPair *array, const unsigned char *st
             } else if (*s == ',' || *s == '=' || *s == '+' || *s == '<' || *s == '>' || *s == '#' || *s == ';') {
                 break;
             } else {
-                n++;
+                buffer.push_back(char(*s));
             }
         }
+    }
+    array->value = std::string_view{buffer}.substr(valueStart);
+    // an escaped null character terminates the value
+    array->value = array->value.substr(0, array->value.find('\0'));
+    return s;
+}
 
-        array->value = p = (char *)malloc(n + 1);
-
-        for (s = string; n; s++, n--) {
-            if (*s == '\\') {
-                s++;
-                if (hexdigitp(s)) {
-                    *p++ = xtoi_2(s);
-                    s++;
-                } else {
-                    *p++ = *s;
-                }
-            } else {
-                *p++ = *s;
-            }
+// returns the attribute name as QString; for the common attribute names static
+// string data is used to avoid allocating the same names over and over again
+// (the names are upper-case because DN::Attribute converts them to upper-case)
+static QString attributeName(std::string_view name)
+{
+    static const std::array<std::pair<std::string_view, QString>, 12> commonNames = {{
+        {"CN", QStringLiteral("CN")},
+        {"O", QStringLiteral("O")},
+        {"OU", QStringLiteral("OU")},
+        {"L", QStringLiteral("L")},
+        {"C", QStringLiteral("C")},
+        {"SP", QStringLiteral("SP")},
+        {"EMAIL", QStringLiteral("EMAIL")},
+        {"SN", QStringLiteral("SN")},
+        {"GN", QStringLiteral("GN")},
+        {"T", QStringLiteral("T")},
+        {"DC", QStringLiteral("DC")},
+        {"UID", QStringLiteral("UID")},
+    }};
+    for (const auto &[commonName, string] : commonNames) {
+        if (name == commonName) {
+            return string;
         }
-        *p = 0;
     }
-    return s;
+    return QString::fromUtf8(name.data(), name.size());
 }
 
 /* Parse a DN and return an array-ized one.  This is not a validating
@@ -214,6 +213,10 @@ static Kleo::DN::Attribute::List parse_dn(const unsigned char *string)
         QT_WARNING_POP
     }
 
+    // all unescaped values are stored in this buffer; they are never longer than the DN
+    std::string buffer;
+    buffer.reserve(strlen(reinterpret_cast<const char *>(string)));
+
     QT_WARNING_PUSH
     QT_WARNING_DISABLE_DEPRECATED
     QList<Kleo::DN::Attribute> result;
@@ -226,19 +229,15 @@ static Kleo::DN::Attribute::List parse_dn(const unsigned char *string)
             break; /* ready */
         }
 
-        DnPair pair = {nullptr, nullptr};
-        string = parse_dn_part(&pair, string);
+        DnPair pair;
+        string = parse_dn_part(&pair, string, buffer);
         if (!string) {
             goto failure;
         }
-        if (pair.key && pair.value) {
-            QT_WARNING_PUSH
-            QT_WARNING_DISABLE_DEPRECATED
-            result.push_back(Kleo::DN::Attribute(QString::fromUtf8(pair.key), QString::fromUtf8(pair.value)));
-            QT_WARNING_POP
-        }
-        free(pair.key);
-        free(pair.value);
+        QT_WARNING_PUSH
+        QT_WARNING_DISABLE_DEPRECATED
+        result.push_back(Kleo::DN::Attribute(attributeName(pair.key), QString::fromUtf8(pair.value.data(), pair.value.size())));
+        QT_WARNING_POP
 
         while (*string == ' ') {
             string++;
@@ -376,6 +375,7 @@ Kleo::DN::DN(const QString &dn)
     d = new Private();
     d->ref();
     d->attributes = parse_dn(dn);
+    d->utf8DN = dn.toUtf8();
 }
 
 Kleo::DN::DN(const char *utf8DN)
@@ -384,6 +384,7 @@ Kleo::DN::DN(const char *utf8DN)
     d->ref();
     if (utf8DN) {
         d->attributes = parse_dn((const unsigned char *)utf8DN);
+        d->utf8DN = utf8DN;
     }
 }
 
@@ -428,6 +429,10 @@ QString Kleo::DN::prettyDN() const
     if (!d) {
         return QString();
     }
+    if (!d->utf8DN.isEmpty()) {
+        // share the result with Formatting::prettyDN() for the same DN
+        return DNCache::lookup(d->utf8DN.constData()).prettyDN;
+    }
     if (d->reorderedAttributes.empty()) {
         d->reorderedAttributes = reorder_dn(d->attributes);
     }
@@ -480,6 +485,7 @@ void Kleo::DN::append(const Attribute &attr)
     detach();
     d->attributes.push_back(attr);
     d->reorderedAttributes.clear();
+    d->utf8DN.clear();
 }
 
 QString Kleo::DN::operator[](const QString &attr) const
@@ -10,6 +10,8 @@
 
 #include <libkleo_debug.h>
 
+#include "utils/dncache_p.h"
+
 #include <KLazyLocalizedString>
 
 #include <QMap>
@@ -91,6 +93,8 @@ QStringList Kleo::DNAttributes::order()
 void Kleo::DNAttributes::setOrder(const QStringList &order)
 {
     DNAttributeOrderStore::instance()->setAttributeOrder(order);
+    // the cached pretty DNs use the old order
+    DNCache::invalidate();
 }
 
 // static
@@ -17,9 +17,12 @@
 #include "debug.h"
 #include "expirycheckersettings.h"
 
+#include "utils/parallel_p.h"
+
 #include <libkleo/algorithm.h>
 #include <libkleo/formatting.h>
 #include <libkleo/keycache.h>
+#include <libkleo/predicates.h>
 #include <libkleo_debug.h>
 
 #include <KLocalizedString>
@@ -28,16 +31,23 @@
 #include <QGpgME/Protocol>
 
 #include <QTimeZone>
+#include <QTimer>
 
 #include <gpgme++/keylistresult.h>
 
+#include <algorithm>
+#include <iterator>
+#include <limits>
 #include <set>
+#include <unordered_map>
 
 #include <cmath>
 #include <ctime>
 
 using namespace Kleo;
 
+static const int maximumCertificateChainLength = 100;
+
 class Kleo::ExpiryCheckerPrivate
 {
     Kleo::ExpiryChecker *q;
@@ -47,16 +57,52 @@ public:
         : q{qq}
         , settings{settings_}
     {
+        notificationTimer.setSingleShot(true);
+        QObject::connect(&notificationTimer, &QTimer::timeout, q, [this]() {
+            checkForKeysReachingThreshold();
+        });
     }
 
+    qint64 currentTime() const;
+    QTimeZone timeZone() const;
+
     ExpiryChecker::Expiration calculateExpiration(const GpgME::Subkey &subkey) const;
+    ExpiryChecker::Expiration calculateExpiration(const GpgME::Key &key, ExpiryChecker::CheckFlags usageFlags) const;
     ExpiryChecker::Expiration checkForExpiration(const GpgME::Key &key, Kleo::chrono::days threshold, ExpiryChecker::CheckFlags flags) const;
 
     ExpiryChecker::Result checkKeyNearExpiry(const GpgME::Key &key, ExpiryChecker::CheckFlags flags);
+    void emitExpiryMessage(const GpgME::Key &key,
+                           const GpgME::Key &orig_key,
+                           const ExpiryChecker::Expiration &expiration,
+                           ExpiryChecker::CheckFlags flags,
+                           bool isChainCertificate);
+
+    const KeyCache &cache();
+    const std::vector<GpgME::Key> &chainCertificates(const GpgME::Key &key);
+    ExpiryChecker::Expiration chainCertificateExpiration(const GpgME::Key &certificate);
+    void clearMemoizedChains();
+
+    qint64 thresholdTime(const KeyCache::ExpiringKey &expiringKey) const;
+    void checkForKeysReachingThreshold();
 
     ExpiryCheckerSettings settings;
     std::set<QByteArray> alreadyWarnedFingerprints;
     std::shared_ptr<TimeProvider> timeProvider;
+    std::shared_ptr<const KeyCache> keyCache;
+
+    // memoized chain certificates and their expirations; cleared when the keys in the key cache change
+    std::unordered_map<std::string, std::vector<GpgME::Key>> memoizedChains; // issuer fingerprint -> issuer and its issuers
+    struct MemoizedExpiration {
+        ExpiryChecker::Expiration expiration; // expiration without threshold
+        QDate date; // the date the expiration was calculated for
+    };
+    std::unordered_map<std::string, MemoizedExpiration> memoizedExpirations; // fingerprint -> expiration
+
+    // state of the expiry notifications
+    bool notificationsEnabled = false;
+    ExpiryChecker::CheckFlags notificationFlags;
+    qint64 lastThresholdCheck = 0;
+    QTimer notificationTimer;
 };
 
 ExpiryChecker::ExpiryChecker(const ExpiryCheckerSettings &settings, QObject *parent)
@@ -431,14 +477,24 @@ static GpgME::Subkey findBestSubkey(const GpgME::Key &key, ExpiryChecker::CheckF
     return result;
 }
 
+qint64 ExpiryCheckerPrivate::currentTime() const
+{
+    return timeProvider ? timeProvider->currentTime() : QDateTime::currentSecsSinceEpoch();
+}
+
+QTimeZone ExpiryCheckerPrivate::timeZone() const
+{
+    return timeProvider ? timeProvider->timeZone() : QTimeZone{QTimeZone::LocalTime};
+}
+
 ExpiryChecker::Expiration ExpiryCheckerPrivate::calculateExpiration(const GpgME::Subkey &subkey) const
 {
     if (subkey.neverExpires()) {
         return {subkey.parent(), ExpiryChecker::NotNearExpiry, Kleo::chrono::days::zero()};
     }
-    const qint64 currentTime = timeProvider ? timeProvider->currentTime() : QDateTime::currentSecsSinceEpoch();
+    const qint64 currentTime = this->currentTime();
     const auto currentDate = timeProvider ? timeProvider->currentDate() : QDate::currentDate();
-    const auto timeZone = timeProvider ? timeProvider->timeZone() : QTimeZone{QTimeZone::LocalTime};
+    const auto timeZone = this->timeZone();
     // interpret the expiration time as unsigned 32-bit value if it's negative; gpg also uses uint32 internally
     const qint64 expirationTime = qint64(subkey.expirationTime() < 0 ? quint32(subkey.expirationTime()) : subkey.expirationTime());
     const auto expirationDate = QDateTime::fromSecsSinceEpoch(expirationTime, timeZone).date();
@@ -449,15 +505,17 @@ ExpiryChecker::Expiration ExpiryCheckerPrivate::calculateExpiration(const GpgME:
     }
 }
 
-ExpiryChecker::Expiration ExpiryCheckerPrivate::checkForExpiration(const GpgME::Key &key, //
-                                                                   Kleo::chrono::days threshold,
-                                                                   ExpiryChecker::CheckFlags usageFlags) const
+ExpiryChecker::Expiration ExpiryCheckerPrivate::calculateExpiration(const GpgME::Key &key, ExpiryChecker::CheckFlags usageFlags) const
 {
     const auto subkey = findBestSubkey(key, usageFlags);
     if (subkey.isNull()) {
         return {key, ExpiryChecker::NoSuitableSubkey, {}};
     }
-    ExpiryChecker::Expiration expiration = calculateExpiration(subkey);
+    return calculateExpiration(subkey);
+}
+
+static ExpiryChecker::Expiration applyThreshold(ExpiryChecker::Expiration expiration, Kleo::chrono::days threshold)
+{
     if ((expiration.status == ExpiryChecker::ExpiresSoon) && (expiration.duration > threshold)) {
         // key expires, but not too soon
         expiration.status = ExpiryChecker::NotNearExpiry;
@@ -465,61 +523,142 @@ ExpiryChecker::Expiration ExpiryCheckerPrivate::checkForExpiration(const GpgME::
     return expiration;
 }
 
+ExpiryChecker::Expiration ExpiryCheckerPrivate::checkForExpiration(const GpgME::Key &key, //
+                                                                   Kleo::chrono::days threshold,
+                                                                   ExpiryChecker::CheckFlags usageFlags) const
+{
+    return applyThreshold(calculateExpiration(key, usageFlags), threshold);
+}
+
+void ExpiryCheckerPrivate::emitExpiryMessage(const GpgME::Key &key,
+                                             const GpgME::Key &orig_key,
+                                             const ExpiryChecker::Expiration &expiration,
+                                             ExpiryChecker::CheckFlags flags,
+                                             bool isChainCertificate)
+{
+    if (expiration.status != ExpiryChecker::Expired && expiration.status != ExpiryChecker::ExpiresSoon) {
+        return;
+    }
+    const bool isOwnKey = flags & ExpiryChecker::OwnKey;
+    const QByteArray fingerprint{key.subkey(0).fingerprint()};
+    const bool newMessage = !alreadyWarnedFingerprints.count(fingerprint);
+    const QString msg = key.protocol() == GpgME::OpenPGP //
+        ? formatOpenPGPMessage(expiration, flags)
+        : formatSMIMEMessage(orig_key, expiration, flags, isChainCertificate);
+    alreadyWarnedFingerprints.insert(fingerprint);
+    if (expiration.status == ExpiryChecker::Expired) {
+        Q_EMIT q->expiryMessage(key, msg, isOwnKey ? ExpiryChecker::OwnKeyExpired : ExpiryChecker::OtherKeyExpired, newMessage);
+    } else {
+        Q_EMIT q->expiryMessage(key, msg, isOwnKey ? ExpiryChecker::OwnKeyNearExpiry : ExpiryChecker::OtherKeyNearExpiry, newMessage);
+    }
+}
+
+namespace
+{
+// returns the chain certificates of @p key, i.e. its issuer, the issuer's issuer, etc.;
+// the chain ends with a root certificate, a missing issuer, or before a certificate that
+// occurs twice
+std::vector<GpgME::Key> findChainCertificates(const KeyCache &cache, const GpgME::Key &key)
+{
+    if (key.isRoot()) {
+        return {};
+    }
+    const auto &issuer = cache.findByFingerprint(key.chainID());
+    if (issuer.isNull()) {
+        return {};
+    }
+    auto chain = cache.findIssuers(issuer, KeyCache::RecursiveSearch | KeyCache::IncludeSubject);
+    if (chain.size() > 1) {
+        const auto &last = chain.back();
+        const bool lastIsDuplicate = std::any_of(chain.cbegin(), std::prev(chain.cend()), [&last](const auto &k) {
+            return _detail::ByFingerprint<std::equal_to>()(k, last);
+        });
+        if (lastIsDuplicate) {
+            chain.pop_back();
+        }
+    }
+    return chain;
+}
+}
+
+const KeyCache &ExpiryCheckerPrivate::cache()
+{
+    if (!keyCache) {
+        keyCache = KeyCache::instance();
+        QObject::connect(keyCache.get(), &KeyCache::keysMayHaveChanged, q, [this]() {
+            clearMemoizedChains();
+            if (notificationsEnabled) {
+                checkForKeysReachingThreshold();
+            }
+        });
+    }
+    return *keyCache;
+}
+
+const std::vector<GpgME::Key> &ExpiryCheckerPrivate::chainCertificates(const GpgME::Key &key)
+{
+    static const std::vector<GpgME::Key> emptyChain;
+    if (key.isRoot() || !key.chainID()) {
+        return emptyChain;
+    }
+    const auto [it, inserted] = memoizedChains.try_emplace(key.chainID());
+    if (inserted) {
+        it->second = findChainCertificates(cache(), key);
+    }
+    return it->second;
+}
+
+ExpiryChecker::Expiration ExpiryCheckerPrivate::chainCertificateExpiration(const GpgME::Key &certificate)
+{
+    const auto currentDate = timeProvider ? timeProvider->currentDate() : QDate::currentDate();
+    const auto [it, inserted] = memoizedExpirations.try_emplace(certificate.primaryFingerprint());
+    auto &memo = it->second;
+    // the expiration changes if the day changes or if the certificate expires
+    if (inserted || memo.date != currentDate
+        || (memo.expiration.status == ExpiryChecker::ExpiresSoon && quint32(certificate.subkey(0).expirationTime()) <= currentTime())) {
+        memo.expiration = calculateExpiration(certificate, {});
+        memo.date = currentDate;
+    }
+    return memo.expiration;
+}
+
+void ExpiryCheckerPrivate::clearMemoizedChains()
+{
+    memoizedChains.clear();
+    memoizedExpirations.clear();
+}
+
 ExpiryChecker::Result ExpiryCheckerPrivate::checkKeyNearExpiry(const GpgME::Key &orig_key, ExpiryChecker::CheckFlags flags)
 {
-    static const int maximumCertificateChainLength = 100;
     const bool isOwnKey = flags & ExpiryChecker::OwnKey;
 
     ExpiryChecker::Result result;
     result.checkFlags = flags;
-    result.expiration.certificate = orig_key;
-
-    // use vector instead of set because certificate chains are usually very short
-    std::vector<std::string> checkedCertificates;
-    auto key = orig_key;
-    for (int chainCount = 0; chainCount < maximumCertificateChainLength; ++chainCount) {
-        checkedCertificates.push_back(key.primaryFingerprint());
 
-        const GpgME::Subkey subkey = key.subkey(0);
-
-        const bool newMessage = !alreadyWarnedFingerprints.count(subkey.fingerprint());
+    const auto threshold = isOwnKey ? settings.ownKeyThreshold() : settings.otherKeyThreshold();
+    result.expiration = checkForExpiration(orig_key, threshold, flags & ExpiryChecker::UsageMask);
+    result.expiration.certificate = orig_key;
+    emitExpiryMessage(orig_key, orig_key, result.expiration, flags, false);
+    if (result.expiration.status == ExpiryChecker::NoSuitableSubkey //
+        || !(flags & ExpiryChecker::CheckChain) || orig_key.isRoot() || (orig_key.protocol() != GpgME::CMS)) {
+        return result;
+    }
 
-        const auto threshold = chainCount > 0 //
-            ? (key.isRoot() ? settings.rootCertThreshold() : settings.chainCertThreshold()) //
-            : (isOwnKey ? settings.ownKeyThreshold() : settings.otherKeyThreshold());
-        const auto usageFlags = (chainCount == 0) ? (flags & ExpiryChecker::UsageMask) : ExpiryChecker::CheckFlags{};
-        const auto expiration = checkForExpiration(key, threshold, usageFlags);
-        if (chainCount == 0) {
-            result.expiration = expiration;
-        } else if (expiration.status != ExpiryChecker::NotNearExpiry) {
-            result.chainExpiration.push_back(expiration);
-        }
-        if (expiration.status == ExpiryChecker::Expired) {
-            const QString msg = key.protocol() == GpgME::OpenPGP //
-                ? formatOpenPGPMessage(expiration, flags)
-                : formatSMIMEMessage(orig_key, expiration, flags, chainCount > 0);
-            alreadyWarnedFingerprints.insert(subkey.fingerprint());
-            Q_EMIT q->expiryMessage(key, msg, isOwnKey ? ExpiryChecker::OwnKeyExpired : ExpiryChecker::OtherKeyExpired, newMessage);
-        } else if (expiration.status == ExpiryChecker::ExpiresSoon) {
-            const QString msg = key.protocol() == GpgME::OpenPGP //
-                ? formatOpenPGPMessage(expiration, flags)
-                : formatSMIMEMessage(orig_key, expiration, flags, chainCount > 0);
-            alreadyWarnedFingerprints.insert(subkey.fingerprint());
-            Q_EMIT q->expiryMessage(key, msg, isOwnKey ? ExpiryChecker::OwnKeyNearExpiry : ExpiryChecker::OtherKeyNearExpiry, newMessage);
-        } else if (expiration.status == ExpiryChecker::NoSuitableSubkey) {
-            break;
+    const auto &chain = chainCertificates(orig_key);
+    for (std::size_t chainCount = 0; chainCount < chain.size() && chainCount + 1 < std::size_t(maximumCertificateChainLength); ++chainCount) {
+        const auto &key = chain[chainCount];
+        if (_detail::ByFingerprint<std::equal_to>()(key, orig_key)) {
+            break; // the checked certificate was already checked (looks like a circle in the chain)
         }
-        if (!(flags & ExpiryChecker::CheckChain) || key.isRoot() || (key.protocol() != GpgME::CMS)) {
-            break;
+        const auto threshold = key.isRoot() ? settings.rootCertThreshold() : settings.chainCertThreshold();
+        const auto expiration = applyThreshold(chainCertificateExpiration(key), threshold);
+        if (expiration.status != ExpiryChecker::NotNearExpiry) {
+            result.chainExpiration.push_back(expiration);
         }
-        const auto keys = KeyCache::instance()->findIssuers(key, KeyCache::NoOption);
-        if (keys.empty()) {
+        emitExpiryMessage(key, orig_key, expiration, flags, true);
+        if (expiration.status == ExpiryChecker::NoSuitableSubkey) {
             break;
         }
-        key = keys.front();
-        if (Kleo::contains(checkedCertificates, key.primaryFingerprint())) {
-            break; // this certificate was already checked (looks like a circle in the chain)
-        }
     }
     return result;
 }
@@ -537,9 +676,188 @@ ExpiryChecker::Result ExpiryChecker::checkKey(const GpgME::Key &key, CheckFlags
     return d->checkKeyNearExpiry(key, flags);
 }
 
+std::vector<ExpiryChecker::Result> ExpiryChecker::checkKeys(const std::vector<GpgME::Key> &keys, CheckFlags flags, Kleo::chrono::days threshold) const
+{
+    if (!(flags & UsageMask)) {
+        qWarning(LIBKLEO_LOG) << __func__ << "called with invalid flags:" << flags;
+        return {};
+    }
+
+    // look up the chains of all issuers in this thread because the key cache must not be used concurrently
+    std::unordered_map<std::string, const std::vector<GpgME::Key> *> chains; // issuer fingerprint -> chain certificates of the issuers' subjects
+    std::vector<GpgME::Key> chainCertificates;
+    std::unordered_map<std::string, std::size_t> chainCertificateIndexes;
+    if (flags & CheckChain) {
+        for (const auto &key : keys) {
+            if (key.isNull() || key.isRoot() || key.protocol() != GpgME::CMS || !key.chainID()) {
+                continue;
+            }
+            const auto [it, inserted] = chains.try_emplace(key.chainID());
+            if (!inserted) {
+                continue;
+            }
+            it->second = &d->chainCertificates(key);
+            for (const auto &certificate : *it->second) {
+                if (chainCertificateIndexes.try_emplace(certificate.primaryFingerprint(), chainCertificates.size()).second) {
+                    chainCertificates.push_back(certificate);
+                }
+            }
+        }
+    }
+
+    // calculate the expiration of each chain certificate once
+    std::vector<Expiration> chainCertificateExpirations(chainCertificates.size());
+    Kleo::Private::forEachIndexInParallel(chainCertificates.size(), [&](std::size_t i) {
+        chainCertificateExpirations[i] = applyThreshold(d->calculateExpiration(chainCertificates[i], {}), threshold);
+    });
+
+    std::vector<Result> results(keys.size());
+    Kleo::Private::forEachIndexInParallel(keys.size(), [&](std::size_t i) {
+        const auto &key = keys[i];
+        auto &result = results[i];
+        result.checkFlags = flags;
+        if (key.isNull()) {
+            result.expiration = {key, InvalidKey, {}};
+            return;
+        }
+        result.expiration = applyThreshold(d->calculateExpiration(key, flags & UsageMask), threshold);
+        if (result.expiration.status == NoSuitableSubkey || !(flags & CheckChain) || key.isRoot() || key.protocol() != GpgME::CMS || !key.chainID()) {
+            return;
+        }
+        const auto &chain = *chains.at(key.chainID());
+        for (std::size_t chainCount = 0; chainCount < chain.size() && chainCount + 1 < std::size_t(maximumCertificateChainLength); ++chainCount) {
+            const auto &certificate = chain[chainCount];
+            if (_detail::ByFingerprint<std::equal_to>()(certificate, key)) {
+                break; // the key is part of a circle in the chain
+            }
+            const auto &expiration = chainCertificateExpirations[chainCertificateIndexes.at(certificate.primaryFingerprint())];
+            if (expiration.status != NotNearExpiry) {
+                result.chainExpiration.push_back(expiration);
+            }
+            if (expiration.status == NoSuitableSubkey) {
+                break;
+            }
+        }
+    });
+
+    results.erase(std::remove_if(results.begin(),
+                                 results.end(),
+                                 [](const Result &result) {
+                                     const auto status = result.expiration.status;
+                                     return status != Expired && status != ExpiresSoon && result.chainExpiration.empty();
+                                 }),
+                  results.end());
+    return results;
+}
+
+QString ExpiryChecker::formatMessage(const Result &result, const Expiration &expiration)
+{
+    if (expiration.status != Expired && expiration.status != ExpiresSoon) {
+        return {};
+    }
+    const auto &key = expiration.certificate;
+    if (key.protocol() == GpgME::OpenPGP) {
+        return formatOpenPGPMessage(expiration, result.checkFlags);
+    }
+    const auto &checkedKey = result.expiration.certificate;
+    const bool isChainCertificate = !_detail::ByFingerprint<std::equal_to>()(key, checkedKey);
+    return formatSMIMEMessage(checkedKey, expiration, result.checkFlags, isChainCertificate);
+}
+
+static KeyCache::KeyUsage keyUsage(ExpiryChecker::CheckFlags usageFlags)
+{
+    switch (usageFlags.toInt()) {
+    case ExpiryChecker::EncryptionKey:
+        return KeyCache::KeyUsage::Encrypt;
+    case ExpiryChecker::SigningKey:
+        return KeyCache::KeyUsage::Sign;
+    case ExpiryChecker::CertificationKey:
+        return KeyCache::KeyUsage::Certify;
+    default:
+        return KeyCache::KeyUsage::AnyUsage;
+    }
+}
+
+qint64 ExpiryCheckerPrivate::thresholdTime(const KeyCache::ExpiringKey &expiringKey) const
+{
+    // a key reaches its threshold at the start of the day which is threshold days before the expiration date
+    const auto threshold = expiringKey.key.hasSecret() ? settings.ownKeyThreshold() : settings.otherKeyThreshold();
+    const auto zone = timeZone();
+    const auto expirationDate = QDateTime::fromSecsSinceEpoch(expiringKey.expirationTime, zone).date();
+    return expirationDate.addDays(-threshold.count()).startOfDay(zone).toSecsSinceEpoch();
+}
+
+void ExpiryCheckerPrivate::checkForKeysReachingThreshold()
+{
+    const qint64 now = currentTime();
+    const auto index = cache().keysByExpirationTime(keyUsage(notificationFlags & ExpiryChecker::UsageMask));
+    // a key reaches its threshold at most threshold + 1 days before it expires; add another day to account for DST changes
+    const qint64 maximumLeadTime =
+        std::chrono::seconds{std::max(settings.ownKeyThreshold(), settings.otherKeyThreshold()) + Kleo::chrono::days{2}}.count();
+
+    std::vector<GpgME::Key> keysReachingThreshold;
+    qint64 nextThresholdTime = std::numeric_limits<qint64>::max();
+    // keys that reach their threshold after the last check expire after the last check
+    auto it = std::upper_bound(index.begin(), index.end(), lastThresholdCheck, [](qint64 time, const KeyCache::ExpiringKey &expiringKey) {
+        return time < expiringKey.expirationTime;
+    });
+    for (; it != index.end() && it->expirationTime - maximumLeadTime <= nextThresholdTime; ++it) {
+        const qint64 time = thresholdTime(*it);
+        if (time <= lastThresholdCheck) {
+            continue;
+        }
+        if (time <= now) {
+            keysReachingThreshold.push_back(it->key);
+        } else {
+            nextThresholdTime = std::min(nextThresholdTime, time);
+        }
+    }
+    lastThresholdCheck = now;
+
+    if (nextThresholdTime == std::numeric_limits<qint64>::max()) {
+        notificationTimer.stop();
+    } else {
+        // QTimer cannot handle arbitrarily long intervals; check again after a day at the latest
+        static const qint64 maximumInterval = std::chrono::milliseconds{Kleo::chrono::days{1}}.count();
+        notificationTimer.start(int(std::min((nextThresholdTime - now) * 1000, maximumInterval)));
+    }
+
+    for (const auto &key : keysReachingThreshold) {
+        qCDebug(LIBKLEO_LOG) << __func__ << "Key" << key << "reached the expiry threshold";
+        q->checkKey(key, key.hasSecret() ? (notificationFlags | ExpiryChecker::OwnKey) : notificationFlags);
+    }
+}
+
+void ExpiryChecker::startExpiryNotifications(CheckFlags flags)
+{
+    const auto usageFlags = flags & UsageMask;
+    if (keyUsage(usageFlags) == KeyCache::KeyUsage::AnyUsage) {
+        qWarning(LIBKLEO_LOG) << __func__ << "called with invalid flags:" << flags;
+        return;
+    }
+    d->notificationsEnabled = true;
+    d->notificationFlags = flags & ~CheckFlags{OwnKey};
+    d->lastThresholdCheck = d->currentTime();
+    d->checkForKeysReachingThreshold();
+}
+
+void ExpiryChecker::stopExpiryNotifications()
+{
+    d->notificationsEnabled = false;
+    d->notificationTimer.stop();
+}
+
 void ExpiryChecker::setTimeProviderForTest(const std::shared_ptr<TimeProvider> &timeProvider)
 {
     d->timeProvider = timeProvider;
+    d->memoizedExpirations.clear();
+}
+
+void ExpiryChecker::checkExpiryNotificationsForTest()
+{
+    if (d->notificationsEnabled) {
+        d->checkForKeysReachingThreshold();
+    }
 }
 
 #include "moc_expirychecker.cpp"
@@ -102,11 +102,59 @@ public:
 
     Result checkKey(const GpgME::Key &key, CheckFlags flags) const;
 
+    /**
+     * Checks all @a keys for expiration within @a threshold days, e.g. to create
+     * a report for all keys of the key cache.
+     *
+     * Other than checkKey(), this function uses the same @a threshold for all
+     * certificates, it doesn't emit expiryMessage(), and it doesn't build any
+     * messages. Use formatMessage() to create messages for the results of
+     * interest. The chain certificates shared by several certificates are only
+     * checked once and the checks are run in parallel.
+     *
+     * @returns the results for the keys that have expired or expire within
+     * @a threshold days or that have a chain certificate that has expired or
+     * expires within @a threshold days.
+     */
+    std::vector<Result> checkKeys(const std::vector<GpgME::Key> &keys, CheckFlags flags, Kleo::chrono::days threshold) const;
+
+    /**
+     * Returns a localized message for the expiration @a expiration which must be
+     * either the expiration of the checked certificate or one of the expirations
+     * of its chain certificates in @a result. Returns an empty string if the
+     * certificate is neither expired nor near expiry.
+     */
+    static QString formatMessage(const Result &result, const Expiration &expiration);
+
+    /**
+     * Starts watching the keys of the key cache that can be used for the usage
+     * given by @a flags. @a flags must contain exactly one usage flag.
+     *
+     * Whenever one of the keys reaches the threshold for own keys (if there is
+     * a secret key) or for other keys, then the key is checked with checkKey()
+     * which emits expiryMessage(). The keys are not polled. Instead, a timer is
+     * set to fire when the next key reaches its threshold. Keys that have
+     * already reached their threshold when this function is called are not
+     * reported. Use checkKeys() to check those keys.
+     */
+    void startExpiryNotifications(CheckFlags flags);
+
+    /**
+     * Stops watching the keys of the key cache.
+     */
+    void stopExpiryNotifications();
+
 Q_SIGNALS:
     void expiryMessage(const GpgME::Key &key, QString msg, Kleo::ExpiryChecker::ExpiryInformation info, bool isNewMessage) const;
 
 public:
     void setTimeProviderForTest(const std::shared_ptr<TimeProvider> &);
+    /**
+     * Checks for keys which reached the expiry threshold like it's done when
+     * the timer started by startExpiryNotifications() fires. Use this together
+     * with a time provider whose time is advanced by the test.
+     */
+    void checkExpiryNotificationsForTest();
 
 private:
     std::unique_ptr<ExpiryCheckerPrivate> const d;
@@ -13,19 +13,26 @@
 #include "debug.h"
 #include "keygroup.h"
 
+#include <libkleo/fingerprint.h>
 #include <libkleo/keycache.h>
 #include <libkleo/keyhelpers.h>
-#include <libkleo/qtstlhelpers.h>
 
 #include <libkleo_debug.h>
 
 #include <KConfigGroup>
 #include <KSharedConfig>
 
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QStandardPaths>
 #include <QString>
 
 #include <gpgme++/key.h>
 
+#include <unordered_map>
+
 using namespace Kleo;
 using namespace GpgME;
 
@@ -41,10 +48,29 @@ public:
     bool removeGroup(const KeyGroup &group);
 
 private:
+    // a group as it's stored in the configuration file, i.e. without the keys
+    struct ParsedGroup {
+        QString id;
+        QString name;
+        QStringList keys;
+        std::vector<Fingerprint> fingerprints;
+        bool isImmutable = false;
+    };
+
+    QByteArray configFilesHash() const;
+    ParsedGroup parseGroup(const KConfigGroup &configGroup, const QString &groupId, const ParsedGroup *cachedGroup) const;
+    const ParsedGroup *findCachedGroup(const QString &groupId) const;
+    const std::vector<ParsedGroup> &parsedGroups() const;
+    void invalidateParsedGroups();
     KeyGroup readGroup(const KSharedConfigPtr &groupsConfig, const QString &groupId) const;
 
 private:
     QString filename;
+    // the groups parsed from the configuration files; they are re-parsed
+    // when the content of one of the files read by KConfig changes
+    mutable std::vector<ParsedGroup> cachedGroups;
+    mutable QByteArray cachedFilesHash;
+    mutable bool cacheIsValid = false;
 };
 
 KeyGroupConfig::Private::Private(const QString &filename)
@@ -55,37 +81,78 @@ KeyGroupConfig::Private::Private(const QString &filename)
     }
 }
 
-KeyGroup KeyGroupConfig::Private::readGroup(const KSharedConfigPtr &groupsConfig, const QString &groupId) const
+QByteArray KeyGroupConfig::Private::configFilesHash() const
 {
-    const KConfigGroup configGroup = groupsConfig->group(groupNamePrefix + groupId);
+    // hash the content of all files which KConfig merges, i.e. the cascaded
+    // system files (which may make groups immutable) and the global config
+    QStringList files = QFileInfo{filename}.isAbsolute() ? QStringList{filename} //
+                                                          : QStandardPaths::locateAll(QStandardPaths::GenericConfigLocation, filename);
+    files += QStandardPaths::locateAll(QStandardPaths::GenericConfigLocation, QStringLiteral("kdeglobals"));
+
+    QCryptographicHash hash{QCryptographicHash::Sha256};
+    for (const QString &fileName : std::as_const(files)) {
+        QFile file{fileName};
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        const QByteArray content = file.readAll();
+        hash.addData(fileName.toUtf8());
+        hash.addData(QByteArray::number(content.size()));
+        hash.addData(content);
+    }
+    return hash.result();
+}
 
-    const QString groupName = configGroup.readEntry("Name", QString());
-    const auto fingerprints = toStdStrings(configGroup.readEntry("Keys", QStringList()));
-    const std::vector<Key> groupKeys = KeyCache::instance()->findByFingerprint(fingerprints);
+// @p cachedGroup is the previously parsed version of the group or nullptr
+KeyGroupConfig::Private::ParsedGroup
+KeyGroupConfig::Private::parseGroup(const KConfigGroup &configGroup, const QString &groupId, const ParsedGroup *cachedGroup) const
+{
+    ParsedGroup group;
+    group.id = groupId;
+    group.name = configGroup.readEntry("Name", QString());
+    group.keys = configGroup.readEntry("Keys", QStringList());
+
+    // only convert the fingerprints of groups whose keys have changed
+    if (cachedGroup && cachedGroup->keys == group.keys) {
+        group.fingerprints = cachedGroup->fingerprints;
+    } else {
+        group.fingerprints = toFingerprints(group.keys);
+    }
 
     // treat group as immutable if any of its entries is immutable
     const QStringList entries = configGroup.keyList();
-    const bool isImmutable = (configGroup.isImmutable() //
-                              || std::any_of(entries.begin(), entries.end(), [configGroup](const QString &entry) {
-                                     return configGroup.isEntryImmutable(entry);
-                                 }));
+    group.isImmutable = (configGroup.isImmutable() //
+                         || std::any_of(entries.begin(), entries.end(), [configGroup](const QString &entry) {
+                                return configGroup.isEntryImmutable(entry);
+                            }));
 
-    KeyGroup g(groupId, groupName, groupKeys, KeyGroup::ApplicationConfig);
-    g.setIsImmutable(isImmutable);
-    // qCDebug(LIBKLEO_LOG) << "Read group" << g;
-
-    return g;
+    return group;
 }
 
-std::vector<KeyGroup> KeyGroupConfig::Private::readGroups() const
+const KeyGroupConfig::Private::ParsedGroup *KeyGroupConfig::Private::findCachedGroup(const QString &groupId) const
 {
-    qCDebug(LIBKLEO_LOG) << __func__ << "Reading groups";
-    std::vector<KeyGroup> groups;
+    const auto it = std::find_if(cachedGroups.cbegin(), cachedGroups.cend(), [&groupId](const auto &g) {
+        return g.id == groupId;
+    });
+    return it != cachedGroups.cend() ? &*it : nullptr;
+}
 
-    if (filename.isEmpty()) {
-        return groups;
+const std::vector<KeyGroupConfig::Private::ParsedGroup> &KeyGroupConfig::Private::parsedGroups() const
+{
+    const QByteArray filesHash = configFilesHash();
+    if (cacheIsValid && filesHash == cachedFilesHash) {
+        return cachedGroups;
     }
 
+    qCDebug(LIBKLEO_LOG) << __func__ << "Parsing groups";
+    // index the previously parsed groups by id, so that looking them up
+    // doesn't make re-parsing quadratic in the number of groups
+    QHash<QString, const ParsedGroup *> previousGroups;
+    previousGroups.reserve(cachedGroups.size());
+    for (const auto &group : cachedGroups) {
+        previousGroups.insert(group.id, &group);
+    }
+    std::vector<ParsedGroup> groups;
     const KSharedConfigPtr groupsConfig = KSharedConfig::openConfig(filename);
     const QStringList configGroups = groupsConfig->groupList();
     for (const QString &configGroupName : configGroups) {
@@ -96,9 +163,70 @@ std::vector<KeyGroup> KeyGroupConfig::Private::readGroups() const
                 qCWarning(LIBKLEO_LOG) << "Config group" << configGroupName << "has empty group id";
                 continue;
             }
-            KeyGroup group = readGroup(groupsConfig, keyGroupId);
-            groups.push_back(group);
+            groups.push_back(parseGroup(groupsConfig->group(configGroupName), keyGroupId, previousGroups.value(keyGroupId)));
+        }
+    }
+
+    cachedGroups = std::move(groups);
+    cachedFilesHash = filesHash;
+    cacheIsValid = true;
+    return cachedGroups;
+}
+
+void KeyGroupConfig::Private::invalidateParsedGroups()
+{
+    cacheIsValid = false;
+}
+
+KeyGroup KeyGroupConfig::Private::readGroup(const KSharedConfigPtr &groupsConfig, const QString &groupId) const
+{
+    const ParsedGroup parsedGroup = parseGroup(groupsConfig->group(groupNamePrefix + groupId), groupId, findCachedGroup(groupId));
+    const std::vector<Key> groupKeys = KeyCache::instance()->findByFingerprint(parsedGroup.fingerprints);
+
+    KeyGroup g(groupId, parsedGroup.name, groupKeys, KeyGroup::ApplicationConfig);
+    g.setIsImmutable(parsedGroup.isImmutable);
+    // qCDebug(LIBKLEO_LOG) << "Read group" << g;
+
+    return g;
+}
+
+std::vector<KeyGroup> KeyGroupConfig::Private::readGroups() const
+{
+    qCDebug(LIBKLEO_LOG) << __func__ << "Reading groups";
+    std::vector<KeyGroup> groups;
+
+    if (filename.isEmpty()) {
+        return groups;
+    }
+
+    const std::vector<ParsedGroup> &parsed = parsedGroups();
+
+    // look up the keys of all groups at once
+    std::vector<Fingerprint> fingerprints;
+    for (const auto &group : parsed) {
+        fingerprints.insert(fingerprints.end(), group.fingerprints.cbegin(), group.fingerprints.cend());
+    }
+    std::sort(fingerprints.begin(), fingerprints.end());
+    fingerprints.erase(std::unique(fingerprints.begin(), fingerprints.end()), fingerprints.end());
+    std::unordered_map<Fingerprint, Key> keysByFingerprint;
+    keysByFingerprint.reserve(fingerprints.size());
+    for (const Key &key : KeyCache::instance()->findByFingerprint(fingerprints)) {
+        keysByFingerprint.emplace(Fingerprint::fromKey(key), key);
+    }
+
+    groups.reserve(parsed.size());
+    for (const auto &parsedGroup : parsed) {
+        std::vector<Key> groupKeys;
+        groupKeys.reserve(parsedGroup.fingerprints.size());
+        for (const auto &fpr : parsedGroup.fingerprints) {
+            const auto it = keysByFingerprint.find(fpr);
+            if (it != keysByFingerprint.end()) {
+                groupKeys.push_back(it->second);
+            }
         }
+        KeyGroup g(parsedGroup.id, parsedGroup.name, groupKeys, KeyGroup::ApplicationConfig);
+        g.setIsImmutable(parsedGroup.isImmutable);
+        groups.push_back(g);
     }
 
     return groups;
@@ -121,6 +249,7 @@ KeyGroup KeyGroupConfig::Private::writeGroup(const KeyGroup &group)
     qCDebug(LIBKLEO_LOG) << __func__ << "Writing config group" << configGroup.name();
     configGroup.writeEntry("Name", group.name());
     configGroup.writeEntry("Keys", Kleo::getFingerprints(group.keys()));
+    invalidateParsedGroups();
 
     // reread group to ensure that it reflects the saved group in case of immutable entries
     return readGroup(groupsConfig, group.id());
@@ -142,6 +271,7 @@ bool KeyGroupConfig::Private::removeGroup(const KeyGroup &group)
 
     qCDebug(LIBKLEO_LOG) << __func__ << "Removing config group" << configGroup.name();
     configGroup.deleteGroup();
+    invalidateParsedGroups();
 
     return true;
 }
@@ -20,6 +20,7 @@
 
 #include "keyresolvercore.h"
 
+#include <libkleo/compliance.h>
 #include <libkleo/formatting.h>
 #include <libkleo/keycache.h>
 #include <libkleo/keygroup.h>
@@ -27,6 +28,9 @@
 
 #include <libkleo_debug.h>
 
+#include <QPointer>
+#include <QThread>
+
 #include <gpgme++/key.h>
 
 using namespace Kleo;
@@ -49,9 +53,17 @@ public:
         mCore.setAllowMixedProtocols(allowMixed);
     }
 
-    ~Private() = default;
+    ~Private()
+    {
+        if (mThread) {
+            mCore.cancel();
+            mThread->wait();
+        }
+    }
 
     KeyResolver::Solution expandUnresolvedGroups(KeyResolver::Solution solution);
+    void handleResult(KeyResolverCore::Result result, bool showApproval, QWidget *parent);
+    void asyncResolutionFinished(bool showApproval, QWidget *parent);
     void showApprovalDialog(KeyResolverCore::Result result, QWidget *parent);
     void dialogAccepted();
 
@@ -69,6 +81,8 @@ public:
     std::unique_ptr<NewKeyApprovalDialog> mDialog;
     Qt::WindowFlags mDialogWindowFlags;
     Protocol mPreferredProtocol;
+    std::unique_ptr<QThread> mThread;
+    KeyResolverCore::Result mAsyncResult;
 };
 
 static bool lessThan(const Key &leftKey, const Key &rightKey)
@@ -149,6 +163,35 @@ void KeyResolver::Private::dialogAccepted()
     Q_EMIT q->keysResolved(true, false);
 }
 
+void KeyResolver::Private::handleResult(KeyResolverCore::Result result, bool showApproval, QWidget *parent)
+{
+    const bool success = (result.flags & KeyResolverCore::AllResolved);
+    if (success && !showApproval) {
+        mResult = std::move(result.solution);
+        Q_EMIT q->keysResolved(true, false);
+        return;
+    } else if (success) {
+        qCDebug(LIBKLEO_LOG) << "No need for the user showing approval anyway.";
+    }
+
+    showApprovalDialog(std::move(result), parent);
+}
+
+void KeyResolver::Private::asyncResolutionFinished(bool showApproval, QWidget *parent)
+{
+    mThread->wait();
+    mThread.reset();
+    // release the snapshot in the thread that created it
+    mCore.setKeyCache(mCache);
+    mCore.setProgressCallback({});
+
+    if (mCore.isCanceled()) {
+        qCDebug(LIBKLEO_LOG) << "Asynchronous key resolution was canceled";
+        return;
+    }
+    handleResult(std::move(mAsyncResult), showApproval, parent);
+}
+
 void KeyResolver::start(bool showApproval, QWidget *parentWidget)
 {
     qCDebug(LIBKLEO_LOG) << "Starting ";
@@ -156,17 +199,55 @@ void KeyResolver::start(bool showApproval, QWidget *parentWidget)
         // nothing to do
         return Q_EMIT keysResolved(true, true);
     }
-    const auto result = d->mCore.resolve();
-    const bool success = (result.flags & KeyResolverCore::AllResolved);
-    if (success && !showApproval) {
-        d->mResult = std::move(result.solution);
-        Q_EMIT keysResolved(true, false);
+    if (d->mThread) {
+        qCWarning(LIBKLEO_LOG) << __func__ << "Key resolution is already running";
         return;
-    } else if (success) {
-        qCDebug(LIBKLEO_LOG) << "No need for the user showing approval anyway.";
     }
+    d->mCore.resetCanceled();
+    d->handleResult(d->mCore.resolve(), showApproval, parentWidget);
+}
 
-    d->showApprovalDialog(std::move(result), parentWidget);
+void KeyResolver::startAsync(bool showApproval, QWidget *parentWidget)
+{
+    qCDebug(LIBKLEO_LOG) << "Starting asynchronously";
+    if (!d->mSign && !d->mEncrypt) {
+        // nothing to do
+        return Q_EMIT keysResolved(true, true);
+    }
+    if (d->mThread) {
+        qCWarning(LIBKLEO_LOG) << __func__ << "Key resolution is already running";
+        return;
+    }
+    // the worker thread of a previous, canceled resolution has finished
+    d->mCore.resetCanceled();
+
+    // the crypto config must not be accessed by the worker thread
+    d->mCore.setDeVsCompliant(DeVSCompliance::isCompliant());
+
+    d->mCore.setKeyCache(d->mCache->snapshot());
+    d->mCore.setProgressCallback([this](int current, int total) {
+        QMetaObject::invokeMethod(
+            this,
+            [this, current, total]() {
+                Q_EMIT progress(current, total);
+            },
+            Qt::QueuedConnection);
+    });
+    d->mThread.reset(QThread::create([this]() {
+        d->mAsyncResult = d->mCore.resolve();
+    }));
+    connect(d->mThread.get(), &QThread::finished, this, [this, showApproval, parent = QPointer<QWidget>{parentWidget}]() {
+        d->asyncResolutionFinished(showApproval, parent);
+    });
+    d->mThread->start();
+}
+
+void KeyResolver::cancel()
+{
+    if (!d->mThread) {
+        return;
+    }
+    d->mCore.cancel();
 }
 
 KeyResolver::KeyResolver(bool encrypt, bool sign, Protocol fmt, bool allowMixed)
@@ -165,6 +165,35 @@ public:
      */
     void start(bool showApproval, QWidget *parentWidget = nullptr);
 
+    /**
+     * Starts the key resolving procedure like start(), but the automatic
+     * resolution of the keys is done in a worker thread using a snapshot
+     * of the key cache, so that the calling thread is not blocked while
+     * resolving the keys for many recipients or groups. Emits progress
+     * while resolving and keysResolved on success or error.
+     *
+     * The resolver must not be modified until keysResolved has been emitted.
+     * After cancel() it must not be modified either because the worker thread
+     * may still be running.
+     *
+     * @see cancel
+     */
+    void startAsync(bool showApproval, QWidget *parentWidget = nullptr);
+
+    /**
+     * Cancels a resolution started with startAsync(), e.g. because the
+     * recipients have been changed. keysResolved is not emitted for a
+     * canceled resolution. cancel() doesn't wait for the worker thread;
+     * therefore, a canceled resolver must not be modified while the worker
+     * thread is running, and starting it again is refused until the worker
+     * thread has finished. A resolution started afterwards isn't affected by
+     * the earlier cancellation.
+     * To resolve the keys for changed recipients, cancel the resolution,
+     * delete the resolver, and create a new KeyResolver. Deleting the
+     * resolver waits for the worker thread.
+     */
+    void cancel();
+
     /**
      * Set window flags for a possible dialog.
      */
@@ -190,6 +219,14 @@ Q_SIGNALS:
      *                         to this.*/
     void keysResolved(bool success, bool sendUnencrypted);
 
+    /**
+     * Emitted during an asynchronous resolution started with startAsync().
+     *
+     * @param current: The number of addresses that have been looked up.
+     * @param total: The total number of address lookups.
+     */
+    void progress(int current, int total);
+
 private:
     class Private;
     std::unique_ptr<Private> const d;
@@ -27,10 +27,14 @@
 #include <libkleo/keyhelpers.h>
 
 #include "kleo/debug.h"
+#include "utils/compliance_p.h"
 #include <libkleo_debug.h>
 
 #include <gpgme++/key.h>
 
+#include <atomic>
+#include <optional>
+
 using namespace Kleo;
 using namespace GpgME;
 
@@ -110,6 +114,7 @@ public:
     std::vector<Key> resolveRecipient(const QString &address, Protocol protocol);
     void resolveEnc(Protocol proto);
     void mergeEncryptionKeys();
+    void reportProgress();
     Result resolve();
 
     KeyResolverCore *const q;
@@ -129,6 +134,15 @@ public:
     bool mAllowMixed = true;
     Protocol mPreferredProtocol;
     int mMinimumValidity;
+    // the compliance state set by the caller; resolve() determines it if it isn't set
+    std::optional<bool> mDeVsComplianceOverride;
+    // true if compliance mode de-vs is active and GnuPG is compliant; the keys
+    // are then checked with a function that doesn't access the crypto config
+    bool mDeVsCompliant = false;
+    std::atomic<bool> mCanceled = false;
+    ProgressCallback mProgressCallback;
+    int mProgress = 0;
+    int mProgressTotal = 0;
 };
 
 bool KeyResolverCore::Private::isAcceptableSigningKey(const Key &key)
@@ -136,7 +150,7 @@ bool KeyResolverCore::Private::isAcceptableSigningKey(const Key &key)
     if (!ValidSigningKey(key)) {
         return false;
     }
-    if (DeVSCompliance::isCompliant() && !DeVSCompliance::keyIsCompliant(key)) {
+    if (mDeVsCompliant && !DeVSCompliance::Private::keyMeetsRequirements(key)) {
         qCDebug(LIBKLEO_LOG) << "Rejected sig key" << key.primaryFingerprint() << "because it is not de-vs compliant.";
         return false;
     }
@@ -149,7 +163,7 @@ bool KeyResolverCore::Private::isAcceptableEncryptionKey(const Key &key, const Q
         return false;
     }
 
-    if (DeVSCompliance::isCompliant() && !DeVSCompliance::keyIsCompliant(key)) {
+    if (mDeVsCompliant && !DeVSCompliance::Private::keyMeetsRequirements(key)) {
         qCDebug(LIBKLEO_LOG) << "Rejected enc key" << key.primaryFingerprint() << "because it is not de-vs compliant.";
         return false;
     }
@@ -224,11 +238,11 @@ void KeyResolverCore::Private::setOverrideKeys(const QMap<Protocol, QMap<QString
 
 namespace
 {
-std::vector<Key> resolveOverride(const QString &address, Protocol protocol, const QStringList &fingerprints)
+std::vector<Key> resolveOverride(const KeyCache &cache, const QString &address, Protocol protocol, const QStringList &fingerprints)
 {
     std::vector<Key> keys;
     for (const auto &fprOrId : fingerprints) {
-        const Key key = KeyCache::instance()->findByKeyIDOrFingerprint(fprOrId.toUtf8().constData());
+        const Key key = cache.findByKeyIDOrFingerprint(fprOrId.toUtf8().constData());
         if (key.isNull()) {
             // FIXME: Report to caller
             qCDebug(LIBKLEO_LOG) << "Failed to find override key for:" << address << "fpr:" << fprOrId;
@@ -265,7 +279,7 @@ void KeyResolverCore::Private::resolveOverrides()
 
         const QStringList commonOverride = protocolFingerprintsMap.value(UnknownProtocol);
         if (!commonOverride.empty()) {
-            mEncKeys[address][UnknownProtocol] = resolveOverride(address, UnknownProtocol, commonOverride);
+            mEncKeys[address][UnknownProtocol] = resolveOverride(*mCache, address, UnknownProtocol, commonOverride);
             if (protocolFingerprintsMap.contains(OpenPGP)) {
                 qCDebug(LIBKLEO_LOG) << "Ignoring OpenPGP-specific override for" << address << "in favor of common override";
             }
@@ -274,10 +288,10 @@ void KeyResolverCore::Private::resolveOverrides()
             }
         } else {
             if (mFormat != CMS) {
-                mEncKeys[address][OpenPGP] = resolveOverride(address, OpenPGP, protocolFingerprintsMap.value(OpenPGP));
+                mEncKeys[address][OpenPGP] = resolveOverride(*mCache, address, OpenPGP, protocolFingerprintsMap.value(OpenPGP));
             }
             if (mFormat != OpenPGP) {
-                mEncKeys[address][CMS] = resolveOverride(address, CMS, protocolFingerprintsMap.value(CMS));
+                mEncKeys[address][CMS] = resolveOverride(*mCache, address, CMS, protocolFingerprintsMap.value(CMS));
             }
         }
     }
@@ -404,7 +418,7 @@ std::vector<Key> KeyResolverCore::Private::resolveRecipientWithGroup(const QStri
 
 void KeyResolverCore::Private::resolveEncryptionGroups()
 {
-    for (auto it = mEncKeys.begin(); it != mEncKeys.end(); ++it) {
+    for (auto it = mEncKeys.begin(); it != mEncKeys.end() && !mCanceled; ++it) {
         const QString &address = it.key();
         auto &protocolKeysMap = it.value();
         if (!protocolKeysMap[UnknownProtocol].empty()) {
@@ -462,7 +476,8 @@ std::vector<Key> KeyResolverCore::Private::resolveRecipient(const QString &addre
 // Try to find matching keys in the provided protocol for the unresolved addresses
 void KeyResolverCore::Private::resolveEnc(Protocol proto)
 {
-    for (auto it = mEncKeys.begin(); it != mEncKeys.end(); ++it) {
+    for (auto it = mEncKeys.begin(); it != mEncKeys.end() && !mCanceled; ++it) {
+        reportProgress();
         const QString &address = it.key();
         auto &protocolKeysMap = it.value();
         if (!protocolKeysMap[proto].empty()) {
@@ -484,6 +499,13 @@ void KeyResolverCore::Private::resolveEnc(Protocol proto)
     }
 }
 
+void KeyResolverCore::Private::reportProgress()
+{
+    if (mProgressCallback) {
+        mProgressCallback(++mProgress, mProgressTotal);
+    }
+}
+
 auto getBestEncryptionKeys(const QMap<QString, QMap<Protocol, std::vector<Key>>> &encryptionKeys, Protocol preferredProtocol)
 {
     QMap<QString, std::vector<Key>> result;
@@ -569,6 +591,10 @@ KeyResolverCore::Result KeyResolverCore::Private::resolve()
         return {AllResolved, {}, {}};
     }
 
+    mDeVsCompliant = mDeVsComplianceOverride ? *mDeVsComplianceOverride : DeVSCompliance::isCompliant();
+    mProgress = 0;
+    mProgressTotal = mEncrypt ? static_cast<int>(mEncKeys.size()) * (mFormat == UnknownProtocol ? 2 : 1) : 0;
+
     // First resolve through overrides
     resolveOverrides();
 
@@ -596,6 +622,10 @@ KeyResolverCore::Result KeyResolverCore::Private::resolve()
         resolveSign(OpenPGP);
         resolveEnc(OpenPGP);
     }
+    if (mCanceled) {
+        qCDebug(LIBKLEO_LOG) << "Resolution canceled";
+        return {Error, {}, {}};
+    }
     const bool pgpOnly = ((!mEncrypt || !hasUnresolvedRecipients(mEncKeys, OpenPGP)) //
                           && (!mSign || !hasUnresolvedSender(mSigKeys, OpenPGP)));
 
@@ -611,6 +641,10 @@ KeyResolverCore::Result KeyResolverCore::Private::resolve()
         resolveSign(CMS);
         resolveEnc(CMS);
     }
+    if (mCanceled) {
+        qCDebug(LIBKLEO_LOG) << "Resolution canceled";
+        return {Error, {}, {}};
+    }
     const bool cmsOnly = ((!mEncrypt || !hasUnresolvedRecipients(mEncKeys, CMS)) //
                           && (!mSign || !hasUnresolvedSender(mSigKeys, CMS)));
 
@@ -761,6 +795,36 @@ void KeyResolverCore::setMinimumValidity(int validity)
     d->mMinimumValidity = validity;
 }
 
+void KeyResolverCore::setKeyCache(const std::shared_ptr<const KeyCache> &cache)
+{
+    d->mCache = cache ? cache : KeyCache::instance();
+}
+
+void KeyResolverCore::setDeVsCompliant(bool compliant)
+{
+    d->mDeVsComplianceOverride = compliant;
+}
+
+void KeyResolverCore::setProgressCallback(const ProgressCallback &callback)
+{
+    d->mProgressCallback = callback;
+}
+
+void KeyResolverCore::cancel()
+{
+    d->mCanceled = true;
+}
+
+bool KeyResolverCore::isCanceled() const
+{
+    return d->mCanceled;
+}
+
+void KeyResolverCore::resetCanceled()
+{
+    d->mCanceled = false;
+}
+
 KeyResolverCore::Result KeyResolverCore::resolve()
 {
     return d->resolve();
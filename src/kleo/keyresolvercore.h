@@ -18,6 +18,7 @@
 
 #include <gpgme++/global.h>
 
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -31,6 +32,8 @@ class Key;
 namespace Kleo
 {
 
+class KeyCache;
+
 class KLEO_EXPORT KeyResolverCore
 {
 public:
@@ -73,6 +76,45 @@ public:
 
     void setMinimumValidity(int validity);
 
+    /**
+     * Sets the key cache that is used for resolving the keys. By default, the
+     * global key cache is used. Pass a snapshot of the key cache (see
+     * KeyCache::snapshot()) if resolve() is called in a different thread.
+     */
+    void setKeyCache(const std::shared_ptr<const KeyCache> &cache);
+
+    /**
+     * Sets whether compliance mode de-vs is active and GnuPG is compliant, i.e.
+     * whether only de-vs compliant keys are accepted. If this isn't set, then
+     * resolve() calls DeVSCompliance::isCompliant() which accesses the crypto
+     * config. Set it if resolve() is called in a different thread because the
+     * crypto config must only be used in the main thread.
+     */
+    void setDeVsCompliant(bool compliant);
+
+    using ProgressCallback = std::function<void(int current, int total)>;
+    /**
+     * Sets a function that is called by resolve() after each resolved address.
+     * The function is called in the thread running resolve().
+     */
+    void setProgressCallback(const ProgressCallback &callback);
+
+    /**
+     * Requests the cancellation of a running resolve(). Can be called from any
+     * thread. If the resolution is canceled, then resolve() returns early with
+     * the Error flag set. The cancellation stays in effect until
+     * resetCanceled() is called.
+     */
+    void cancel();
+    bool isCanceled() const;
+
+    /**
+     * Clears a cancellation requested with cancel(), so that the resolver can
+     * be used for another resolve(). Must not be called while resolve() is
+     * running.
+     */
+    void resetCanceled();
+
     Result resolve();
 
 private:
@@ -14,40 +14,72 @@
 
 #include <QString>
 
-#include <vector>
+#include <algorithm>
+#include <array>
 
 namespace
 {
 struct NameAndOID {
-    const char *name;
-    const char *oid;
+    std::string_view name;
+    std::string_view oid;
 };
-static const std::vector<NameAndOID> oidmap = {
+
+constexpr char toUpper(char c)
+{
+    return (c >= 'a' && c <= 'z') ? char(c - 'a' + 'A') : c;
+}
+
+constexpr int compareCaseInsensitive(std::string_view lhs, std::string_view rhs)
+{
+    const auto n = std::min(lhs.size(), rhs.size());
+    for (std::size_t i = 0; i < n; ++i) {
+        const char l = toUpper(lhs[i]);
+        const char r = toUpper(rhs[i]);
+        if (l != r) {
+            return l < r ? -1 : 1;
+        }
+    }
+    return lhs.size() < rhs.size() ? -1 : lhs.size() > rhs.size() ? 1 : 0;
+}
+
+constexpr std::array<NameAndOID, 12> oidmap = {{
     // clang-format off
-    // keep them ordered by oid:
-    {"SP",                "ST"                  }, // hack to show the Sphinx-required/desired SP for
-    // StateOrProvince, otherwise known as ST or even S
+    // keep them ordered by oid (compared case-insensitively) for the binary search:
     {"NameDistinguisher", "0.2.262.1.10.7.20"   },
     {"EMAIL",             "1.2.840.113549.1.9.1"},
-    {"SN",                "2.5.4.4"             },
-    {"SerialNumber",      "2.5.4.5"             },
     {"T",                 "2.5.4.12"            },
     {"D",                 "2.5.4.13"            },
     {"BC",                "2.5.4.15"            },
     {"ADDR",              "2.5.4.16"            },
     {"PC",                "2.5.4.17"            },
+    {"SN",                "2.5.4.4"             },
     {"GN",                "2.5.4.42"            },
+    {"SerialNumber",      "2.5.4.5"             },
     {"Pseudo",            "2.5.4.65"            },
+    {"SP",                "ST"                  }, // hack to show the Sphinx-required/desired SP for
+    // StateOrProvince, otherwise known as ST or even S
     // clang-format on
-};
+}};
+
+constexpr bool isSortedByOID()
+{
+    for (std::size_t i = 1; i < oidmap.size(); ++i) {
+        if (compareCaseInsensitive(oidmap[i - 1].oid, oidmap[i].oid) >= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(isSortedByOID(), "oidmap must be sorted by oid");
 }
 
 const char *Kleo::oidForAttributeName(const QString &attr)
 {
-    QByteArray attrUtf8 = attr.toUtf8();
+    const QByteArray attrUtf8 = attr.toUtf8();
+    const std::string_view name{attrUtf8.constData(), std::size_t(attrUtf8.size())};
     for (const auto &m : oidmap) {
-        if (qstricmp(attrUtf8.constData(), m.name) == 0) {
-            return m.oid;
+        if (compareCaseInsensitive(name, m.name) == 0) {
+            return m.oid.data();
         }
     }
     return nullptr;
@@ -55,10 +87,17 @@ const char *Kleo::oidForAttributeName(const QString &attr)
 
 const char *Kleo::attributeNameForOID(const char *oid)
 {
-    for (const auto &m : oidmap) {
-        if (qstricmp(oid, m.oid) == 0) {
-            return m.name;
-        }
+    return oid ? attributeNameForOID(std::string_view{oid}) : nullptr;
+}
+
+const char *Kleo::attributeNameForOID(std::string_view oid)
+{
+    const auto it = std::lower_bound(oidmap.begin(), oidmap.end(), oid, [](const NameAndOID &m, std::string_view oid) {
+        return compareCaseInsensitive(m.oid, oid) < 0;
+    });
+    if (it != oidmap.end() && compareCaseInsensitive(it->oid, oid) == 0) {
+        // the names are string literals, i.e. they are null-terminated
+        return it->name.data();
     }
     return nullptr;
 }
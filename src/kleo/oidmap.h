@@ -13,6 +13,8 @@
 
 #include "kleo_export.h"
 
+#include <string_view>
+
 class QString;
 
 namespace Kleo
@@ -22,4 +24,11 @@ KLEO_EXPORT const char *oidForAttributeName(const QString &attr);
 
 KLEO_EXPORT const char *attributeNameForOID(const char *oid);
 
+/**
+ * Returns the attribute name for the OID @a oid or nullptr if the OID is unknown.
+ * The returned string is null-terminated and stays valid. Other than the
+ * overload taking a C string, this doesn't require @a oid to be null-terminated.
+ */
+KLEO_EXPORT const char *attributeNameForOID(std::string_view oid);
+
 }
@@ -13,17 +13,22 @@
 #include "keycache.h"
 #include "keycache_p.h"
 
+#include "utils/cryptoconfig_p.h"
+#include "utils/dncache_p.h"
+#include "utils/secretkeyfile_p.h"
+
 #include <libkleo/algorithm.h>
 #include <libkleo/compat.h>
+#include <libkleo/cryptoconfig.h>
 #include <libkleo/debug.h>
 #include <libkleo/enum.h>
 #include <libkleo/filesystemwatcher.h>
+#include <libkleo/fingerprint.h>
 #include <libkleo/gnupg.h>
 #include <libkleo/keygroup.h>
 #include <libkleo/keygroupconfig.h>
 #include <libkleo/keyhelpers.h>
 #include <libkleo/predicates.h>
-#include <libkleo/qtstlhelpers.h>
 #include <libkleo/stl_util.h>
 
 #include <libkleo_debug.h>
@@ -31,12 +36,13 @@
 #include <KSharedConfig>
 
 #include <QGpgME/CryptoConfig>
-#include <QGpgME/DN>
 #include <QGpgME/ListAllKeysJob>
 #include <QGpgME/Protocol>
 
 #include <QEventLoop>
+#include <QFileInfo>
 #include <QPointer>
+#include <QRegularExpression>
 #include <QTimer>
 
 #include <gpgme++/context.h>
@@ -49,9 +55,12 @@
 #include <gpg-error.h>
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <functional>
 #include <iterator>
+#include <map>
+#include <unordered_map>
 #include <utility>
 
 using namespace std::chrono_literals;
@@ -60,6 +69,17 @@ using namespace GpgME;
 
 static const unsigned int hours2ms = 1000 * 60 * 60;
 
+// incremented whenever the keys in a key cache change
+static std::atomic<quint64> keyCacheGenerationCounter{0};
+
+// Returns true if @p fileName is the name of the configuration file of gpg,
+// i.e. gpg.conf or a version specific variant like gpg.conf-2.4.
+static bool isGpgConfigFile(const QString &fileName)
+{
+    static const QRegularExpression gpgConfRegExp{QStringLiteral(R"(^gpg\.conf(-\d+(\.\d+){0,2})?$)")};
+    return gpgConfRegExp.match(fileName).hasMatch();
+}
+
 //
 //
 // KeyCache
@@ -79,6 +99,33 @@ namespace
 
 make_comparator_str(ByEMail, .first.c_str());
 
+struct BestKeyQuery {
+    QByteArray address;
+    Protocol protocol;
+    KeyCache::KeyUsage usage;
+
+    bool operator==(const BestKeyQuery &other) const = default;
+};
+
+// summary of the protocols and the usages allowed by all keys of a group
+struct GroupIndexEntry {
+    enum Flag : unsigned {
+        AllOpenPGP = 0x01,
+        AllCMS = 0x02,
+        AllSign = 0x04,
+        AllEncrypt = 0x08,
+    };
+    std::size_t position;
+    unsigned flags;
+};
+
+struct BestKeyQueryHash {
+    size_t operator()(const BestKeyQuery &query) const
+    {
+        return qHashMulti(0, query.address, static_cast<int>(query.protocol), static_cast<int>(query.usage));
+    }
+};
+
 }
 
 class Kleo::KeyCacheAutoRefreshSuspension
@@ -239,6 +286,26 @@ public:
 
     void ensureCachePopulated() const;
 
+    // drops the memoized lookups and the indexes which are derived from the keys
+    void invalidateDerivedIndexes()
+    {
+        ++keyCacheGenerationCounter;
+        m_bestKeys.clear();
+        m_expirationIndexes.clear();
+        m_fprIndex.clear();
+    }
+
+    const std::unordered_map<Fingerprint, std::size_t> &fingerprintIndex() const;
+
+    const std::vector<KeyCache::ExpiringKey> &expirationIndex(KeyCache::KeyUsage usage);
+
+    void invalidateGroupIndex()
+    {
+        m_groupIndex.clear();
+    }
+
+    const std::unordered_map<QString, std::vector<GroupIndexEntry>> &groupIndex() const;
+
     void readGroupsFromGpgConf()
     {
         // According to Werner Koch groups are more of a hack to solve
@@ -272,7 +339,7 @@ public:
         // add all groups read from the configuration to the list of groups
         for (auto it = fingerprints.cbegin(); it != fingerprints.cend(); ++it) {
             const QString groupName = it.key();
-            const std::vector<Key> groupKeys = q->findByFingerprint(toStdStrings(it.value()));
+            const std::vector<Key> groupKeys = q->findByFingerprint(toFingerprints(it.value()));
             KeyGroup g(groupName, groupName, groupKeys, KeyGroup::GnuPGConfig);
             m_groups.push_back(g);
         }
@@ -332,6 +399,7 @@ public:
         // so no need for a job.
 
         m_groups.clear();
+        invalidateGroupIndex();
         if (m_groupsEnabled) {
             readGroupsFromGpgConf();
             readGroupsFromGroupsConfig();
@@ -361,6 +429,7 @@ public:
         }
 
         m_groups.push_back(savedGroup);
+        invalidateGroupIndex();
 
         Q_EMIT q->groupAdded(savedGroup);
 
@@ -391,6 +460,7 @@ public:
         }
 
         m_groups[groupIndex] = savedGroup;
+        invalidateGroupIndex();
 
         Q_EMIT q->groupUpdated(savedGroup);
 
@@ -420,6 +490,7 @@ public:
         }
 
         m_groups.erase(it);
+        invalidateGroupIndex();
 
         Q_EMIT q->groupRemoved(group);
 
@@ -444,8 +515,64 @@ private:
     std::shared_ptr<KeyGroupConfig> m_groupConfig;
     std::vector<KeyGroup> m_groups;
     std::unordered_map<QByteArray, std::vector<CardKeyStorageInfo>> m_cards;
+    // memoized results of findBestByMailBox; must be invalidated whenever the indexes change
+    std::unordered_map<BestKeyQuery, Key, BestKeyQueryHash> m_bestKeys;
+    ResolutionCacheStatistics m_resolutionCacheStatistics;
+    // lazily built indexes of the keys sorted by expiration time; must be invalidated whenever the indexes change
+    std::map<KeyCache::KeyUsage, std::vector<KeyCache::ExpiringKey>> m_expirationIndexes;
+    // lazily built index of the positions of the keys in by.fpr by binary fingerprint; must be invalidated whenever the indexes change
+    mutable std::unordered_map<Fingerprint, std::size_t> m_fprIndex;
+    // lazily built index of the positions of the groups in m_groups by group name; must be invalidated whenever m_groups changes
+    mutable std::unordered_map<QString, std::vector<GroupIndexEntry>> m_groupIndex;
 };
 
+const std::unordered_map<Fingerprint, std::size_t> &KeyCache::Private::fingerprintIndex() const
+{
+    ensureCachePopulated();
+    if (m_fprIndex.empty() && !by.fpr.empty()) {
+        m_fprIndex.reserve(by.fpr.size());
+        for (std::size_t i = 0; i < by.fpr.size(); ++i) {
+            const auto fpr = Fingerprint::fromKey(by.fpr[i]);
+            if (!fpr.isNull()) {
+                m_fprIndex.emplace(fpr, i);
+            }
+        }
+    }
+    return m_fprIndex;
+}
+
+namespace
+{
+unsigned groupIndexFlags(const KeyGroup::Keys &keys)
+{
+    unsigned flags = 0;
+    if (allKeysHaveProtocol(keys, OpenPGP)) {
+        flags |= GroupIndexEntry::AllOpenPGP;
+    }
+    if (allKeysHaveProtocol(keys, CMS)) {
+        flags |= GroupIndexEntry::AllCMS;
+    }
+    if (std::all_of(keys.cbegin(), keys.cend(), std::mem_fn(&Key::hasSign))) {
+        flags |= GroupIndexEntry::AllSign;
+    }
+    if (std::all_of(keys.cbegin(), keys.cend(), std::mem_fn(&Key::hasEncrypt))) {
+        flags |= GroupIndexEntry::AllEncrypt;
+    }
+    return flags;
+}
+}
+
+const std::unordered_map<QString, std::vector<GroupIndexEntry>> &KeyCache::Private::groupIndex() const
+{
+    if (m_groupIndex.empty() && !m_groups.empty()) {
+        for (std::size_t i = 0; i < m_groups.size(); ++i) {
+            const KeyGroup &group = m_groups[i];
+            m_groupIndex[group.name()].push_back({i, groupIndexFlags(group.keys())});
+        }
+    }
+    return m_groupIndex;
+}
+
 std::shared_ptr<const KeyCache> KeyCache::instance()
 {
     return mutableInstance();
@@ -553,7 +680,14 @@ void KeyCache::addFileSystemWatcher(const std::shared_ptr<FileSystemWatcher> &wa
     connect(watcher.get(), &FileSystemWatcher::directoryChanged, this, [this]() {
         startKeyListing();
     });
-    connect(watcher.get(), &FileSystemWatcher::fileChanged, this, [this]() {
+    connect(watcher.get(), &FileSystemWatcher::fileChanged, this, [this](const QString &path) {
+        if (isGpgConfigFile(QFileInfo{path}.fileName())) {
+            // e.g. the compliance mode may have been changed; read the configuration
+            // again in the background because QGpgME::cryptoConfig() isn't cleared
+            // (its entries may still be in use)
+            Kleo::Private::cryptoConfigChanged();
+            preloadCryptoConfig();
+        }
         startKeyListing();
     });
 
@@ -628,6 +762,32 @@ std::vector<GpgME::Key> KeyCache::findByFingerprint(const std::vector<std::strin
     return keys;
 }
 
+const Key &KeyCache::findByFingerprint(const Fingerprint &fpr) const
+{
+    const auto &index = d->fingerprintIndex();
+    const auto it = index.find(fpr);
+    if (it == index.end()) {
+        static const Key null;
+        return null;
+    }
+    return d->by.fpr[it->second];
+}
+
+std::vector<Key> KeyCache::findByFingerprint(const std::vector<Fingerprint> &fprs) const
+{
+    std::vector<Key> keys;
+    keys.reserve(fprs.size());
+    for (const auto &fpr : fprs) {
+        const Key &key = findByFingerprint(fpr);
+        if (key.isNull()) {
+            qCDebug(LIBKLEO_LOG) << __func__ << "Ignoring unknown key with fingerprint:" << fpr;
+            continue;
+        }
+        keys.push_back(key);
+    }
+    return keys;
+}
+
 std::vector<Key> KeyCache::findByEMailAddress(const char *email) const
 {
     const auto pair = d->find_email(email);
@@ -1026,7 +1186,7 @@ static std::string email(const UserID &uid)
     }
     const std::string email = uid.email();
     if (email.empty()) {
-        return QGpgME::DN(uid.id())[QStringLiteral("EMAIL")].trimmed().toUtf8().constData();
+        return DNCache::lookup(uid.id()).email.toUtf8().constData();
     }
     if (email[0] == '<' && email[email.size() - 1] == '>') {
         return email.substr(1, email.size() - 2);
@@ -1114,6 +1274,8 @@ void KeyCache::remove(const Key &key, Notifications notify)
         }
     }
 
+    d->invalidateDerivedIndexes();
+
     if (notify == SendNotifications) {
         Q_EMIT keysMayHaveChanged();
     }
@@ -1404,6 +1566,7 @@ void KeyCache::insert(const std::vector<Key> &keys)
     by_subkeyid.swap(d->by.subkeyid);
     by_keygrip.swap(d->by.keygrip);
     by_chainid.swap(d->by.chainid);
+    d->invalidateDerivedIndexes();
 
     for (const Key &key : std::as_const(sorted)) {
         d->m_pgpOnly &= key.protocol() == GpgME::OpenPGP;
@@ -1415,20 +1578,18 @@ void KeyCache::insert(const std::vector<Key> &keys)
             if (!subkey.isSecret() || subkeyUsesCombinedAlgorithms(subkey) || !d->m_cards[QByteArray(subkey.keyGrip())].empty()) {
                 continue;
             }
-            const auto data = readSecretKeyFile(QString::fromLatin1(subkey.keyGrip()));
-            for (const auto &line : data) {
-                if (line.startsWith(QByteArrayLiteral("Token"))) {
-                    const auto split = line.split(' ');
-                    if (split.size() > 2) {
-                        const auto keyRef = QString::fromUtf8(split[2]).trimmed();
-                        d->m_cards[QByteArray(subkey.keyGrip())].push_back(CardKeyStorageInfo{
-                            QString::fromUtf8(split[1]),
-                            split.size() > 4 ? QString::fromLatin1(
-                                QString::fromUtf8(split[4]).trimmed().replace(QLatin1Char('+'), QLatin1Char(' ')).toUtf8().percentDecoded())
-                                             : QString(),
-                            keyRef,
-                        });
-                    }
+            const auto tokenLines = SecretKeyFile::cardTokenLines(QString::fromLatin1(subkey.keyGrip()));
+            for (const auto &line : tokenLines) {
+                const auto split = line.split(' ');
+                if (split.size() > 2) {
+                    const auto keyRef = QString::fromUtf8(split[2]).trimmed();
+                    d->m_cards[QByteArray(subkey.keyGrip())].push_back(CardKeyStorageInfo{
+                        QString::fromUtf8(split[1]),
+                        split.size() > 4 ? QString::fromLatin1(
+                            QString::fromUtf8(split[4]).trimmed().replace(QLatin1Char('+'), QLatin1Char(' ')).toUtf8().percentDecoded())
+                                         : QString(),
+                        keyRef,
+                    });
                 }
             }
         }
@@ -1440,6 +1601,7 @@ void KeyCache::insert(const std::vector<Key> &keys)
 void KeyCache::clear()
 {
     d->by = Private::By();
+    d->invalidateDerivedIndexes();
 }
 
 //
@@ -1636,6 +1798,24 @@ Error KeyCache::RefreshKeysJob::Private::startKeyListing(GpgME::Protocol proto)
     return error;
 }
 
+std::shared_ptr<const KeyCache> KeyCache::snapshot() const
+{
+    d->ensureCachePopulated();
+
+    auto copy = std::make_shared<KeyCache>();
+    copy->d->setRefreshInterval(0);
+    copy->d->by = d->by;
+    copy->d->m_initalized = true;
+    copy->d->m_pgpOnly = d->m_pgpOnly;
+    copy->d->m_remarks_enabled = d->m_remarks_enabled;
+    copy->d->m_groupsEnabled = d->m_groupsEnabled;
+    copy->d->m_groups = d->m_groups;
+    copy->d->m_groupIndex = d->groupIndex();
+    copy->d->m_cards = d->m_cards;
+    copy->d->m_bestKeys = d->m_bestKeys;
+    return copy;
+}
+
 bool KeyCache::initialized() const
 {
     return d->m_initalized;
@@ -1716,6 +1896,13 @@ GpgME::Key KeyCache::findBestByMailBox(const char *addr, GpgME::Protocol proto,
     }
     address = address.toLower();
 
+    const BestKeyQuery query{address, proto, usage};
+    if (const auto it = d->m_bestKeys.find(query); it != d->m_bestKeys.end()) {
+        ++d->m_resolutionCacheStatistics.hits;
+        return it->second;
+    }
+    ++d->m_resolutionCacheStatistics.misses;
+
     BestMatch best;
     for (const Key &k : findByEMailAddress(address.constData())) {
         if (proto != Protocol::UnknownProtocol && k.protocol() != proto) {
@@ -1756,29 +1943,89 @@ GpgME::Key KeyCache::findBestByMailBox(const char *addr, GpgME::Protocol proto,
         }
     }
 
+    d->m_bestKeys.emplace(query, best.key);
     return best.key;
 }
 
+double KeyCache::ResolutionCacheStatistics::hitRate() const
+{
+    const quint64 lookups = hits + misses;
+    return lookups > 0 ? double(hits) / lookups : 0.0;
+}
+
+KeyCache::ResolutionCacheStatistics KeyCache::resolutionCacheStatistics() const
+{
+    return d->m_resolutionCacheStatistics;
+}
+
 namespace
 {
-template<typename T>
-bool allKeysAllowUsage(const T &keys, KeyCache::KeyUsage usage)
+bool subkeyIsSuitableFor(const Subkey &subkey, KeyCache::KeyUsage usage)
 {
     switch (usage) {
     case KeyCache::KeyUsage::AnyUsage:
         return true;
     case KeyCache::KeyUsage::Sign:
-        return std::all_of(std::begin(keys), std::end(keys), std::mem_fn(&Key::hasSign));
+        return subkey.canSign();
     case KeyCache::KeyUsage::Encrypt:
-        return std::all_of(std::begin(keys), std::end(keys), std::mem_fn(&Key::hasEncrypt));
+        return subkey.canEncrypt();
     case KeyCache::KeyUsage::Certify:
-        return std::all_of(std::begin(keys), std::end(keys), std::mem_fn(&Key::hasCertify));
+        return subkey.canCertify();
     case KeyCache::KeyUsage::Authenticate:
-        return std::all_of(std::begin(keys), std::end(keys), std::mem_fn(&Key::hasAuthenticate));
+        return subkey.canAuthenticate();
     }
-    qCDebug(LIBKLEO_LOG) << __func__ << "called with invalid usage" << int(usage);
     return false;
 }
+
+qint64 expirationTime(const Subkey &subkey)
+{
+    // interpret the expiration time as unsigned 32-bit value; gpg also uses uint32 internally
+    return subkey.neverExpires() ? 0 : qint64(quint32(subkey.expirationTime()));
+}
+
+// returns the effective expiration time of the key for the usage or 0 if the key
+// doesn't expire for this usage; uses the same rules as findBestSubkey() in expirychecker.cpp
+qint64 effectiveExpirationTime(const Key &key, KeyCache::KeyUsage usage)
+{
+    if (usage == KeyCache::KeyUsage::AnyUsage) {
+        return expirationTime(key.subkey(0));
+    }
+    qint64 result = 0;
+    for (const Subkey &subkey : key.subkeys()) {
+        if (!subkeyIsOk(subkey) || !subkeyIsSuitableFor(subkey, usage)) {
+            continue;
+        }
+        if (subkey.neverExpires()) {
+            // a non-expiring subkey inherits the primary key's expiration
+            return expirationTime(key.subkey(0));
+        }
+        result = std::max(result, expirationTime(subkey));
+    }
+    return result;
+}
+}
+
+const std::vector<KeyCache::ExpiringKey> &KeyCache::Private::expirationIndex(KeyCache::KeyUsage usage)
+{
+    const auto [it, inserted] = m_expirationIndexes.try_emplace(usage);
+    if (inserted) {
+        auto &index = it->second;
+        for (const auto &key : by.fpr) {
+            if (const auto expirationTime = effectiveExpirationTime(key, usage)) {
+                index.push_back({expirationTime, key});
+            }
+        }
+        std::stable_sort(index.begin(), index.end(), [](const auto &lhs, const auto &rhs) {
+            return lhs.expirationTime < rhs.expirationTime;
+        });
+    }
+    return it->second;
+}
+
+std::vector<KeyCache::ExpiringKey> KeyCache::keysByExpirationTime(KeyUsage usage) const
+{
+    d->ensureCachePopulated();
+    return d->expirationIndex(usage);
 }
 
 KeyGroup KeyCache::findGroup(const QString &name, Protocol protocol, KeyUsage usage) const
@@ -1786,12 +2033,25 @@ KeyGroup KeyCache::findGroup(const QString &name, Protocol protocol, KeyUsage us
     d->ensureCachePopulated();
 
     Q_ASSERT(usage == KeyUsage::Sign || usage == KeyUsage::Encrypt);
-    for (const auto &group : std::as_const(d->m_groups)) {
-        if (group.name() == name) {
-            const KeyGroup::Keys &keys = group.keys();
-            if (allKeysAllowUsage(keys, usage) && (protocol == UnknownProtocol || allKeysHaveProtocol(keys, protocol))) {
-                return group;
-            }
+    const auto &index = d->groupIndex();
+    const auto it = index.find(name);
+    if (it == index.end()) {
+        return {};
+    }
+    unsigned requiredFlags = 0;
+    if (usage == KeyUsage::Sign) {
+        requiredFlags |= GroupIndexEntry::AllSign;
+    } else if (usage == KeyUsage::Encrypt) {
+        requiredFlags |= GroupIndexEntry::AllEncrypt;
+    }
+    if (protocol == OpenPGP) {
+        requiredFlags |= GroupIndexEntry::AllOpenPGP;
+    } else if (protocol == CMS) {
+        requiredFlags |= GroupIndexEntry::AllCMS;
+    }
+    for (const auto &entry : it->second) {
+        if ((entry.flags & requiredFlags) == requiredFlags) {
+            return d->m_groups[entry.position];
         }
     }
 
@@ -1801,11 +2061,14 @@ KeyGroup KeyCache::findGroup(const QString &name, Protocol protocol, KeyUsage us
 std::vector<Key> KeyCache::getGroupKeys(const QString &groupName) const
 {
     std::vector<Key> result;
-    for (const KeyGroup &g : std::as_const(d->m_groups)) {
-        if (g.name() == groupName) {
-            const KeyGroup::Keys &keys = g.keys();
-            std::copy(keys.cbegin(), keys.cend(), std::back_inserter(result));
-        }
+    const auto &index = d->groupIndex();
+    const auto it = index.find(groupName);
+    if (it == index.end()) {
+        return result;
+    }
+    for (const auto &entry : it->second) {
+        const KeyGroup::Keys &keys = d->m_groups[entry.position].keys();
+        std::copy(keys.cbegin(), keys.cend(), std::back_inserter(result));
     }
     _detail::sort_by_fpr(result);
     _detail::remove_duplicates_by_fpr(result);
@@ -1827,6 +2090,7 @@ void KeyCache::setGroups(const std::vector<KeyGroup> &groups)
 {
     Q_ASSERT(d->m_initalized && "Call setKeys() before setting groups");
     d->m_groups = groups;
+    d->invalidateGroupIndex();
     Q_EMIT keysMayHaveChanged();
 }
 
@@ -1837,5 +2101,10 @@ std::vector<CardKeyStorageInfo> KeyCache::cardsForSubkey(const GpgME::Subkey &su
     return d->m_cards[QByteArray(subkey.keyGrip())];
 }
 
+quint64 Kleo::Private::keyCacheGeneration()
+{
+    return keyCacheGenerationCounter.load(std::memory_order_acquire);
+}
+
 #include "moc_keycache.cpp"
 #include "moc_keycache_p.cpp"
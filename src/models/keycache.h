@@ -31,6 +31,7 @@ namespace Kleo
 {
 
 class FileSystemWatcher;
+class Fingerprint;
 class KeyGroup;
 class KeyGroupConfig;
 
@@ -121,6 +122,15 @@ public:
 
     std::vector<GpgME::Key> findByFingerprint(const std::vector<std::string> &fprs) const;
 
+    /**
+     * Looks up the key with the fingerprint @a fpr in binary form. Other than
+     * the lookups by hex string, which need to compare strings, this lookup
+     * uses a hash index which is built on first use after the content of the
+     * cache changed.
+     */
+    const GpgME::Key &findByFingerprint(const Fingerprint &fpr) const;
+    std::vector<GpgME::Key> findByFingerprint(const std::vector<Fingerprint> &fprs) const;
+
     std::vector<GpgME::Key> findByEMailAddress(const char *email) const;
     std::vector<GpgME::Key> findByEMailAddress(const std::string &email) const;
 
@@ -135,6 +145,22 @@ public:
      * @returns the "best" key for the mailbox. */
     GpgME::Key findBestByMailBox(const char *addr, GpgME::Protocol proto, KeyUsage usage) const;
 
+    /**
+     * Statistics about the lookups done with findBestByMailBox().
+     *
+     * The results of findBestByMailBox() are memoized until the content of
+     * the cache changes, so that repeated resolutions of the same mailboxes
+     * (e.g. by several KeyResolverCore instances) are simple lookups.
+     */
+    struct ResolutionCacheStatistics {
+        quint64 hits = 0;
+        quint64 misses = 0;
+
+        /** Returns the ratio of hits to lookups or 0 if there were no lookups. */
+        double hitRate() const;
+    };
+    ResolutionCacheStatistics resolutionCacheStatistics() const;
+
     /**
      * Looks for a group named @a name which contains keys with protocol @a protocol
      * that are suitable for the usage @a usage.
@@ -199,6 +225,36 @@ public:
 
     std::vector<GpgME::Key> findIssuers(const GpgME::Key &key, Options options = RecursiveSearch) const;
 
+    struct ExpiringKey {
+        qint64 expirationTime = 0; // seconds since epoch
+        GpgME::Key key;
+    };
+
+    /**
+     * Returns the keys that expire for the usage @a usage sorted by their
+     * effective expiration time for this usage.
+     *
+     * The effective expiration time is the latest expiration time of the usable
+     * subkeys suitable for @a usage where a suitable subkey that doesn't expire
+     * inherits the expiration time of the primary key. For KeyUsage::AnyUsage
+     * the expiration time of the primary key is used. This matches the way
+     * ExpiryChecker determines the expiration of keys. Keys that don't expire
+     * or that have no suitable subkey are not included.
+     *
+     * The index is built when it's requested for the first time and rebuilt
+     * after the content of the cache changed. A copy of the index is returned
+     * because the cached index doesn't survive the next change of the cache.
+     */
+    std::vector<ExpiringKey> keysByExpirationTime(KeyUsage usage) const;
+
+    /**
+     * Returns an immutable copy of the cache's keys and groups which is not
+     * updated anymore. Other than the cache itself, the snapshot can be
+     * queried from a different thread. The snapshot must be created and
+     * destroyed in the thread of the cache.
+     */
+    std::shared_ptr<const KeyCache> snapshot() const;
+
     /** Check if at least one keylisting was finished. */
     bool initialized() const;
 
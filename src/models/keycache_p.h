@@ -17,6 +17,15 @@ class KeyListResult;
 namespace Kleo
 {
 
+namespace Private
+{
+/**
+ * Returns a counter which is incremented whenever the keys in a key cache
+ * change. This function is thread-safe.
+ */
+quint64 keyCacheGeneration();
+}
+
 class KeyCache::RefreshKeysJob : public QObject
 {
     Q_OBJECT
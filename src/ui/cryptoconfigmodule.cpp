@@ -16,6 +16,8 @@
 #include "directoryserviceswidget.h"
 #include "filenamerequester.h"
 
+#include "utils/cryptoconfig_p.h"
+
 #include <libkleo/compliance.h>
 #include <libkleo/formatting.h>
 #include <libkleo/gnupg.h>
@@ -46,17 +48,28 @@
 #include <QScrollArea>
 #include <QSpinBox>
 #include <QStyle>
+#include <QThreadPool>
 #include <QVBoxLayout>
 
 #include <gpgme.h>
 
 #include <array>
+#include <condition_variable>
 #include <limits>
-#include <memory>
+#include <mutex>
 #include <set>
 
 using namespace Kleo;
 
+// the state shared by a CryptoConfigModule and the worker reading the configuration
+struct Kleo::CryptoConfigModule::LoadingState {
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool finished = false;
+    // the module the result is reported to; reset when the module is destroyed
+    CryptoConfigModule *receiver = nullptr;
+};
+
 inline QIcon loadIcon(const QString &s)
 {
     QString ss = s;
@@ -71,6 +84,14 @@ Kleo::CryptoConfigModule::CryptoConfigModule(QGpgME::CryptoConfig *config, QWidg
     init();
 }
 
+Kleo::CryptoConfigModule::~CryptoConfigModule()
+{
+    if (mLoadingState) {
+        std::lock_guard lock{mLoadingState->mutex};
+        mLoadingState->receiver = nullptr;
+    }
+}
+
 void Kleo::CryptoConfigModule::init()
 {
     if (layout()) {
@@ -78,9 +99,68 @@ void Kleo::CryptoConfigModule::init()
     }
     setDocumentMode(true);
 
+    // reading the configuration runs gpgconf for all components; this is
+    // done in a background thread after the widget has been shown
+    auto loadingLabel = new QLabel(i18nc("@info", "Reading the configuration of GnuPG..."), this);
+    loadingLabel->setAlignment(Qt::AlignCenter);
+    addTab(loadingLabel, i18nc("@title:tab", "Loading"));
+}
+
+void Kleo::CryptoConfigModule::showEvent(QShowEvent *event)
+{
+    QTabWidget::showEvent(event);
+    if (!mLoadingState) {
+        startLoadingComponents();
+    }
+}
+
+void Kleo::CryptoConfigModule::startLoadingComponents()
+{
+    mLoadingState = std::make_shared<LoadingState>();
+    mLoadingState->receiver = this;
+    // the configuration is read completely when it is accessed for the first
+    // time; the module doesn't access it until the worker has finished
+    QThreadPool::globalInstance()->start([state = mLoadingState, config = mConfig]() {
+        (void)config->componentList();
+
+        std::lock_guard lock{state->mutex};
+        state->finished = true;
+        state->condition.notify_all();
+        if (state->receiver) {
+            QMetaObject::invokeMethod(
+                state->receiver,
+                [receiver = state->receiver]() {
+                    receiver->loadComponents();
+                },
+                Qt::QueuedConnection);
+        }
+    });
+}
+
+void Kleo::CryptoConfigModule::waitForLoadingToFinish()
+{
+    if (!mLoadingState) {
+        return;
+    }
+    std::unique_lock lock{mLoadingState->mutex};
+    mLoadingState->condition.wait(lock, [this]() {
+        return mLoadingState->finished;
+    });
+}
+
+void Kleo::CryptoConfigModule::loadComponents()
+{
+    if (mComponentsLoaded) {
+        return;
+    }
     QGpgME::CryptoConfig *const config = mConfig;
 
     const QStringList components = sortComponentList(config->componentList());
+
+    auto loadingPage = widget(0);
+    removeTab(0);
+    loadingPage->deleteLater();
+
     for (QStringList::const_iterator it = components.begin(); it != components.end(); ++it) {
         // qCDebug(KLEO_UI_LOG) <<"Component" << (*it).toLocal8Bit() <<":";
         QGpgME::CryptoConfigComponent *comp = config->component(*it);
@@ -89,20 +169,15 @@ void Kleo::CryptoConfigModule::init()
             continue;
         }
 
-        std::unique_ptr<CryptoConfigComponentGUI> compGUI(new CryptoConfigComponentGUI(this, comp));
-        compGUI->setObjectName(*it);
-
-        mComponentGUIs.append(compGUI.get());
-
         auto scrollArea = new QScrollArea(this);
         scrollArea->setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::Preferred);
         scrollArea->setWidgetResizable(true);
 
+        mPendingComponents.insert(scrollArea, *it);
         addTab(scrollArea, comp->description());
-
-        scrollArea->setWidget(compGUI.release());
     }
-    if (mComponentGUIs.empty()) {
+    mComponentsLoaded = true;
+    if (mPendingComponents.empty()) {
         const QString msg = i18n(
             "The gpgconf tool used to provide the information "
             "for this dialog does not seem to be installed "
@@ -116,6 +191,38 @@ void Kleo::CryptoConfigModule::init()
         label->setWordWrap(true);
         label->setMinimumHeight(fontMetrics().lineSpacing() * 5);
         layout->addWidget(label);
+    } else {
+        createComponentGUI(currentIndex());
+        connect(this, &QTabWidget::currentChanged, this, &CryptoConfigModule::createComponentGUI);
+    }
+    Q_EMIT componentsLoaded(hasError());
+}
+
+void Kleo::CryptoConfigModule::createComponentGUI(int index)
+{
+    auto scrollArea = qobject_cast<QScrollArea *>(widget(index));
+    const auto it = mPendingComponents.constFind(scrollArea);
+    if (it == mPendingComponents.cend()) {
+        return;
+    }
+    const QString componentName = it.value();
+    mPendingComponents.erase(it);
+
+    QGpgME::CryptoConfigComponent *comp = mConfig->component(componentName);
+    if (!comp) {
+        qCWarning(KLEO_UI_LOG) << "Component" << componentName << "has disappeared from the configuration";
+        return;
+    }
+    auto compGUI = new CryptoConfigComponentGUI(this, comp);
+    compGUI->setObjectName(componentName);
+    mComponentGUIs.append(compGUI);
+    scrollArea->setWidget(compGUI);
+}
+
+void Kleo::CryptoConfigModule::createAllComponentGUIs()
+{
+    for (int i = 0; i < count(); ++i) {
+        createComponentGUI(i);
     }
 }
 
@@ -217,7 +324,12 @@ QStringList Kleo::CryptoConfigModule::sortGroupList(const QString &moduleName, c
 
 bool Kleo::CryptoConfigModule::hasError() const
 {
-    return mComponentGUIs.empty();
+    return mComponentsLoaded && mComponentGUIs.empty() && mPendingComponents.empty();
+}
+
+bool Kleo::CryptoConfigModule::componentsAreLoaded() const
+{
+    return mComponentsLoaded;
 }
 
 void Kleo::CryptoConfigModule::save()
@@ -231,6 +343,8 @@ void Kleo::CryptoConfigModule::save()
     }
     if (changed) {
         mConfig->sync(true /*runtime*/);
+        // e.g. the compliance mode may have been changed
+        Kleo::Private::cryptoConfigChanged();
     }
 }
 
@@ -244,6 +358,9 @@ void Kleo::CryptoConfigModule::reset()
 
 void Kleo::CryptoConfigModule::defaults()
 {
+    // the defaults of all components have to be saved, not just the defaults
+    // of the components which have been shown so far
+    createAllComponentGUIs();
     QList<CryptoConfigComponentGUI *>::Iterator it = mComponentGUIs.begin();
     for (; it != mComponentGUIs.end(); ++it) {
         (*it)->defaults();
@@ -252,7 +369,10 @@ void Kleo::CryptoConfigModule::defaults()
 
 void Kleo::CryptoConfigModule::cancel()
 {
+    // the configuration mustn't be cleared while it's read by the worker
+    waitForLoadingToFinish();
     mConfig->clear();
+    Kleo::Private::cryptoConfigChanged();
 }
 
 ////
@@ -13,8 +13,14 @@
 
 #include <QTabWidget>
 
+#include <QHash>
 #include <QList>
 
+#include <memory>
+
+class QScrollArea;
+class QShowEvent;
+
 namespace QGpgME
 {
 class CryptoConfig;
@@ -27,15 +33,38 @@ class CryptoConfigComponentGUI;
 /**
  * Crypto Config Module widget, dynamically generated from CryptoConfig
  * It's a simple QWidget so that it can be embedded into a dialog or into a KCModule.
+ *
+ * The configuration is read in a background thread after the widget has been
+ * shown, i.e. the components are not known right after construction.
+ * componentsLoaded() is emitted when the tabs have been added. The widgets of
+ * a tab are only created when the tab is shown for the first time.
+ *
+ * The configuration passed to the constructor must not be used by other code
+ * while it's read, i.e. until componentsLoaded() has been emitted.
  */
 class KLEO_EXPORT CryptoConfigModule : public QTabWidget
 {
     Q_OBJECT
 public:
     explicit CryptoConfigModule(QGpgME::CryptoConfig *config, QWidget *parent = nullptr);
-
+    ~CryptoConfigModule() override;
+
+    /**
+     * Returns true if the configuration has been read and it didn't contain
+     * any components.
+     *
+     * \note Before the configuration has been read, i.e. before
+     * componentsLoaded() has been emitted, this returns false. Use the
+     * signal to find out whether the configuration could be read.
+     */
     bool hasError() const;
 
+    /**
+     * Returns true if the configuration has been read and the tabs for the
+     * components have been added.
+     */
+    bool componentsAreLoaded() const;
+
     void save();
     void reset(); // i.e. reload current settings, discarding user input
     void defaults();
@@ -43,9 +72,23 @@ public:
 
 Q_SIGNALS:
     void changed();
+    /**
+     * Emitted when the configuration has been read and the tabs for the
+     * components have been added. @p hasError is true if the configuration
+     * didn't contain any components (see hasError()).
+     */
+    void componentsLoaded(bool hasError);
+
+protected:
+    void showEvent(QShowEvent *event) override;
 
 private:
     void init();
+    void startLoadingComponents();
+    void waitForLoadingToFinish();
+    void loadComponents();
+    void createComponentGUI(int index);
+    void createAllComponentGUIs();
     static QStringList sortComponentList(const QStringList &components);
 
 public:
@@ -54,6 +97,11 @@ public:
 private:
     QGpgME::CryptoConfig *mConfig = nullptr;
     QList<CryptoConfigComponentGUI *> mComponentGUIs;
+    // the tabs whose widgets haven't been created yet and their component
+    QHash<QScrollArea *, QString> mPendingComponents;
+    bool mComponentsLoaded = false;
+    struct LoadingState;
+    std::shared_ptr<LoadingState> mLoadingState;
 };
 
 }
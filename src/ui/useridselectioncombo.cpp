@@ -10,6 +10,8 @@
 
 #include "progressbar.h"
 
+#include "utils/dncache_p.h"
+
 #include <libkleo/defaultkeyfilter.h>
 #include <libkleo/formatting.h>
 #include <libkleo/keycache.h>
@@ -24,7 +26,6 @@
 
 #include <KLocalizedString>
 
-#include <QGpgME/DN>
 
 #include <QHBoxLayout>
 #include <QList>
@@ -84,11 +85,11 @@ static QString formatUserID(const GpgME::UserID &userID)
         name = QString::fromUtf8(userID.name());
         email = QString::fromUtf8(userID.email());
     } else {
-        const QGpgME::DN dn(userID.id());
-        name = dn[QStringLiteral("CN")];
-        email = dn[QStringLiteral("EMAIL")];
+        const auto subject = DNCache::lookup(userID.id());
+        name = subject.commonName;
+        email = subject.email;
         if (name.isEmpty()) {
-            name = QGpgME::DN(userID.parent().userID(0).id())[QStringLiteral("CN")];
+            name = DNCache::lookup(userID.parent().userID(0).id()).commonName;
         }
     }
     return email.isEmpty() ? name : name.isEmpty() ? email : i18nc("Name <email>", "%1 <%2>", name, email);
@@ -9,6 +9,7 @@
 #include <config-libkleo.h>
 
 #include "assuan.h"
+#include "assuan_p.h"
 
 #include "gnupg.h"
 
@@ -21,6 +22,7 @@
 #include <QThread>
 
 #include <gpgme++/context.h>
+#include <gpgme++/data.h>
 #include <gpgme++/defaultassuantransaction.h>
 #include <gpgme++/error.h>
 
@@ -96,28 +98,110 @@ QByteArray Kleo::Assuan::escapeAttributeValue(QByteArrayView value)
     return result;
 }
 
-std::unique_ptr<GpgME::AssuanTransaction> Kleo::Assuan::sendCommand(std::shared_ptr<GpgME::Context> &context,
-                                                                    const std::string &command,
-                                                                    std::unique_ptr<GpgME::AssuanTransaction> transaction,
-                                                                    GpgME::Error &err)
+std::unique_ptr<GpgME::AssuanTransaction> Kleo::Assuan::Private::transactWithRetry(GpgME::Context &context,
+                                                                                  const std::string &command,
+                                                                                  std::unique_ptr<GpgME::AssuanTransaction> transaction,
+                                                                                  GpgME::Error &err,
+                                                                                  bool launchAgent,
+                                                                                  const WaitFunction &wait)
 {
-    qCDebug(LIBKLEO_LOG) << __func__ << command;
     int connectionAttempts = 1;
-    err = context->assuanTransact(command.c_str(), std::move(transaction));
+    err = context.assuanTransact(command.c_str(), std::move(transaction));
 
     auto retryDelay = initialRetryDelay;
     while (err.code() == GPG_ERR_ASS_CONNECT_FAILED && connectionAttempts < maxConnectionAttempts) {
-        if (connectionAttempts == 1) {
+        if (connectionAttempts == 1 && launchAgent) {
             Kleo::launchGpgAgent(Kleo::SkipCheckForRunningAgent);
         }
         // Esp. on Windows the agent processes may take their time so we try
         // in increasing waits for them to start up
         qCDebug(LIBKLEO_LOG) << "Connecting to the agent failed. Retrying in" << retryDelay.count() << "ms";
-        QThread::msleep(retryDelay.count());
+        if (!wait(retryDelay)) {
+            qCDebug(LIBKLEO_LOG) << __func__ << command << "canceled";
+            err = Error::fromCode(GPG_ERR_CANCELED);
+            return context.takeLastAssuanTransaction();
+        }
         retryDelay = std::min(retryDelay * 2, maxRetryDelay);
         connectionAttempts++;
-        err = context->assuanTransact(command.c_str(), context->takeLastAssuanTransaction());
+        err = context.assuanTransact(command.c_str(), context.takeLastAssuanTransaction());
     }
+    return context.takeLastAssuanTransaction();
+}
+
+std::string_view Kleo::Assuan::Private::BatchData::view(const std::string &buffer, const Span &span) const
+{
+    return std::string_view{buffer}.substr(span.offset, span.size);
+}
+
+Kleo::Assuan::Private::BatchTransaction::BatchTransaction(BatchData &result, const std::function<bool()> &isCanceled)
+    : mResult{result}
+    , mIsCanceled{isCanceled}
+{
+}
+
+void Kleo::Assuan::Private::BatchTransaction::beginCommand(const std::string &command)
+{
+    BatchData::Response response;
+    response.command = {mResult.strings.size(), command.size()};
+    response.data.offset = mResult.data.size();
+    response.firstStatusLine = mResult.statusLines.size();
+    mResult.strings.append(command);
+    mResult.responses.push_back(response);
+}
+
+void Kleo::Assuan::Private::BatchTransaction::endCommand(const Error &err)
+{
+    auto &response = mResult.responses.back();
+    response.error = err;
+    response.data.size = mResult.data.size() - response.data.offset;
+    response.statusLineCount = mResult.statusLines.size() - response.firstStatusLine;
+}
+
+Error Kleo::Assuan::Private::BatchTransaction::data(const char *buffer, size_t length)
+{
+    if (mIsCanceled && mIsCanceled()) {
+        return Error::fromCode(GPG_ERR_CANCELED);
+    }
+    mResult.data.append(buffer, length);
+    return {};
+}
+
+Data Kleo::Assuan::Private::BatchTransaction::inquire(const char *name, const char *args, Error &err)
+{
+    Q_UNUSED(name)
+    Q_UNUSED(args)
+    Q_UNUSED(err)
+    return Data::null;
+}
+
+Error Kleo::Assuan::Private::BatchTransaction::status(const char *status, const char *args)
+{
+    if (mIsCanceled && mIsCanceled()) {
+        return Error::fromCode(GPG_ERR_CANCELED);
+    }
+    const std::string_view keyword{status};
+    const std::string_view value{args ? args : ""};
+    const BatchData::Span keywordSpan{mResult.strings.size(), keyword.size()};
+    mResult.strings.append(keyword);
+    const BatchData::Span valueSpan{mResult.strings.size(), value.size()};
+    mResult.strings.append(value);
+    mResult.statusLines.emplace_back(keywordSpan, valueSpan);
+    return {};
+}
+
+bool Kleo::Assuan::Private::sleep(std::chrono::milliseconds delay)
+{
+    QThread::msleep(delay.count());
+    return true;
+}
+
+std::unique_ptr<GpgME::AssuanTransaction> Kleo::Assuan::sendCommand(std::shared_ptr<GpgME::Context> &context,
+                                                                    const std::string &command,
+                                                                    std::unique_ptr<GpgME::AssuanTransaction> transaction,
+                                                                    GpgME::Error &err)
+{
+    qCDebug(LIBKLEO_LOG) << __func__ << command;
+    auto t = Private::transactWithRetry(*context, command, std::move(transaction), err, true, &Private::sleep);
     if (err.code()) {
         qCDebug(LIBKLEO_LOG) << __func__ << command << "failed:" << err;
         if (err.code() >= GPG_ERR_ASS_GENERAL && err.code() <= GPG_ERR_ASS_UNKNOWN_INQUIRE) {
@@ -126,7 +210,7 @@ std::unique_ptr<GpgME::AssuanTransaction> Kleo::Assuan::sendCommand(std::shared_
         }
         return {};
     }
-    return context->takeLastAssuanTransaction();
+    return t;
 }
 
 std::unique_ptr<DefaultAssuanTransaction> Kleo::Assuan::sendCommand(std::shared_ptr<Context> &context, const std::string &command, Error &err)
@@ -176,3 +260,101 @@ std::string Kleo::Assuan::sendStatusCommand(const std::shared_ptr<Context> &cont
     }
     return {};
 }
+
+class Kleo::Assuan::BatchResult::Private
+{
+public:
+    Kleo::Assuan::Private::BatchData batch;
+};
+
+Kleo::Assuan::BatchResult Kleo::Assuan::sendCommands(const std::vector<std::string> &commands, Error &err)
+{
+    qCDebug(LIBKLEO_LOG) << __func__ << "sending" << commands.size() << "commands";
+    BatchResult result;
+    Private::transactBatchWithPooledConnection(commands, result.d->batch, err, true, &Private::sleep);
+    if (err) {
+        qCDebug(LIBKLEO_LOG) << __func__ << "failed after" << result.size() << "commands:" << err;
+    }
+    return result;
+}
+
+Kleo::Assuan::BatchResult::BatchResult()
+    : d{new Private}
+{
+}
+
+Kleo::Assuan::BatchResult::BatchResult(const BatchResult &other)
+    : d{std::make_unique<Private>(*other.d)}
+{
+}
+
+Kleo::Assuan::BatchResult::BatchResult(BatchResult &&other) noexcept = default;
+
+Kleo::Assuan::BatchResult::~BatchResult() = default;
+
+Kleo::Assuan::BatchResult &Kleo::Assuan::BatchResult::operator=(const BatchResult &other)
+{
+    if (this != &other) {
+        d = std::make_unique<Private>(*other.d);
+    }
+    return *this;
+}
+
+Kleo::Assuan::BatchResult &Kleo::Assuan::BatchResult::operator=(BatchResult &&other) noexcept = default;
+
+std::size_t Kleo::Assuan::BatchResult::size() const
+{
+    return d->batch.responses.size();
+}
+
+bool Kleo::Assuan::BatchResult::empty() const
+{
+    return d->batch.responses.empty();
+}
+
+std::string_view Kleo::Assuan::BatchResult::command(std::size_t index) const
+{
+    Q_ASSERT(index < d->batch.responses.size());
+    return d->batch.view(d->batch.strings, d->batch.responses[index].command);
+}
+
+Error Kleo::Assuan::BatchResult::error(std::size_t index) const
+{
+    Q_ASSERT(index < d->batch.responses.size());
+    return d->batch.responses[index].error;
+}
+
+std::string_view Kleo::Assuan::BatchResult::data(std::size_t index) const
+{
+    Q_ASSERT(index < d->batch.responses.size());
+    return d->batch.view(d->batch.data, d->batch.responses[index].data);
+}
+
+std::vector<Kleo::Assuan::BatchResult::StatusLine> Kleo::Assuan::BatchResult::statusLines(std::size_t index) const
+{
+    Q_ASSERT(index < d->batch.responses.size());
+    const auto &batch = d->batch;
+    const auto &response = batch.responses[index];
+    std::vector<StatusLine> result;
+    result.reserve(response.statusLineCount);
+    for (auto i = response.firstStatusLine; i < response.firstStatusLine + response.statusLineCount; ++i) {
+        result.emplace_back(batch.view(batch.strings, batch.statusLines[i].first), batch.view(batch.strings, batch.statusLines[i].second));
+    }
+    return result;
+}
+
+std::string_view Kleo::Assuan::BatchResult::status(std::size_t index) const
+{
+    Q_ASSERT(index < d->batch.responses.size());
+    const auto &batch = d->batch;
+    const auto command = this->command(index);
+    const auto lastSpace = command.rfind(' ');
+    const auto needle = lastSpace == std::string_view::npos ? command : command.substr(lastSpace + 1);
+    const auto &response = batch.responses[index];
+    for (auto i = response.firstStatusLine; i < response.firstStatusLine + response.statusLineCount; ++i) {
+        if (batch.view(batch.strings, batch.statusLines[i].first) == needle) {
+            return batch.view(batch.strings, batch.statusLines[i].second);
+        }
+    }
+    return {};
+}
@@ -12,8 +12,11 @@
 
 #include <QByteArray>
 
+#include <cstddef>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace GpgME
@@ -30,10 +33,79 @@ namespace Kleo
  *  agent via the Assuan protocol. */
 namespace Assuan
 {
+class BatchResult;
+
+/** Sends the Assuan @p commands one after the other over a single connection
+ *  to the GnuPG agent and waits for the results. Returns the data and the status
+ *  lines sent by the agent in response to all commands.
+ *  An error reported by the agent for a command is available via
+ *  BatchResult::error() and doesn't stop the batch. If the connection fails
+ *  or can't be established, then @p err provides details and the remaining
+ *  commands are not sent.
+ *  Use this instead of multiple calls of sendStatusCommand() to read several
+ *  card attributes, e.g. the commands "SCD GETATTR SERIALNO" and
+ *  "SCD GETATTR KEY-FPR". */
+KLEO_EXPORT BatchResult sendCommands(const std::vector<std::string> &commands, GpgME::Error &err);
+
+/**
+ * The responses of the GnuPG agent to a batch of Assuan commands sent with
+ * sendCommands().
+ *
+ * The data and the status lines of all responses are stored in two flat
+ * buffers; the accessors return views into these buffers which are valid as
+ * long as the BatchResult is alive and not modified.
+ */
+class KLEO_EXPORT BatchResult
+{
+public:
+    using StatusLine = std::pair<std::string_view, std::string_view>;
+
+    BatchResult();
+    BatchResult(const BatchResult &other);
+    BatchResult(BatchResult &&other) noexcept;
+    ~BatchResult();
+
+    BatchResult &operator=(const BatchResult &other);
+    BatchResult &operator=(BatchResult &&other) noexcept;
+
+    /** Returns the number of commands that have been sent to the agent. */
+    std::size_t size() const;
+    bool empty() const;
+
+    /** Returns the command with the given @p index. */
+    std::string_view command(std::size_t index) const;
+
+    /** Returns the error reported by the agent for the command with the given @p index. */
+    GpgME::Error error(std::size_t index) const;
+
+    /** Returns the data sent by the agent in response to the command with the given @p index. */
+    std::string_view data(std::size_t index) const;
+
+    /** Returns the status lines sent by the agent in response to the command with the given @p index. */
+    std::vector<StatusLine> statusLines(std::size_t index) const;
+
+    /**
+     * Returns the value of the status line whose keyword matches the last
+     * word of the command with the given @p index like sendStatusCommand()
+     * does it.
+     */
+    std::string_view status(std::size_t index) const;
+
+private:
+    friend BatchResult sendCommands(const std::vector<std::string> &commands, GpgME::Error &err);
+
+    class Private;
+    std::unique_ptr<Private> d;
+};
 
 /** Checks if the GnuPG agent is running and accepts connections. */
 KLEO_EXPORT bool agentIsRunning();
 
+/** Closes the idle connections to the GnuPG agent which are kept open for
+ *  reuse by AssuanCommand and SCDaemon. Connections which are in use are closed
+ *  when they are released. Call this if the agent has been restarted. */
+KLEO_EXPORT void closeIdleConnections();
+
 /*! Escapes \a value for usage as value in a SETATTR call. */
 KLEO_EXPORT QByteArray escapeAttributeValue(QByteArrayView value);
 
@@ -0,0 +1,143 @@
+/*
+    This file is part of libkleopatra
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "assuan.h"
+
+#include <gpgme++/error.h>
+#include <gpgme++/interfaces/assuantransaction.h>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace GpgME
+{
+class Context;
+}
+
+namespace Kleo::Assuan::Private
+{
+
+/**
+ * Called before a failed connection attempt is retried with the delay to wait.
+ * Returns false if the retries shall be aborted.
+ */
+using WaitFunction = std::function<bool(std::chrono::milliseconds delay)>;
+
+/**
+ * Sends the Assuan @p command using the @p transaction and the @p context.
+ * If connecting to the agent fails, then the agent is launched (if
+ * @p launchAgent is true) and the command is retried up to 10 times with
+ * increasing delays. @p wait is called to wait before each retry; if it
+ * returns false, then @p err is set to GPG_ERR_CANCELED.
+ * Returns the transaction, also if the command failed, so that the transaction
+ * can be reused for further commands. Returns a null pointer if no transaction
+ * was started.
+ */
+std::unique_ptr<GpgME::AssuanTransaction> transactWithRetry(GpgME::Context &context,
+                                                            const std::string &command,
+                                                            std::unique_ptr<GpgME::AssuanTransaction> transaction,
+                                                            GpgME::Error &err,
+                                                            bool launchAgent,
+                                                            const WaitFunction &wait);
+
+/**
+ * Sends the Assuan @p command like transactWithRetry(), but uses a connection
+ * to the agent from a pool of persistent connections instead of a new
+ * connection. The connection is reset with RESET and returned to the pool
+ * afterwards unless the transaction failed with an error that indicates a
+ * broken connection. If a connection from the pool turns out to be broken,
+ * then the command is sent once more over a new connection.
+ * This function is thread-safe.
+ */
+std::unique_ptr<GpgME::AssuanTransaction> transactWithPooledConnection(const std::string &command,
+                                                                       std::unique_ptr<GpgME::AssuanTransaction> transaction,
+                                                                       GpgME::Error &err,
+                                                                       bool launchAgent,
+                                                                       const WaitFunction &wait);
+
+/**
+ * The responses to a batch of Assuan commands as they are stored by a
+ * BatchResult. The data and the status lines of all responses are stored in
+ * two flat buffers with offset records per command.
+ */
+struct BatchData {
+    struct Span {
+        std::size_t offset = 0;
+        std::size_t size = 0;
+    };
+    struct Response {
+        Span command;
+        GpgME::Error error;
+        Span data;
+        std::size_t firstStatusLine = 0;
+        std::size_t statusLineCount = 0;
+    };
+
+    std::string_view view(const std::string &buffer, const Span &span) const;
+
+    // the data of all responses
+    std::string data;
+    // the commands and the keywords and values of all status lines
+    std::string strings;
+    std::vector<Response> responses;
+    std::vector<std::pair<Span, Span>> statusLines;
+};
+
+/**
+ * An Assuan transaction which appends the responses to several commands to
+ * @p result. beginCommand() and endCommand() have to be called before and
+ * after each command. The transaction is aborted when @p isCanceled returns true.
+ */
+class BatchTransaction : public GpgME::AssuanTransaction
+{
+public:
+    explicit BatchTransaction(BatchData &result, const std::function<bool()> &isCanceled = {});
+
+    void beginCommand(const std::string &command);
+    void endCommand(const GpgME::Error &err);
+
+private:
+    GpgME::Error data(const char *buffer, size_t length) override;
+    GpgME::Data inquire(const char *name, const char *args, GpgME::Error &err) override;
+    GpgME::Error status(const char *status, const char *args) override;
+
+private:
+    BatchData &mResult;
+    std::function<bool()> mIsCanceled;
+};
+
+/**
+ * Sends the Assuan @p commands one after the other over a single connection
+ * to the agent from the pool of persistent connections and appends the
+ * responses to @p result. Errors reported by the agent for single commands
+ * are stored in @p result. If the connection fails, then @p err is set and
+ * the remaining commands are not sent. The retries for connecting to the
+ * agent are handled like in transactWithRetry(). @p isCanceled is checked
+ * whenever a response line is received.
+ * This function is thread-safe.
+ */
+void transactBatchWithPooledConnection(const std::vector<std::string> &commands,
+                                       BatchData &result,
+                                       GpgME::Error &err,
+                                       bool launchAgent,
+                                       const WaitFunction &wait,
+                                       const std::function<bool()> &isCanceled = {});
+
+/**
+ * A WaitFunction which blocks the calling thread for the delay.
+ */
+bool sleep(std::chrono::milliseconds delay);
+
+}
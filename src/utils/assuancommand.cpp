@@ -0,0 +1,381 @@
+/*
+    This file is part of libkleopatra
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-libkleo.h>
+
+#include "assuancommand.h"
+
+#include "assuan_p.h"
+#include "assuancommand_p.h"
+
+#include <libkleo_debug.h>
+
+#if __has_include(<QGpgME/Debug>)
+#include <QGpgME/Debug>
+#endif
+
+#include <QThreadPool>
+
+#include <gpgme++/data.h>
+#include <gpgme++/interfaces/assuantransaction.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+
+using namespace Kleo;
+using namespace GpgME;
+
+namespace
+{
+// the state shared by an AssuanCommand and the worker running its transaction
+struct SharedState {
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::atomic<bool> canceled = false;
+    // the command the result is reported to; reset when the command is destroyed
+    AssuanCommand *receiver = nullptr;
+};
+
+// the retries which are put on hold for the tests (see setAssuanCommandRetriesOnHold())
+struct RetryHold {
+    std::mutex mutex;
+    bool onHold = false;
+    int waitCount = 0;
+    std::atomic<quint64> releaseGeneration = 0;
+    std::vector<std::shared_ptr<SharedState>> waiters;
+};
+
+RetryHold &retryHold()
+{
+    static RetryHold *hold = new RetryHold;
+    return *hold;
+}
+
+// waits until the retries are released or the command is canceled;
+// returns std::nullopt if the retries aren't on hold
+std::optional<bool> waitForReleaseOfRetry(const std::shared_ptr<SharedState> &state)
+{
+    auto &hold = retryHold();
+    std::unique_lock holdLock{hold.mutex};
+    if (!hold.onHold) {
+        return std::nullopt;
+    }
+    ++hold.waitCount;
+    hold.waiters.push_back(state);
+    const quint64 generation = hold.releaseGeneration;
+    holdLock.unlock();
+
+    bool canceled;
+    {
+        std::unique_lock lock{state->mutex};
+        state->condition.wait(lock, [&state, &hold, generation]() {
+            return state->canceled || hold.releaseGeneration != generation;
+        });
+        canceled = state->canceled;
+    }
+
+    holdLock.lock();
+    hold.waiters.erase(std::find(hold.waiters.begin(), hold.waiters.end(), state));
+    return !canceled;
+}
+
+// collects the data and the status lines like DefaultAssuanTransaction, but
+// aborts the transaction when the command has been canceled
+class CancelableTransaction : public AssuanTransaction
+{
+public:
+    explicit CancelableTransaction(const std::shared_ptr<SharedState> &state)
+        : mState{state}
+    {
+    }
+
+    std::string mData;
+    std::vector<std::pair<std::string, std::string>> mStatusLines;
+
+private:
+    Error data(const char *buffer, size_t length) override
+    {
+        if (mState->canceled) {
+            return Error::fromCode(GPG_ERR_CANCELED);
+        }
+        mData.append(buffer, length);
+        return {};
+    }
+
+    Data inquire(const char *name, const char *args, Error &err) override
+    {
+        Q_UNUSED(name)
+        Q_UNUSED(args)
+        Q_UNUSED(err)
+        return Data::null;
+    }
+
+    Error status(const char *status, const char *args) override
+    {
+        if (mState->canceled) {
+            return Error::fromCode(GPG_ERR_CANCELED);
+        }
+        mStatusLines.emplace_back(status, args);
+        return {};
+    }
+
+private:
+    std::shared_ptr<SharedState> mState;
+};
+
+// Assuan transactions block while waiting for the agent; therefore, they
+// are run by a separate pool and not by the global thread pool
+QThreadPool *assuanThreadPool()
+{
+    static QThreadPool *pool = []() {
+        auto pool = new QThreadPool;
+        pool->setObjectName(QStringLiteral("Kleo::AssuanCommand"));
+        pool->setMaxThreadCount(4);
+        return pool;
+    }();
+    return pool;
+}
+}
+
+class AssuanCommand::Private
+{
+    friend class ::Kleo::AssuanCommand;
+    AssuanCommand *const q;
+
+public:
+    Private(AssuanCommand *qq, const std::string &command)
+        : q{qq}
+        , mCommand{command}
+    {
+    }
+
+    ~Private()
+    {
+        detach();
+    }
+
+private:
+    void start();
+    void cancel();
+    void detach();
+    void finish(const Error &err, std::string &&data, std::vector<std::pair<std::string, std::string>> &&statusLines);
+
+private:
+    const std::string mCommand;
+    bool mLaunchAgent = true;
+    bool mRunning = false;
+    std::shared_ptr<SharedState> mState;
+    Error mError;
+    std::string mData;
+    std::vector<std::pair<std::string, std::string>> mStatusLines;
+};
+
+void AssuanCommand::Private::start()
+{
+    if (mRunning) {
+        qCDebug(LIBKLEO_LOG) << "AssuanCommand:" << mCommand << "is already running";
+        return;
+    }
+    mRunning = true;
+    mError = {};
+    mData.clear();
+    mStatusLines.clear();
+    mState = std::make_shared<SharedState>();
+    mState->receiver = q;
+
+    assuanThreadPool()->start([state = mState, command = mCommand, launchAgent = mLaunchAgent]() {
+        qCDebug(LIBKLEO_LOG) << "AssuanCommand:" << command;
+        Error err;
+        std::string data;
+        std::vector<std::pair<std::string, std::string>> statusLines;
+        const auto wait = [&state](std::chrono::milliseconds delay) {
+            if (const auto released = waitForReleaseOfRetry(state)) {
+                return *released;
+            }
+            std::unique_lock lock{state->mutex};
+            return !state->condition.wait_for(lock, delay, [&state]() {
+                return state->canceled.load();
+            });
+        };
+        const auto t = Assuan::Private::transactWithPooledConnection(command, std::make_unique<CancelableTransaction>(state), err, launchAgent, wait);
+        auto transaction = dynamic_cast<CancelableTransaction *>(t.get());
+        if (transaction && !err) {
+            data = std::move(transaction->mData);
+            statusLines = std::move(transaction->mStatusLines);
+        }
+        if (err && state->canceled) {
+            err = Error::fromCode(GPG_ERR_CANCELED);
+        }
+        if (err) {
+            qCDebug(LIBKLEO_LOG) << "AssuanCommand:" << command << "failed:" << err;
+        }
+
+        std::lock_guard lock{state->mutex};
+        if (state->receiver) {
+            QMetaObject::invokeMethod(
+                state->receiver,
+                [receiver = state->receiver, err, data = std::move(data), statusLines = std::move(statusLines)]() mutable {
+                    receiver->d->finish(err, std::move(data), std::move(statusLines));
+                },
+                Qt::QueuedConnection);
+        }
+    });
+}
+
+void AssuanCommand::Private::cancel()
+{
+    if (!mRunning) {
+        return;
+    }
+    {
+        std::lock_guard lock{mState->mutex};
+        mState->canceled = true;
+    }
+    mState->condition.notify_all();
+}
+
+void AssuanCommand::Private::detach()
+{
+    if (!mState) {
+        return;
+    }
+    {
+        std::lock_guard lock{mState->mutex};
+        mState->receiver = nullptr;
+        mState->canceled = true;
+    }
+    mState->condition.notify_all();
+    mState.reset();
+}
+
+void AssuanCommand::Private::finish(const Error &err, std::string &&data, std::vector<std::pair<std::string, std::string>> &&statusLines)
+{
+    mState.reset();
+    mRunning = false;
+    mError = err;
+    mData = std::move(data);
+    mStatusLines = std::move(statusLines);
+    Q_EMIT q->finished(mError);
+}
+
+AssuanCommand::AssuanCommand(const std::string &command, QObject *parent)
+    : QObject{parent}
+    , d{new Private{this, command}}
+{
+}
+
+AssuanCommand::~AssuanCommand() = default;
+
+std::string AssuanCommand::command() const
+{
+    return d->mCommand;
+}
+
+void AssuanCommand::setLaunchAgent(bool launchAgent)
+{
+    d->mLaunchAgent = launchAgent;
+}
+
+bool AssuanCommand::launchAgent() const
+{
+    return d->mLaunchAgent;
+}
+
+void AssuanCommand::start()
+{
+    d->start();
+}
+
+void AssuanCommand::cancel()
+{
+    d->cancel();
+}
+
+bool AssuanCommand::isRunning() const
+{
+    return d->mRunning;
+}
+
+GpgME::Error AssuanCommand::error() const
+{
+    return d->mError;
+}
+
+std::string AssuanCommand::data() const
+{
+    return d->mData;
+}
+
+std::vector<std::pair<std::string, std::string>> AssuanCommand::statusLines() const
+{
+    return d->mStatusLines;
+}
+
+std::string AssuanCommand::status() const
+{
+    // The status is only the last attribute
+    // e.g. for SCD SERIALNO it would only be "SERIALNO" and for SCD GETATTR FOO
+    // it would only be FOO
+    const auto lastSpace = d->mCommand.rfind(' ');
+    const auto needle = lastSpace == std::string::npos ? d->mCommand : d->mCommand.substr(lastSpace + 1);
+    for (const auto &pair : d->mStatusLines) {
+        if (pair.first == needle) {
+            return pair.second;
+        }
+    }
+    return {};
+}
+
+void Kleo::Private::setAssuanCommandRetriesOnHold(bool onHold)
+{
+    {
+        auto &hold = retryHold();
+        std::lock_guard lock{hold.mutex};
+        hold.onHold = onHold;
+        hold.waitCount = 0;
+    }
+    if (!onHold) {
+        releaseAssuanCommandRetries();
+    }
+}
+
+void Kleo::Private::releaseAssuanCommandRetries()
+{
+    auto &hold = retryHold();
+    std::vector<std::shared_ptr<SharedState>> waiters;
+    {
+        std::lock_guard lock{hold.mutex};
+        ++hold.releaseGeneration;
+        waiters = hold.waiters;
+    }
+    for (const auto &state : waiters) {
+        {
+            // make sure that the waiting worker doesn't miss the notification
+            std::lock_guard lock{state->mutex};
+        }
+        state->condition.notify_all();
+    }
+}
+
+int Kleo::Private::assuanCommandRetryWaitCount()
+{
+    auto &hold = retryHold();
+    std::lock_guard lock{hold.mutex};
+    return hold.waitCount;
+}
+
+int Kleo::Private::assuanCommandsWaitingForRetry()
+{
+    auto &hold = retryHold();
+    std::lock_guard lock{hold.mutex};
+    return static_cast<int>(hold.waiters.size());
+}
+
+#include "moc_assuancommand.cpp"
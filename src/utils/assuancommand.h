@@ -0,0 +1,102 @@
+/*
+    This file is part of libkleopatra
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "kleo_export.h"
+
+#include <QObject>
+
+#include <gpgme++/error.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Kleo
+{
+
+/**
+ * Sends an Assuan command to the GnuPG agent without blocking the calling
+ * thread.
+ *
+ * The command is sent by a worker thread which is dedicated to Assuan
+ * transactions. The connections to the agent are kept open and are reused
+ * by subsequent commands. If connecting to the agent fails, then the agent is launched
+ * and the command is retried with increasing delays like
+ * Assuan::sendCommand() does it. finished() is emitted in the thread the
+ * object lives in when the transaction has completed, failed, or was canceled.
+ *
+ * Example:
+ * \code
+ * auto command = new AssuanCommand{"SCD GETINFO reader_list", this};
+ * connect(command, &AssuanCommand::finished, this, [command](const GpgME::Error &err) {
+ *     if (!err) {
+ *         use(command->data());
+ *     }
+ *     command->deleteLater();
+ * });
+ * command->start();
+ * \endcode
+ */
+class KLEO_EXPORT AssuanCommand : public QObject
+{
+    Q_OBJECT
+public:
+    explicit AssuanCommand(const std::string &command, QObject *parent = nullptr);
+    ~AssuanCommand() override;
+
+    std::string command() const;
+
+    /**
+     * Sets whether the agent is launched if connecting to it fails. The
+     * default is true.
+     */
+    void setLaunchAgent(bool launchAgent);
+    bool launchAgent() const;
+
+    /**
+     * Starts the transaction. Does nothing if the transaction is already running.
+     */
+    void start();
+
+    /**
+     * Cancels the transaction. Waiting for the agent is aborted immediately.
+     * A transaction that has been sent to the agent already is aborted when the
+     * next response line is received. finished() is emitted with the error
+     * GPG_ERR_CANCELED unless the transaction completed before.
+     */
+    void cancel();
+
+    bool isRunning() const;
+
+    /** Returns the result of the last transaction. */
+    GpgME::Error error() const;
+
+    /** Returns the data sent by the agent in response to the command. */
+    std::string data() const;
+
+    /** Returns the status lines sent by the agent in response to the command. */
+    std::vector<std::pair<std::string, std::string>> statusLines() const;
+
+    /**
+     * Returns the value of the status line whose keyword matches the last
+     * word of the command (e.g. "SERIALNO" for "SCD SERIALNO") like
+     * Assuan::sendStatusCommand() does it.
+     */
+    std::string status() const;
+
+Q_SIGNALS:
+    void finished(const GpgME::Error &err);
+
+private:
+    class Private;
+    std::unique_ptr<Private> const d;
+};
+
+}
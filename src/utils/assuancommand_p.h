@@ -0,0 +1,38 @@
+/*
+    This file is part of libkleopatra
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+namespace Kleo::Private
+{
+
+/**
+ * If @p onHold is true, then AssuanCommand doesn't wait for the retry delay
+ * before retrying to connect to the agent, but it waits until
+ * releaseAssuanCommandRetries() is called or the command is canceled.
+ * Used by the tests for synchronizing with the waiting commands.
+ */
+void setAssuanCommandRetriesOnHold(bool onHold);
+
+/**
+ * Lets all commands which are currently waiting for a retry (see
+ * setAssuanCommandRetriesOnHold()) retry to connect to the agent.
+ */
+void releaseAssuanCommandRetries();
+
+/**
+ * Returns how often commands started to wait for a retry since the retries
+ * were put on hold.
+ */
+int assuanCommandRetryWaitCount();
+
+/**
+ * Returns the number of commands which are currently waiting for a retry.
+ */
+int assuanCommandsWaitingForRetry();
+
+}
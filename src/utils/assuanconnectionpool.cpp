@@ -0,0 +1,236 @@
+/*
+    This file is part of libkleopatra
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-libkleo.h>
+
+#include "assuan.h"
+#include "assuan_p.h"
+
+#include <libkleo_debug.h>
+
+#if __has_include(<QGpgME/Debug>)
+#include <QGpgME/Debug>
+#endif
+
+#include <QMutex>
+
+#include <gpgme++/context.h>
+#include <gpgme++/error.h>
+#include <gpgme++/interfaces/assuantransaction.h>
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+using namespace GpgME;
+using namespace Kleo;
+using namespace std::chrono_literals;
+
+namespace
+{
+// the number of idle connections kept open; enough for the threads running AssuanCommands
+static const std::size_t maxIdleConnections = 4;
+// idle connections are checked with a NOP before they are reused after this time,
+// e.g. because the agent may have been restarted in the meantime
+static const auto healthCheckInterval = 5s;
+
+bool isConnectionError(const Error &err)
+{
+    const auto code = err.code();
+    return (code >= GPG_ERR_ASS_GENERAL && code <= GPG_ERR_ASS_UNKNOWN_INQUIRE) //
+        || code == GPG_ERR_EOF //
+        || code == GPG_ERR_EPIPE || code == GPG_ERR_ECONNRESET // the agent closed the connection
+        || code == GPG_ERR_CANCELED; // a canceled transaction may leave unread responses
+}
+
+// An idle connection may have been closed by the agent in the meantime (e.g.
+// because the agent was restarted without restartGpgAgent()). Such a connection
+// fails when the command is sent, i.e. before a response was received, so that
+// the command can be sent again over a new connection.
+bool retryOnNewConnection(bool reused, const Error &err)
+{
+    return reused && err.code() != GPG_ERR_CANCELED && isConnectionError(err);
+}
+
+class ConnectionPool
+{
+public:
+    struct Connection {
+        std::unique_ptr<Context> context;
+        // the generation of the pool when the connection was created
+        quint64 generation = 0;
+        std::chrono::steady_clock::time_point lastUsed;
+        // true if the connection was taken from the idle connections
+        bool reused = false;
+    };
+
+    static ConnectionPool *instance()
+    {
+        static ConnectionPool *self = new ConnectionPool();
+        return self;
+    }
+
+    // Returns an idle connection or, if there is none or if @p reuse is false,
+    // a new connection.
+    Connection acquire(Error &err, bool reuse = true)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        while (reuse) {
+            Connection connection;
+            {
+                QMutexLocker locker{&mMutex};
+                if (mIdleConnections.empty()) {
+                    break;
+                }
+                // reuse the most recently used connection; it's the least likely to be stale
+                connection = std::move(mIdleConnections.back());
+                mIdleConnections.pop_back();
+            }
+            connection.reused = true;
+            if (now - connection.lastUsed < healthCheckInterval) {
+                return connection;
+            }
+            // check the connection without holding the lock
+            const Error checkErr = connection.context->assuanTransact("NOP");
+            if (!checkErr) {
+                return connection;
+            }
+            qCDebug(LIBKLEO_LOG) << "AssuanConnectionPool: Dropping broken connection:" << checkErr;
+        }
+
+        Connection connection;
+        connection.context = Context::createForEngine(AssuanEngine, &err);
+        if (err) {
+            qCWarning(LIBKLEO_LOG) << "AssuanConnectionPool: Creating context for Assuan engine failed:" << err;
+            return {};
+        }
+        QMutexLocker locker{&mMutex};
+        connection.generation = mGeneration;
+        return connection;
+    }
+
+    void release(Connection &&connection)
+    {
+        {
+            QMutexLocker locker{&mMutex};
+            if (connection.generation != mGeneration || mIdleConnections.size() >= maxIdleConnections) {
+                return;
+            }
+        }
+        // reset the state of the session (e.g. options or keys set with SETKEY),
+        // so that it doesn't affect the commands which use the connection next;
+        // done without holding the lock
+        const Error resetErr = connection.context->assuanTransact("RESET");
+        if (resetErr) {
+            qCDebug(LIBKLEO_LOG) << "AssuanConnectionPool: Dropping connection after failed reset:" << resetErr;
+            return;
+        }
+        connection.lastUsed = std::chrono::steady_clock::now();
+        connection.reused = false;
+        QMutexLocker locker{&mMutex};
+        if (connection.generation != mGeneration || mIdleConnections.size() >= maxIdleConnections) {
+            return;
+        }
+        mIdleConnections.push_back(std::move(connection));
+    }
+
+    void clear()
+    {
+        std::vector<Connection> connections;
+        {
+            QMutexLocker locker{&mMutex};
+            ++mGeneration;
+            connections.swap(mIdleConnections);
+        }
+        // the connections are closed without holding the lock
+    }
+
+private:
+    QMutex mMutex;
+    std::vector<Connection> mIdleConnections;
+    quint64 mGeneration = 0;
+};
+}
+
+std::unique_ptr<AssuanTransaction> Kleo::Assuan::Private::transactWithPooledConnection(const std::string &command,
+                                                                                     std::unique_ptr<AssuanTransaction> transaction,
+                                                                                     Error &err,
+                                                                                     bool launchAgent,
+                                                                                     const WaitFunction &wait)
+{
+    auto pool = ConnectionPool::instance();
+    auto connection = pool->acquire(err);
+    if (!connection.context) {
+        return {};
+    }
+    auto t = transactWithRetry(*connection.context, command, std::move(transaction), err, launchAgent, wait);
+    if (t && retryOnNewConnection(connection.reused, err)) {
+        qCDebug(LIBKLEO_LOG) << "AssuanConnectionPool: Retrying with new connection after error:" << err;
+        connection = pool->acquire(err, false);
+        if (!connection.context) {
+            return {};
+        }
+        t = transactWithRetry(*connection.context, command, std::move(t), err, launchAgent, wait);
+    }
+    if (isConnectionError(err)) {
+        qCDebug(LIBKLEO_LOG) << "AssuanConnectionPool: Dropping connection after error:" << err;
+    } else {
+        pool->release(std::move(connection));
+    }
+    return t;
+}
+
+void Kleo::Assuan::Private::transactBatchWithPooledConnection(const std::vector<std::string> &commands,
+                                                              BatchData &result,
+                                                              Error &err,
+                                                              bool launchAgent,
+                                                              const WaitFunction &wait,
+                                                              const std::function<bool()> &isCanceled)
+{
+    err = {};
+    if (commands.empty()) {
+        return;
+    }
+    auto pool = ConnectionPool::instance();
+    auto connection = pool->acquire(err);
+    if (!connection.context) {
+        return;
+    }
+    // the same transaction collects the responses to all commands
+    std::unique_ptr<AssuanTransaction> transaction = std::make_unique<BatchTransaction>(result, isCanceled);
+    for (std::size_t i = 0; i < commands.size();) {
+        const auto &command = commands[i];
+        auto batchTransaction = static_cast<BatchTransaction *>(transaction.get());
+        batchTransaction->beginCommand(command);
+        Error commandErr;
+        transaction = transactWithRetry(*connection.context, command, std::move(transaction), commandErr, launchAgent, wait);
+        batchTransaction->endCommand(commandErr);
+        if (transaction && i == 0 && retryOnNewConnection(connection.reused, commandErr)) {
+            // start over with a new connection; the session state of the
+            // first connection is lost, so only the first command is retried
+            qCDebug(LIBKLEO_LOG) << "AssuanConnectionPool: Retrying with new connection after error:" << commandErr;
+            result = BatchData{};
+            connection = pool->acquire(err, false);
+            if (!connection.context) {
+                return;
+            }
+            continue;
+        }
+        if (isConnectionError(commandErr) || !transaction) {
+            qCDebug(LIBKLEO_LOG) << "AssuanConnectionPool: Dropping connection after error:" << commandErr;
+            err = commandErr;
+            return;
+        }
+        ++i;
+    }
+    pool->release(std::move(connection));
+}
+
+void Kleo::Assuan::closeIdleConnections()
+{
+    ConnectionPool::instance()->clear();
+}
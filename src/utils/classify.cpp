@@ -11,14 +11,14 @@
 
 #include "algorithm.h"
 #include "classifyconfig.h"
+#include "parallel_p.h"
 
 #include <libkleo/checksumdefinition.h>
 
 #include <libkleo_debug.h>
 
-#include <QGpgME/DataProvider>
-
 #include <QByteArrayMatcher>
+#include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QMap>
@@ -30,6 +30,7 @@
 
 #include <functional>
 #include <iterator>
+#include <numeric>
 
 using namespace Kleo::Class;
 using namespace Qt::Literals::StringLiterals;
@@ -120,27 +121,38 @@ private:
 };
 }
 
-unsigned int Kleo::classify(const QStringList &fileNames)
-{
-    if (fileNames.empty()) {
-        return 0;
-    }
-    unsigned int result = classify(fileNames.front());
-    for (const QString &fileName : fileNames) {
-        result &= classify(fileName);
-    }
-    return result;
-}
-
 static bool mimeTypeInherits(const QMimeType &mimeType, const QString &mimeTypeName)
 {
     // inherits is expensive on an invalid mimeType
     return mimeType.isValid() && mimeType.inherits(mimeTypeName);
 }
 
+namespace
+{
+// Classifies files. The configuration is read once on construction, so that
+// many files can be classified without reading it again. classify() can be
+// called concurrently from different threads.
+class Classifier
+{
+public:
+    Classifier()
+        : m_p7mWithoutExtensionAreEmail{Kleo::ClassifyConfig{}.p7mWithoutExtensionAreEmail()}
+    {
+    }
+
+    unsigned int classify(const QString &filename) const;
+
+private:
+    bool isMailFile(const QFileInfo &fi) const;
+
+    const bool m_p7mWithoutExtensionAreEmail;
+    // QMimeDatabase is thread-safe
+    const QMimeDatabase m_mimeDatabase;
+};
+
 /// Detect either a complete mail file (e.g. mbox or eml file) or a encrypted attachment
 /// corresponding to a mail file
-static bool isMailFile(const QFileInfo &fi)
+bool Classifier::isMailFile(const QFileInfo &fi) const
 {
     static const QRegularExpression attachmentNumbering{QStringLiteral(R"(\([0-9]+\))")};
     const auto fileName = fi.fileName().remove(attachmentNumbering);
@@ -149,27 +161,21 @@ static bool isMailFile(const QFileInfo &fi)
         return true;
     }
 
-    {
-        Kleo::ClassifyConfig classifyConfig;
-
-        if (classifyConfig.p7mWithoutExtensionAreEmail() && fileName.endsWith(QStringLiteral(".p7m"), Qt::CaseInsensitive)
-            && fi.completeSuffix() == fi.suffix()) {
-            // match "myfile.p7m" but not "myfile.pdf.p7m"
-            return true;
-        }
+    if (m_p7mWithoutExtensionAreEmail && fileName.endsWith(QStringLiteral(".p7m"), Qt::CaseInsensitive) && fi.completeSuffix() == fi.suffix()) {
+        // match "myfile.p7m" but not "myfile.pdf.p7m"
+        return true;
     }
 
-    QMimeDatabase mimeDatabase;
-    const auto mimeType = mimeDatabase.mimeTypeForFile(fi);
+    const auto mimeType = m_mimeDatabase.mimeTypeForFile(fi);
     return mimeTypeInherits(mimeType, QStringLiteral("message/rfc822")) || mimeTypeInherits(mimeType, QStringLiteral("application/mbox"));
 }
 
-static unsigned int classifyExtension(const QFileInfo &fi)
+unsigned int classifyExtension(const QFileInfo &fi)
 {
     return classifications.value(fi.suffix().toLower(), defaultClassification);
 }
 
-unsigned int Kleo::classify(const QString &filename)
+unsigned int Classifier::classify(const QString &filename) const
 {
     const QFileInfo fi(filename);
 
@@ -190,7 +196,7 @@ unsigned int Kleo::classify(const QString &filename)
     }
 
     /* More reliable */
-    const unsigned int contentClass = classifyContent(file.read(4096));
+    const unsigned int contentClass = Kleo::classifyContent(file.read(4096));
     if (contentClass != defaultClassification) {
         qCDebug(LIBKLEO_LOG) << "Classified based on content as:" << contentClass;
         return contentClass;
@@ -201,11 +207,49 @@ unsigned int Kleo::classify(const QString &filename)
     qCDebug(LIBKLEO_LOG) << "No classification based on content.";
     return extClass;
 }
+}
+
+unsigned int Kleo::classify(const QStringList &fileNames)
+{
+    return classifyFiles(fileNames).combined;
+}
+
+Kleo::ClassifyFilesResult Kleo::classifyFiles(const QStringList &fileNames)
+{
+    ClassifyFilesResult result;
+    if (fileNames.empty()) {
+        return result;
+    }
+
+    const Classifier classifier;
+    result.classifications.resize(fileNames.size());
+    // the classification is dominated by I/O (stat, MIME type detection, reading the header);
+    // a few files are classified faster without involving other threads
+    static const std::size_t minimumFilesPerThread = 4;
+    Kleo::Private::forEachIndexInParallel(
+        fileNames.size(),
+        [&](std::size_t i) {
+            result.classifications[i] = classifier.classify(fileNames[i]);
+        },
+        minimumFilesPerThread);
+
+    result.combined = std::accumulate(result.classifications.cbegin(),
+                                      result.classifications.cend(),
+                                      ~0U,
+                                      std::bit_and<unsigned int>{});
+    return result;
+}
+
+unsigned int Kleo::classify(const QString &filename)
+{
+    return Classifier{}.classify(filename);
+}
 
 unsigned int Kleo::classifyContent(const QByteArray &data)
 {
-    QGpgME::QByteArrayDataProvider dp(data);
-    GpgME::Data gpgmeData(&dp);
+    // let gpgme read the data directly from the buffer (without copying it)
+    // instead of through a data provider
+    GpgME::Data gpgmeData(data.constData(), data.size(), /*copy=*/false);
     GpgME::Data::Type type = gpgmeData.type();
 
     return gpgmeTypeMap.value(type, defaultClassification);
@@ -288,6 +332,66 @@ QStringList Kleo::findSignatures(const QString &signedDataFileName)
     return result;
 }
 
+std::vector<Kleo::SignedDataAndSignatures> Kleo::pairSignaturesWithSignedData(const QStringList &fileNames)
+{
+    static const QStringList signatureExtensions = []() {
+        QStringList extensions;
+        for (const auto &[extension, classification] : asKeyValueRange(classifications)) {
+            if (classification & DetachedSignature) {
+                extensions.push_back(QLatin1Char('.') + extension);
+            }
+        }
+        return extensions;
+    }();
+
+#ifdef Q_OS_WIN
+    // file names are case-insensitive on Windows
+    const auto normalized = [](const QString &fileName) {
+        return fileName.toLower();
+    };
+#else
+    const auto normalized = [](const QString &fileName) -> const QString & {
+        return fileName;
+    };
+#endif
+
+    QHash<QString, const QString *> allFileNames; // normalized file name -> file name
+    allFileNames.reserve(fileNames.size());
+    for (const QString &fileName : fileNames) {
+        allFileNames.insert(normalized(fileName), &fileName);
+    }
+
+    std::vector<SignedDataAndSignatures> result;
+    QString candidate;
+    for (const QString &fileName : fileNames) {
+        SignedDataAndSignatures pair;
+        for (const QString &extension : signatureExtensions) {
+            candidate = normalized(fileName);
+            candidate += extension;
+            if (const auto it = allFileNames.constFind(candidate); it != allFileNames.cend()) {
+                pair.signatureFileNames.push_back(**it);
+            }
+        }
+        if (!pair.signatureFileNames.empty()) {
+            pair.signedDataFileName = fileName;
+            result.push_back(std::move(pair));
+        }
+    }
+    return result;
+}
+
+std::vector<Kleo::SignedDataAndSignatures> Kleo::pairSignaturesWithSignedDataInDirectory(const QString &directory)
+{
+    const QDir dir{directory};
+    const auto entries = dir.entryList(QDir::Files | QDir::Hidden, QDir::Name);
+    QStringList fileNames;
+    fileNames.reserve(entries.size());
+    for (const auto &entry : entries) {
+        fileNames.push_back(dir.absoluteFilePath(entry));
+    }
+    return pairSignaturesWithSignedData(fileNames);
+}
+
 #ifdef Q_OS_WIN
 static QString stripOutlookAttachmentNumbering(const QString &s)
 {
@@ -13,6 +13,8 @@
 
 #include <gpgme++/global.h>
 
+#include <vector>
+
 class QByteArray;
 class QString;
 
@@ -70,10 +72,56 @@ enum {
 
 KLEO_EXPORT unsigned int classify(const QString &filename);
 KLEO_EXPORT unsigned int classify(const QStringList &fileNames);
+
+struct ClassifyFilesResult {
+    std::vector<unsigned int> classifications; // the classifications of the files in the order of the file names
+    unsigned int combined = Class::NoClass; // the classification bits shared by all files
+};
+
+/**
+ * Classifies all files in @a fileNames.
+ *
+ * Other than calling classify() for each file, the classification
+ * configuration is read only once and, unless there are only a few files,
+ * the files are examined in parallel on the global thread pool. This makes
+ * classifying many files (e.g. the content of a folder dropped onto
+ * Kleopatra) much faster. The combined classification is the same as the
+ * result of classify(const QStringList &).
+ */
+KLEO_EXPORT ClassifyFilesResult classifyFiles(const QStringList &fileNames);
 KLEO_EXPORT unsigned int classifyContent(const QByteArray &data);
 
 KLEO_EXPORT QString findSignedData(const QString &signatureFileName);
 KLEO_EXPORT QStringList findSignatures(const QString &signedDataFileName);
+
+struct SignedDataAndSignatures {
+    QString signedDataFileName;
+    QStringList signatureFileNames; // in the same order as returned by findSignatures()
+};
+
+/**
+ * Pairs the data files in @a fileNames with their detached signatures in
+ * @a fileNames, e.g. "file.tar.gz" with "file.tar.gz.sig" and "file.tar.gz.asc".
+ *
+ * Other than calling findSignatures() for each file, this doesn't access the
+ * file system. The file names are matched using a hash of the names, so that
+ * pairing the content of a directory with thousands of files is fast. Like
+ * findSignatures(), a file is considered a detached signature based on its
+ * extension.
+ *
+ * @returns the data files that have at least one detached signature in the
+ * order in which they appear in @a fileNames.
+ */
+KLEO_EXPORT std::vector<SignedDataAndSignatures> pairSignaturesWithSignedData(const QStringList &fileNames);
+
+/**
+ * \overload
+ *
+ * Pairs the files in the directory @a directory. The directory is listed once.
+ * The returned file names are absolute paths.
+ */
+KLEO_EXPORT std::vector<SignedDataAndSignatures> pairSignaturesWithSignedDataInDirectory(const QString &directory);
+
 KLEO_EXPORT QString outputFileName(const QString &input);
 
 /** Check if a string looks like a fingerprint (SHA1 sum) */
@@ -9,11 +9,14 @@
 #include <config-libkleo.h>
 
 #include "compliance.h"
+#include "compliance_p.h"
 
 #include "algorithm.h"
 #include "cryptoconfig.h"
+#include "cryptoconfig_p.h"
 #include "gnupg.h"
 #include "keyhelpers.h"
+#include "models/keycache_p.h"
 #include "stringutils.h"
 #include "systeminfo.h"
 
@@ -25,10 +28,15 @@
 #include <KColorScheme>
 #include <KLocalizedString>
 
+#include <QMutex>
 #include <QPushButton>
 
 #include <gpgme++/key.h>
 
+#include <array>
+#include <atomic>
+#include <unordered_map>
+
 using namespace Kleo;
 using namespace Qt::StringLiterals;
 
@@ -39,9 +47,133 @@ namespace Kleo::Tests::DeVSCompliance
 KLEO_EXPORT void forceUsageOfCompliance(bool useComplianceOption)
 {
     *useComplianceForTests() = useComplianceOption;
+    Kleo::Private::cryptoConfigChanged();
 }
 }
 
+namespace
+{
+enum ComplianceFlag : unsigned {
+    StateIsValid = 0x1,
+    IsActive = 0x2,
+    IsCompliant = 0x4,
+    IsBetaCompliance = 0x8,
+};
+constexpr unsigned complianceFlagBits = 4;
+constexpr unsigned complianceFlagMask = (1u << complianceFlagBits) - 1;
+
+// the state of the compliance mode in the lower bits and the generation of
+// the crypto config the state was determined for in the upper bits
+std::atomic<quint64> complianceState{0};
+
+unsigned determineComplianceFlags()
+{
+#if LIBKLEO_FEATURE_DEVS_COMPLIANCE
+    const bool active = getCryptoConfigStringValue("gpg", "compliance") == QLatin1StringView{"de-vs"};
+#else
+    const bool active = useComplianceForTests() && (getCryptoConfigStringValue("gpg", "compliance") == QLatin1StringView{"de-vs"});
+#endif
+    if (!active) {
+        return StateIsValid;
+    }
+    unsigned flags = StateIsValid | IsActive;
+    const int complianceDeVs = getCryptoConfigIntValue("gpg", "compliance_de_vs", 0);
+    // The pseudo option compliance_de_vs was fully added in 2.2.34;
+    // For versions between 2.2.28 and 2.2.33 there was a broken config
+    // value with a wrong type. So for them we add an extra check. This
+    // can be removed in future versions because for GnuPG we could assume
+    // non-compliance for older versions as versions of Kleopatra for
+    // which this matters are bundled with new enough versions of GnuPG anyway.
+    if ((engineIsVersion(2, 2, 28) && !engineIsVersion(2, 2, 34)) || complianceDeVs != 0) {
+        flags |= IsCompliant;
+    }
+    // compliance_de_vs > 2000: GnuPG has not yet been approved for VS-NfD or is beta, but we shall assume approval
+    if (complianceDeVs > 2000) {
+        flags |= IsBetaCompliance;
+    }
+    return flags;
+}
+
+// Returns the state of the compliance mode. The state is determined once
+// and then only again after the configuration of GnuPG may have changed.
+unsigned complianceFlags()
+{
+    const quint64 generation = Kleo::Private::cryptoConfigGeneration();
+    const quint64 state = complianceState.load(std::memory_order_acquire);
+    if ((state & StateIsValid) && (state >> complianceFlagBits) == generation) {
+        return state & complianceFlagMask;
+    }
+    const unsigned flags = determineComplianceFlags();
+    complianceState.store((generation << complianceFlagBits) | flags, std::memory_order_release);
+    return flags;
+}
+
+// The results of the per-key compliance checks. The data of a gpgme key never
+// changes, so the results are keyed by the gpgme key; the keys are kept, so
+// that their gpgme keys cannot be reused for other keys. The results are
+// dropped when the keys in the key cache or the configuration change.
+class KeyComplianceCache
+{
+public:
+    enum Check {
+        KeyIsCompliant,
+        AllSubkeysAreCompliant,
+    };
+
+    static KeyComplianceCache *instance()
+    {
+        static auto *self = new KeyComplianceCache();
+        return self;
+    }
+
+    template<typename Function>
+    bool result(const GpgME::Key &key, Check check, Function compute)
+    {
+        const gpgme_key_t impl = key.impl();
+        if (!impl) {
+            return compute(key);
+        }
+        const quint64 configGeneration = Kleo::Private::cryptoConfigGeneration();
+        const quint64 keyCacheGeneration = Kleo::Private::keyCacheGeneration();
+        {
+            QMutexLocker locker{&mMutex};
+            if (configGeneration != mConfigGeneration || keyCacheGeneration != mKeyCacheGeneration) {
+                mEntries.clear();
+                mConfigGeneration = configGeneration;
+                mKeyCacheGeneration = keyCacheGeneration;
+            }
+            const auto it = mEntries.find(impl);
+            if (it != mEntries.end() && it->second.results[check] >= 0) {
+                return it->second.results[check] == 1;
+            }
+        }
+
+        // check the key without holding the lock
+        const bool compliant = compute(key);
+
+        QMutexLocker locker{&mMutex};
+        if (configGeneration == mConfigGeneration && keyCacheGeneration == mKeyCacheGeneration) {
+            auto &entry = mEntries[impl];
+            entry.key = key;
+            entry.results[check] = compliant ? 1 : 0;
+        }
+        return compliant;
+    }
+
+private:
+    struct Entry {
+        GpgME::Key key;
+        // -1: not checked yet
+        std::array<signed char, 2> results = {-1, -1};
+    };
+
+    QMutex mMutex;
+    quint64 mConfigGeneration = 0;
+    quint64 mKeyCacheGeneration = 0;
+    std::unordered_map<gpgme_key_t, Entry> mEntries;
+};
+}
+
 // May include algorithms that are not available, i.e. you must match the list
 // against the list of available algorithms.
 static const std::vector<std::string> &allCompliantAlgorithms()
@@ -60,37 +192,17 @@ static const std::vector<std::string> &allCompliantAlgorithms()
 
 bool Kleo::DeVSCompliance::isActive()
 {
-#if LIBKLEO_FEATURE_DEVS_COMPLIANCE
-    return getCryptoConfigStringValue("gpg", "compliance") == QLatin1StringView{"de-vs"};
-#else
-    return useComplianceForTests() && (getCryptoConfigStringValue("gpg", "compliance") == QLatin1StringView{"de-vs"});
-#endif
+    return complianceFlags() & IsActive;
 }
 
 bool Kleo::DeVSCompliance::isCompliant()
 {
-    if (!isActive()) {
-        return false;
-    }
-    // The pseudo option compliance_de_vs was fully added in 2.2.34;
-    // For versions between 2.2.28 and 2.2.33 there was a broken config
-    // value with a wrong type. So for them we add an extra check. This
-    // can be removed in future versions because for GnuPG we could assume
-    // non-compliance for older versions as versions of Kleopatra for
-    // which this matters are bundled with new enough versions of GnuPG anyway.
-    if (engineIsVersion(2, 2, 28) && !engineIsVersion(2, 2, 34)) {
-        return true;
-    }
-    return getCryptoConfigIntValue("gpg", "compliance_de_vs", 0) != 0;
+    return complianceFlags() & IsCompliant;
 }
 
 bool Kleo::DeVSCompliance::isBetaCompliance()
 {
-    if (!isActive()) {
-        return false;
-    }
-    // compliance_de_vs > 2000: GnuPG has not yet been approved for VS-NfD or is beta, but we shall assume approval
-    return getCryptoConfigIntValue("gpg", "compliance_de_vs", 0) > 2000;
+    return complianceFlags() & IsBetaCompliance;
 }
 
 bool Kleo::DeVSCompliance::algorithmIsCompliant(std::string_view algo)
@@ -106,6 +218,11 @@ bool Kleo::DeVSCompliance::allSubkeysAreCompliant(const GpgME::Key &key)
     if (!isActive()) {
         return true;
     }
+    return KeyComplianceCache::instance()->result(key, KeyComplianceCache::AllSubkeysAreCompliant, &Private::allSubkeysMeetRequirements);
+}
+
+bool Kleo::DeVSCompliance::Private::allSubkeysMeetRequirements(const GpgME::Key &key)
+{
     // there is at least one usable subkey
     const auto usableSubkeys = Kleo::count_if(key.subkeys(), [](const auto &sub) {
         return !sub.isExpired() && !sub.isRevoked();
@@ -136,9 +253,14 @@ bool Kleo::DeVSCompliance::keyIsCompliant(const GpgME::Key &key)
     if (!isActive()) {
         return true;
     }
+    return KeyComplianceCache::instance()->result(key, KeyComplianceCache::KeyIsCompliant, &Private::keyMeetsRequirements);
+}
+
+bool Kleo::DeVSCompliance::Private::keyMeetsRequirements(const GpgME::Key &key)
+{
     return (key.keyListMode() & GpgME::Validate) //
         && allUserIDsHaveFullValidity(key) //
-        && allSubkeysAreCompliant(key);
+        && allSubkeysMeetRequirements(key);
 }
 
 static const std::vector<std::string> initCompliantAlgorithms(GpgME::Protocol protocol)
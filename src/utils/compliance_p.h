@@ -0,0 +1,34 @@
+/*
+    This file is part of libkleopatra
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+namespace GpgME
+{
+class Key;
+}
+
+namespace Kleo::DeVSCompliance::Private
+{
+
+/**
+ * Returns true, if all usable subkeys of the key \p key are compliant with
+ * compliance mode "de-vs" like DeVSCompliance::allSubkeysAreCompliant(), but
+ * regardless of whether the compliance mode is active. Doesn't access the
+ * crypto config, so that it can be used in any thread.
+ */
+bool allSubkeysMeetRequirements(const GpgME::Key &key);
+
+/**
+ * Returns true, if the key \p key is compliant with compliance mode "de-vs"
+ * like DeVSCompliance::keyIsCompliant(), but regardless of whether the
+ * compliance mode is active. Doesn't access the crypto config, so that it
+ * can be used in any thread.
+ */
+bool keyMeetsRequirements(const GpgME::Key &key);
+
+}
@@ -13,18 +13,259 @@
 
 #include "compat.h"
 
+#include <libkleo_debug.h>
+
 #include <QGpgME/CryptoConfig>
+#if __has_include(<QGpgME/Debug>)
+#include <QGpgME/Debug>
+#endif
 #include <QGpgME/Protocol>
 
+#include <QMutex>
+#include <QThreadPool>
+
+#include <gpgme++/configuration.h>
+#include <gpgme++/error.h>
+
+#include <atomic>
+#include <optional>
+#include <string_view>
 #include <unordered_map>
 
 using namespace QGpgME;
 
+// incremented whenever the configuration may have changed; the preloaded index
+// is only used if it was loaded after the last change
+static std::atomic<quint64> cryptoConfigChangeCounter{0};
+// incremented whenever the values returned by the getCryptoConfig*Value functions
+// may have changed, i.e. also when a reloaded index is published
+static std::atomic<quint64> cryptoConfigGenerationCounter{0};
+static std::unordered_map<std::string, std::unordered_map<std::string, bool>> fakeCryptoConfigBoolValues;
 static std::unordered_map<std::string, std::unordered_map<std::string, int>> fakeCryptoConfigIntValues;
 static std::unordered_map<std::string, std::unordered_map<std::string, QString>> fakeCryptoConfigStringValues;
 
+namespace
+{
+template<typename T>
+std::optional<T> fakeValue(const std::unordered_map<std::string, std::unordered_map<std::string, T>> &fakeValues, const char *componentName, const char *entryName)
+{
+    if (fakeValues.empty()) {
+        return std::nullopt;
+    }
+    const auto componentIt = fakeValues.find(componentName);
+    if (componentIt == std::end(fakeValues)) {
+        return std::nullopt;
+    }
+    const auto entryIt = componentIt->second.find(entryName);
+    if (entryIt == std::end(componentIt->second)) {
+        return std::nullopt;
+    }
+    return entryIt->second;
+}
+
+std::vector<Kleo::Private::CryptoConfigValue> loadCryptoConfigWithGpgConf()
+{
+    using Kleo::Private::CryptoConfigValue;
+    using namespace GpgME::Configuration;
+
+    GpgME::Error err;
+    const std::vector<Component> components = Component::load(err);
+    if (err) {
+        qCWarning(LIBKLEO_LOG) << "Loading the crypto config failed:" << err;
+        return {};
+    }
+    std::vector<CryptoConfigValue> values;
+    for (const auto &component : components) {
+        for (const auto &option : component.options()) {
+            CryptoConfigValue value{component.name(), option.name()};
+            if (!option.isList()) {
+                // the same mapping of types as used by QGpgME::CryptoConfigEntry::argType()
+                const Argument argument = option.currentValue();
+                switch (option.alternateType()) {
+                case NoType:
+                    value.type = CryptoConfigValue::Bool;
+                    value.boolValue = argument.boolValue();
+                    break;
+                case IntegerType:
+                    value.type = CryptoConfigValue::Int;
+                    value.intValue = argument.intValue();
+                    break;
+                case StringType:
+                case KeyFingerprintType:
+                case PublicKeyType:
+                case SecretKeyType:
+                case AliasListType:
+                    value.type = CryptoConfigValue::String;
+                    value.stringValue = QString::fromUtf8(argument.stringValue());
+                    break;
+                default:
+                    break;
+                }
+            }
+            values.push_back(std::move(value));
+        }
+    }
+    return values;
+}
+
+struct StringHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view s) const noexcept
+    {
+        return std::hash<std::string_view>{}(s);
+    }
+};
+
+class CryptoConfigIndex
+{
+public:
+    enum LookupResult {
+        NotLoaded,
+        NotFound,
+        Found,
+    };
+
+    static CryptoConfigIndex *instance()
+    {
+        static auto *self = new CryptoConfigIndex();
+        return self;
+    }
+
+    bool isLoaded() const
+    {
+        QMutexLocker locker{&mMutex};
+        return isCurrent();
+    }
+
+    LookupResult lookup(const char *componentName, const char *entryName, Kleo::Private::CryptoConfigValue &value)
+    {
+        QMutexLocker locker{&mMutex};
+        if (!isCurrent()) {
+            if (!mLoaded || !mPreloadRequested) {
+                return NotLoaded;
+            }
+            // the configuration changed; answer from the previous index until the
+            // reloaded index is complete instead of blocking on QGpgME::cryptoConfig()
+            startLoadingLocked();
+        }
+        // heterogeneous lookup; no temporary strings are created
+        const auto componentIt = mComponents.find(std::string_view{componentName});
+        if (componentIt == mComponents.end()) {
+            return NotFound;
+        }
+        const auto entryIt = componentIt->second.find(std::string_view{entryName});
+        if (entryIt == componentIt->second.end()) {
+            return NotFound;
+        }
+        value = entryIt->second;
+        return Found;
+    }
+
+    void startLoading()
+    {
+        QMutexLocker locker{&mMutex};
+        mPreloadRequested = true;
+        startLoadingLocked();
+    }
+
+    // loads the configuration again after it changed if it was preloaded before
+    void reloadIfPreloaded()
+    {
+        QMutexLocker locker{&mMutex};
+        if (mPreloadRequested) {
+            startLoadingLocked();
+        }
+    }
+
+    // must be called with locked mutex
+    void startLoadingLocked()
+    {
+        if (mLoading || isCurrent()) {
+            return;
+        }
+        mLoading = true;
+        const quint64 generation = cryptoConfigChangeCounter.load(std::memory_order_acquire);
+        const Kleo::Private::CryptoConfigLoader loader = mLoader ? mLoader : loadCryptoConfigWithGpgConf;
+        QThreadPool::globalInstance()->start([this, generation, loader]() {
+            load(generation, loader);
+        });
+    }
+
+    void setLoader(const Kleo::Private::CryptoConfigLoader &loader)
+    {
+        QMutexLocker locker{&mMutex};
+        mLoader = loader;
+        mLoaded = false;
+        mPreloadRequested = false;
+        mComponents.clear();
+    }
+
+private:
+    using EntryMap = std::unordered_map<std::string, Kleo::Private::CryptoConfigValue, StringHash, std::equal_to<>>;
+    using ComponentMap = std::unordered_map<std::string, EntryMap, StringHash, std::equal_to<>>;
+
+    // must be called with locked mutex
+    bool isCurrent() const
+    {
+        return mLoaded && mGeneration == cryptoConfigChangeCounter.load(std::memory_order_acquire);
+    }
+
+    void load(quint64 generation, const Kleo::Private::CryptoConfigLoader &loader)
+    {
+        ComponentMap components;
+        for (auto &value : loader()) {
+            auto &entries = components[value.componentName];
+            const std::string entryName = value.entryName;
+            entries.insert_or_assign(entryName, std::move(value));
+        }
+
+        bool outdated;
+        {
+            QMutexLocker locker{&mMutex};
+            mLoading = false;
+            outdated = generation != cryptoConfigChangeCounter.load(std::memory_order_acquire);
+            if (!outdated) {
+                mComponents.swap(components);
+                mGeneration = generation;
+                mLoaded = true;
+                // values derived from the configuration while the index was
+                // loaded came from QGpgME::cryptoConfig(); they may differ
+                ++cryptoConfigGenerationCounter;
+            }
+        }
+        if (outdated) {
+            qCDebug(LIBKLEO_LOG) << "The crypto config changed while it was loaded. Loading it again.";
+            reloadIfPreloaded();
+        }
+    }
+
+    mutable QMutex mMutex;
+    ComponentMap mComponents;
+    quint64 mGeneration = 0;
+    bool mLoaded = false;
+    bool mLoading = false;
+    bool mPreloadRequested = false;
+    Kleo::Private::CryptoConfigLoader mLoader;
+};
+}
+
 bool Kleo::getCryptoConfigBoolValue(const char *componentName, const char *entryName)
 {
+    if (const auto fake = fakeValue(fakeCryptoConfigBoolValues, componentName, entryName)) {
+        return *fake;
+    }
+
+    Private::CryptoConfigValue value;
+    switch (CryptoConfigIndex::instance()->lookup(componentName, entryName, value)) {
+    case CryptoConfigIndex::Found:
+        return value.type == Private::CryptoConfigValue::Bool && value.boolValue;
+    case CryptoConfigIndex::NotFound:
+        return false;
+    case CryptoConfigIndex::NotLoaded:
+        CryptoConfigIndex::instance()->reloadIfPreloaded();
+        break;
+    }
+
     const CryptoConfig *const config = cryptoConfig();
     if (!config) {
         return false;
@@ -38,14 +279,19 @@ bool Kleo::getCryptoConfigBoolValue(const char *componentName, const char *entry
 
 int Kleo::getCryptoConfigIntValue(const char *componentName, const char *entryName, int defaultValue)
 {
-    if (!fakeCryptoConfigIntValues.empty()) {
-        const auto componentIt = fakeCryptoConfigIntValues.find(componentName);
-        if (componentIt != std::end(fakeCryptoConfigIntValues)) {
-            const auto entryIt = componentIt->second.find(entryName);
-            if (entryIt != std::end(componentIt->second)) {
-                return entryIt->second;
-            }
-        }
+    if (const auto fake = fakeValue(fakeCryptoConfigIntValues, componentName, entryName)) {
+        return *fake;
+    }
+
+    Private::CryptoConfigValue value;
+    switch (CryptoConfigIndex::instance()->lookup(componentName, entryName, value)) {
+    case CryptoConfigIndex::Found:
+        return value.type == Private::CryptoConfigValue::Int ? value.intValue : defaultValue;
+    case CryptoConfigIndex::NotFound:
+        return defaultValue;
+    case CryptoConfigIndex::NotLoaded:
+        CryptoConfigIndex::instance()->reloadIfPreloaded();
+        break;
     }
 
     const CryptoConfig *const config = cryptoConfig();
@@ -61,14 +307,19 @@ int Kleo::getCryptoConfigIntValue(const char *componentName, const char *entryNa
 
 QString Kleo::getCryptoConfigStringValue(const char *componentName, const char *entryName)
 {
-    if (!fakeCryptoConfigStringValues.empty()) {
-        const auto componentIt = fakeCryptoConfigStringValues.find(componentName);
-        if (componentIt != std::end(fakeCryptoConfigStringValues)) {
-            const auto entryIt = componentIt->second.find(entryName);
-            if (entryIt != std::end(componentIt->second)) {
-                return entryIt->second;
-            }
-        }
+    if (const auto fake = fakeValue(fakeCryptoConfigStringValues, componentName, entryName)) {
+        return *fake;
+    }
+
+    Private::CryptoConfigValue value;
+    switch (CryptoConfigIndex::instance()->lookup(componentName, entryName, value)) {
+    case CryptoConfigIndex::Found:
+        return value.type == Private::CryptoConfigValue::String ? value.stringValue : QString{};
+    case CryptoConfigIndex::NotFound:
+        return {};
+    case CryptoConfigIndex::NotLoaded:
+        CryptoConfigIndex::instance()->reloadIfPreloaded();
+        break;
     }
 
     const CryptoConfig *const config = cryptoConfig();
@@ -95,9 +346,108 @@ QList<QUrl> Kleo::getCryptoConfigUrlList(const char *componentName, const char *
     return {};
 }
 
+void Kleo::preloadCryptoConfig()
+{
+    CryptoConfigIndex::instance()->startLoading();
+}
+
+bool Kleo::cryptoConfigIsLoaded()
+{
+    return CryptoConfigIndex::instance()->isLoaded();
+}
+
+bool Kleo::peekCryptoConfigBoolValue(const char *componentName, const char *entryName, bool defaultValue)
+{
+    if (const auto fake = fakeValue(fakeCryptoConfigBoolValues, componentName, entryName)) {
+        return *fake;
+    }
+    Private::CryptoConfigValue value;
+    switch (CryptoConfigIndex::instance()->lookup(componentName, entryName, value)) {
+    case CryptoConfigIndex::Found:
+        return value.type == Private::CryptoConfigValue::Bool ? value.boolValue : defaultValue;
+    case CryptoConfigIndex::NotFound:
+        return defaultValue;
+    case CryptoConfigIndex::NotLoaded:
+        break;
+    }
+    preloadCryptoConfig();
+    return defaultValue;
+}
+
+int Kleo::peekCryptoConfigIntValue(const char *componentName, const char *entryName, int defaultValue)
+{
+    if (const auto fake = fakeValue(fakeCryptoConfigIntValues, componentName, entryName)) {
+        return *fake;
+    }
+    Private::CryptoConfigValue value;
+    switch (CryptoConfigIndex::instance()->lookup(componentName, entryName, value)) {
+    case CryptoConfigIndex::Found:
+        return value.type == Private::CryptoConfigValue::Int ? value.intValue : defaultValue;
+    case CryptoConfigIndex::NotFound:
+        return defaultValue;
+    case CryptoConfigIndex::NotLoaded:
+        break;
+    }
+    preloadCryptoConfig();
+    return defaultValue;
+}
+
+QString Kleo::peekCryptoConfigStringValue(const char *componentName, const char *entryName, const QString &defaultValue)
+{
+    if (const auto fake = fakeValue(fakeCryptoConfigStringValues, componentName, entryName)) {
+        return *fake;
+    }
+    Private::CryptoConfigValue value;
+    switch (CryptoConfigIndex::instance()->lookup(componentName, entryName, value)) {
+    case CryptoConfigIndex::Found:
+        return value.type == Private::CryptoConfigValue::String ? value.stringValue : defaultValue;
+    case CryptoConfigIndex::NotFound:
+        return defaultValue;
+    case CryptoConfigIndex::NotLoaded:
+        break;
+    }
+    preloadCryptoConfig();
+    return defaultValue;
+}
+
+void Kleo::Private::cryptoConfigChanged()
+{
+    ++cryptoConfigChangeCounter;
+    ++cryptoConfigGenerationCounter;
+}
+
+quint64 Kleo::Private::cryptoConfigGeneration()
+{
+    return cryptoConfigGenerationCounter.load(std::memory_order_acquire);
+}
+
+void Kleo::Private::setCryptoConfigLoader(const CryptoConfigLoader &loader)
+{
+    CryptoConfigIndex::instance()->setLoader(loader);
+    // a load that is in progress uses the old loader; make sure that its result is discarded
+    cryptoConfigChanged();
+}
+
+void Kleo::Private::setFakeCryptoConfigBoolValue(const std::string &componentName, const std::string &entryName, bool fakeValue)
+{
+    fakeCryptoConfigBoolValues[componentName][entryName] = fakeValue;
+    cryptoConfigChanged();
+}
+
+void Kleo::Private::clearFakeCryptoConfigBoolValue(const std::string &componentName, const std::string &entryName)
+{
+    auto &entryMap = fakeCryptoConfigBoolValues[componentName];
+    entryMap.erase(entryName);
+    if (entryMap.empty()) {
+        fakeCryptoConfigBoolValues.erase(componentName);
+    }
+    cryptoConfigChanged();
+}
+
 void Kleo::Private::setFakeCryptoConfigIntValue(const std::string &componentName, const std::string &entryName, int fakeValue)
 {
     fakeCryptoConfigIntValues[componentName][entryName] = fakeValue;
+    cryptoConfigChanged();
 }
 
 void Kleo::Private::clearFakeCryptoConfigIntValue(const std::string &componentName, const std::string &entryName)
@@ -107,11 +457,13 @@ void Kleo::Private::clearFakeCryptoConfigIntValue(const std::string &componentNa
     if (entryMap.empty()) {
         fakeCryptoConfigIntValues.erase(componentName);
     }
+    cryptoConfigChanged();
 }
 
 void Kleo::Private::setFakeCryptoConfigStringValue(const std::string &componentName, const std::string &entryName, const QString &fakeValue)
 {
     fakeCryptoConfigStringValues[componentName][entryName] = fakeValue;
+    cryptoConfigChanged();
 }
 
 void Kleo::Private::clearFakeCryptoConfigStringValue(const std::string &componentName, const std::string &entryName)
@@ -121,4 +473,5 @@ void Kleo::Private::clearFakeCryptoConfigStringValue(const std::string &componen
     if (entryMap.empty()) {
         fakeCryptoConfigStringValues.erase(componentName);
     }
+    cryptoConfigChanged();
 }
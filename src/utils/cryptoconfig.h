@@ -11,8 +11,8 @@
 #include "kleo_export.h"
 
 #include <QList>
+#include <QString>
 
-class QString;
 class QUrl;
 
 namespace Kleo
@@ -32,4 +32,38 @@ KLEO_EXPORT QString getCryptoConfigStringValue(const char *componentName, const
 
 KLEO_EXPORT QList<QUrl> getCryptoConfigUrlList(const char *componentName, const char *entryName);
 
+/**
+ * Starts reading the configuration of all GnuPG components with gpgconf in a
+ * background thread and builds an index of the values of the options. Once
+ * the index is complete, the getCryptoConfig*Value functions use it instead of
+ * QGpgME::cryptoConfig() (which runs gpgconf synchronously when it's used for
+ * the first time). Call this early, e.g. at application startup.
+ *
+ * Does nothing if the configuration is already loaded or being loaded.
+ *
+ * If the configuration changes after it was preloaded, then it's loaded again
+ * in the background. Until the reloaded index is complete, the values of the
+ * previously loaded index are returned.
+ */
+KLEO_EXPORT void preloadCryptoConfig();
+
+/**
+ * Returns \c true if the configuration was preloaded and hasn't changed since,
+ * i.e. if the values of the options are available without blocking and are
+ * up-to-date.
+ */
+KLEO_EXPORT bool cryptoConfigIsLoaded();
+
+/**
+ * Non-blocking variants of getCryptoConfigBoolValue, getCryptoConfigIntValue,
+ * and getCryptoConfigStringValue. They return the value of option \a entryName
+ * of component \a componentName if the configuration has been preloaded
+ * (possibly before the last change of the configuration, see
+ * preloadCryptoConfig()). Otherwise, they return \a defaultValue and start
+ * loading the configuration in the background.
+ */
+KLEO_EXPORT bool peekCryptoConfigBoolValue(const char *componentName, const char *entryName, bool defaultValue = false);
+KLEO_EXPORT int peekCryptoConfigIntValue(const char *componentName, const char *entryName, int defaultValue);
+KLEO_EXPORT QString peekCryptoConfigStringValue(const char *componentName, const char *entryName, const QString &defaultValue = {});
+
 }
@@ -8,9 +8,11 @@
 
 #pragma once
 
-#include <string>
+#include <QString>
 
-class QString;
+#include <functional>
+#include <string>
+#include <vector>
 
 namespace Kleo
 {
@@ -18,12 +20,68 @@ namespace Kleo
 namespace Private
 {
 
+void setFakeCryptoConfigBoolValue(const std::string &componentName, const std::string &entryName, bool fakeValue);
+void clearFakeCryptoConfigBoolValue(const std::string &componentName, const std::string &entryName);
+
 void setFakeCryptoConfigIntValue(const std::string &componentName, const std::string &entryName, int fakeValue);
 void clearFakeCryptoConfigIntValue(const std::string &componentName, const std::string &entryName);
 
 void setFakeCryptoConfigStringValue(const std::string &componentName, const std::string &entryName, const QString &fakeValue);
 void clearFakeCryptoConfigStringValue(const std::string &componentName, const std::string &entryName);
 
+/**
+ * Tells libkleo that the configuration of GnuPG may have changed, e.g. after
+ * the crypto config was saved or a configuration file was modified. Values
+ * which are derived from the configuration and which are cached (like the
+ * state of the compliance mode or the preloaded configuration) are determined
+ * again when they are needed the next time.
+ *
+ * Note that this doesn't clear QGpgME::cryptoConfig() because its entries may
+ * still be in use, e.g. by an open CryptoConfigModule. Modifications made
+ * outside of it are seen via the preloaded configuration (see
+ * Kleo::preloadCryptoConfig()).
+ */
+void cryptoConfigChanged();
+
+/**
+ * Returns a counter which is incremented whenever the values returned by the
+ * getCryptoConfig*Value functions may have changed, i.e. when
+ * cryptoConfigChanged() is called and when a (re)loaded preloaded
+ * configuration becomes available. Cached values derived from the
+ * configuration are valid as long as the counter doesn't change.
+ * This function is thread-safe.
+ */
+quint64 cryptoConfigGeneration();
+
+/**
+ * The value of an option as it's stored in the index of the preloaded
+ * configuration. Only the types supported by the getCryptoConfig*Value
+ * functions are stored.
+ */
+struct CryptoConfigValue {
+    enum Type {
+        Other,
+        Bool, // a scalar option without argument
+        Int, // a scalar option with signed integer argument
+        String, // a scalar option with string argument
+    };
+    std::string componentName;
+    std::string entryName;
+    Type type = Other;
+    bool boolValue = false;
+    int intValue = 0;
+    QString stringValue;
+};
+
+using CryptoConfigLoader = std::function<std::vector<CryptoConfigValue>()>;
+
+/**
+ * Replaces the function which reads the configuration with gpgconf when the
+ * configuration is preloaded. The function is called in a background thread.
+ * Pass an empty function to use gpgconf again. Used by the tests.
+ */
+void setCryptoConfigLoader(const CryptoConfigLoader &loader);
+
 }
 
 }
@@ -0,0 +1,110 @@
+/*
+    This file is part of libkleopatra, the KDE keymanagement library
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-libkleo.h>
+
+#include "dncache_p.h"
+
+#include <libkleo/dnattributes.h>
+
+#include <QGpgME/DN>
+
+#include <QByteArray>
+#include <QMutex>
+
+#include <list>
+#include <unordered_map>
+
+using namespace Kleo;
+
+namespace
+{
+// the number of cached DNs; enough for the certificates of a typical key list
+static const std::size_t maximumCacheSize = 4096;
+
+class Cache
+{
+public:
+    static Cache *instance()
+    {
+        static Cache *self = new Cache();
+        return self;
+    }
+
+    DNCache::Entry lookup(const QByteArray &utf8DN)
+    {
+        quint64 generation;
+        {
+            QMutexLocker locker{&mMutex};
+            const auto it = mIndex.find(utf8DN);
+            if (it != mIndex.end()) {
+                // move the entry to the front of the LRU list
+                mEntries.splice(mEntries.begin(), mEntries, it->second);
+                return it->second->second;
+            }
+            generation = mGeneration;
+        }
+
+        // parse the DN without holding the lock
+        const DNCache::Entry entry = parse(utf8DN);
+
+        QMutexLocker locker{&mMutex};
+        if (generation != mGeneration) {
+            // the attribute order was changed while we were parsing; don't cache the stale result
+            return entry;
+        }
+        if (mIndex.find(utf8DN) == mIndex.end()) {
+            mEntries.emplace_front(utf8DN, entry);
+            mIndex.emplace(utf8DN, mEntries.begin());
+            if (mEntries.size() > maximumCacheSize) {
+                mIndex.erase(mEntries.back().first);
+                mEntries.pop_back();
+            }
+        }
+        return entry;
+    }
+
+    void invalidate()
+    {
+        QMutexLocker locker{&mMutex};
+        ++mGeneration;
+        mIndex.clear();
+        mEntries.clear();
+    }
+
+private:
+    static DNCache::Entry parse(const QByteArray &utf8DN)
+    {
+        QGpgME::DN dn{utf8DN.constData()};
+        DNCache::Entry entry;
+        entry.commonName = dn[QStringLiteral("CN")].trimmed();
+        entry.email = dn[QStringLiteral("EMAIL")].trimmed();
+        dn.setAttributeOrder(DNAttributes::order());
+        entry.prettyDN = dn.prettyDN();
+        return entry;
+    }
+
+    QMutex mMutex;
+    quint64 mGeneration = 0;
+    // the cached entries with the most recently used entry first
+    std::list<std::pair<QByteArray, DNCache::Entry>> mEntries;
+    std::unordered_map<QByteArray, std::list<std::pair<QByteArray, DNCache::Entry>>::iterator> mIndex;
+};
+}
+
+DNCache::Entry DNCache::lookup(const char *utf8DN)
+{
+    if (!utf8DN || !*utf8DN) {
+        return {};
+    }
+    return Cache::instance()->lookup(QByteArray{utf8DN});
+}
+
+void DNCache::invalidate()
+{
+    Cache::instance()->invalidate();
+}
@@ -0,0 +1,44 @@
+/*
+    This file is part of libkleopatra, the KDE keymanagement library
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QString>
+
+namespace Kleo
+{
+
+/**
+ * Process-wide cache of parsed distinguished names.
+ *
+ * The same subject and issuer DNs are formatted over and over again, e.g.
+ * for the rows and tooltips of key lists. The cache keeps the results for
+ * the most recently used DNs, so that they don't have to be parsed again.
+ */
+namespace DNCache
+{
+
+struct Entry {
+    QString prettyDN; // the DN reordered according to DNAttributes::order()
+    QString commonName; // the trimmed value of the CN attribute
+    QString email; // the trimmed value of the EMAIL attribute
+};
+
+/**
+ * Returns the parsed and formatted forms of the UTF-8 encoded DN @a utf8DN.
+ * This function is thread-safe.
+ */
+Entry lookup(const char *utf8DN);
+
+/**
+ * Drops all cached entries. Called when the attribute order is changed.
+ */
+void invalidate();
+
+}
+
+}
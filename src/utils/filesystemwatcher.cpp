@@ -15,16 +15,67 @@
 
 #include <libkleo_debug.h>
 
+#include <QDateTime>
 #include <QDir>
 #include <QFileSystemWatcher>
 #include <QRegularExpression>
 #include <QString>
 #include <QTimer>
 
+#include <map>
+#include <optional>
 #include <set>
 
+#ifndef Q_OS_WIN
+#include <sys/stat.h>
+#endif
+
 using namespace Kleo;
 
+namespace
+{
+// directory change notifications arriving within this interval are handled by a single scan of the directory
+static const int directoryScanDelay = 50;
+
+struct FileState {
+    QDateTime lastModified;
+    qint64 size = 0;
+    quint64 inode = 0;
+
+    bool operator==(const FileState &other) const = default;
+};
+}
+
+// returns the state of a regular file or std::nullopt if there is no regular file at @p path
+static std::optional<FileState> file_state(const QString &path)
+{
+    const QFileInfo fi{path};
+    if (!fi.isFile()) {
+        return std::nullopt;
+    }
+    FileState state{fi.lastModified(), fi.size(), 0};
+#ifndef Q_OS_WIN
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) == 0) {
+        state.inode = st.st_ino;
+    }
+#endif
+    return state;
+}
+
+// combines the wildcard patterns into a single case-insensitive regular expression
+static QRegularExpression compile_patterns(const QStringList &patterns)
+{
+    QStringList regExps;
+    regExps.reserve(patterns.size());
+    for (const QString &pattern : patterns) {
+        regExps.push_back(QRegularExpression::wildcardToRegularExpression(pattern));
+    }
+    QRegularExpression regExp{regExps.join(QLatin1Char('|')), QRegularExpression::CaseInsensitiveOption};
+    regExp.optimize();
+    return regExp;
+}
+
 class FileSystemWatcher::Private
 {
     FileSystemWatcher *const q;
@@ -38,17 +89,38 @@ public:
 
     void onFileChanged(const QString &path);
     void onDirectoryChanged(const QString &path);
+    void scanDirectory(const QString &path);
+    void scanDirectoryForChangedFiles(const QString &path);
+    void scanPendingDirectories();
     void handleTimer();
     void onTimeout();
 
     void connectWatcher();
+    void watchAgain(const QString &path);
+    void updateFileStates(const QStringList &paths);
+
+    bool isBlacklisted(const QString &file) const
+    {
+        return !m_blacklist.empty() && m_blacklistRegExp.match(file).hasMatch();
+    }
+    bool isWhitelisted(const QString &file) const
+    {
+        return m_whitelist.empty() || m_whitelistRegExp.match(file).hasMatch();
+    }
+    QStringList listDirAbsolute(const QString &path) const;
+    QStringList resolve(const QStringList &paths) const;
 
     QFileSystemWatcher *m_watcher = nullptr;
     QTimer m_timer;
+    QTimer m_scanTimer;
     std::set<QString> m_seenPaths;
     std::set<QString> m_cachedDirectories;
     std::set<QString> m_cachedFiles;
+    std::set<QString> m_pendingDirectories;
     QStringList m_paths, m_blacklist, m_whitelist;
+    QRegularExpression m_blacklistRegExp, m_whitelistRegExp;
+    bool m_trackFileStates = false;
+    std::map<QString, FileState> m_fileStates;
 };
 
 FileSystemWatcher::Private::Private(FileSystemWatcher *qq, const QStringList &paths)
@@ -60,40 +132,41 @@ FileSystemWatcher::Private::Private(FileSystemWatcher *qq, const QStringList &pa
     connect(&m_timer, &QTimer::timeout, q, [this]() {
         onTimeout();
     });
-}
-
-static bool is_matching(const QString &file, const QStringList &list)
-{
-    for (const QString &entry : list) {
-        if (QRegularExpression::fromWildcard(entry, Qt::CaseInsensitive).match(file).hasMatch()) {
-            return true;
-        }
-    }
-    return false;
-}
-
-static bool is_blacklisted(const QString &file, const QStringList &blacklist)
-{
-    return is_matching(file, blacklist);
-}
-
-static bool is_whitelisted(const QString &file, const QStringList &whitelist)
-{
-    if (whitelist.empty()) {
-        return true; // special case
-    }
-    return is_matching(file, whitelist);
+    m_scanTimer.setSingleShot(true);
+    m_scanTimer.setInterval(directoryScanDelay);
+    connect(&m_scanTimer, &QTimer::timeout, q, [this]() {
+        scanPendingDirectories();
+    });
 }
 
 void FileSystemWatcher::Private::onFileChanged(const QString &path)
 {
     const QFileInfo fi(path);
-    if (is_blacklisted(fi.fileName(), m_blacklist)) {
+    if (isBlacklisted(fi.fileName())) {
         return;
     }
-    if (!is_whitelisted(fi.fileName(), m_whitelist)) {
+    if (!isWhitelisted(fi.fileName())) {
         return;
     }
+    if (m_trackFileStates) {
+        const auto state = file_state(path);
+        const auto it = m_fileStates.find(path);
+        if (state && it != m_fileStates.end()) {
+            if (it->second == *state) {
+                qCDebug(LIBKLEO_LOG) << q << "- ignoring notification for unchanged file:" << path;
+                return;
+            }
+            if (it->second.inode != state->inode) {
+                // the file was replaced, e.g. by renaming a temporary file; the watch of the old file is gone
+                watchAgain(path);
+            }
+        }
+        if (state) {
+            m_fileStates.insert_or_assign(path, *state);
+        } else if (it != m_fileStates.end()) {
+            m_fileStates.erase(it);
+        }
+    }
     qCDebug(LIBKLEO_LOG) << q << "- file changed:" << path;
     if (fi.exists()) {
         m_seenPaths.insert(path);
@@ -104,18 +177,13 @@ void FileSystemWatcher::Private::onFileChanged(const QString &path)
     handleTimer();
 }
 
-static QStringList list_dir_absolute(const QString &path, const QStringList &blacklist, const QStringList &whitelist)
+QStringList FileSystemWatcher::Private::listDirAbsolute(const QString &path) const
 {
     QDir dir(path);
     QStringList entries = dir.entryList(QDir::AllEntries | QDir::NoDotAndDotDot);
-    QStringList::iterator end = std::remove_if(entries.begin(), entries.end(), [&blacklist](const QString &entry) {
-        return is_blacklisted(entry, blacklist);
+    const QStringList::iterator end = std::remove_if(entries.begin(), entries.end(), [this](const QString &entry) {
+        return isBlacklisted(entry) || !isWhitelisted(entry);
     });
-    if (!whitelist.empty()) {
-        end = std::remove_if(entries.begin(), end, [&whitelist](const QString &entry) {
-            return !is_whitelisted(entry, whitelist);
-        });
-    }
     entries.erase(end, entries.end());
     std::sort(entries.begin(), entries.end());
 
@@ -135,7 +203,33 @@ static QStringList find_new_files(const QStringList &current, const std::set<QSt
 
 void FileSystemWatcher::Private::onDirectoryChanged(const QString &path)
 {
-    const QStringList newFiles = find_new_files(list_dir_absolute(path, m_blacklist, m_whitelist), m_seenPaths);
+    if (!m_trackFileStates || m_timer.interval() == 0) {
+        scanDirectory(path);
+        return;
+    }
+    // coalesce bursts of notifications, e.g. caused by lock files and temporary files
+    m_pendingDirectories.insert(path);
+    if (!m_scanTimer.isActive()) {
+        m_scanTimer.start();
+    }
+}
+
+void FileSystemWatcher::Private::scanPendingDirectories()
+{
+    std::set<QString> dirs;
+    dirs.swap(m_pendingDirectories);
+    for (const QString &dir : std::as_const(dirs)) {
+        scanDirectory(dir);
+    }
+}
+
+void FileSystemWatcher::Private::scanDirectory(const QString &path)
+{
+    if (m_trackFileStates) {
+        scanDirectoryForChangedFiles(path);
+        return;
+    }
+    const QStringList newFiles = find_new_files(listDirAbsolute(path), m_seenPaths);
 
     if (newFiles.empty()) {
         return;
@@ -152,6 +246,79 @@ void FileSystemWatcher::Private::onDirectoryChanged(const QString &path)
     handleTimer();
 }
 
+void FileSystemWatcher::Private::scanDirectoryForChangedFiles(const QString &path)
+{
+    const QStringList entries = listDirAbsolute(path);
+    bool filesAddedOrRemoved = false;
+    bool filesChanged = false;
+
+    QStringList newFiles;
+    for (const QString &entry : entries) {
+        if (!m_seenPaths.contains(entry)) {
+            qCDebug(LIBKLEO_LOG) << q << "- found new file" << entry;
+            newFiles.push_back(entry);
+            continue;
+        }
+        const auto state = file_state(entry);
+        const auto it = m_fileStates.find(entry);
+        if (!state || it == m_fileStates.end() || it->second == *state) {
+            continue;
+        }
+        qCDebug(LIBKLEO_LOG) << q << "- found changed file" << entry;
+        if (it->second.inode != state->inode) {
+            watchAgain(entry);
+        }
+        it->second = *state;
+        m_cachedFiles.insert(entry);
+        filesChanged = true;
+    }
+
+    // forget the files in this directory which do not exist anymore
+    const QString prefix = path.endsWith(QLatin1Char('/')) ? path : path + QLatin1Char('/');
+    for (auto it = m_fileStates.lower_bound(prefix); it != m_fileStates.end() && it->first.startsWith(prefix);) {
+        if (it->first.indexOf(QLatin1Char('/'), prefix.size()) == -1 && !std::binary_search(entries.begin(), entries.end(), it->first)) {
+            qCDebug(LIBKLEO_LOG) << q << "- file was removed" << it->first;
+            m_seenPaths.erase(it->first);
+            m_cachedFiles.insert(it->first);
+            filesAddedOrRemoved = true;
+            it = m_fileStates.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (!newFiles.empty()) {
+        m_cachedFiles.insert(newFiles.begin(), newFiles.end());
+        q->addPaths(newFiles);
+        filesAddedOrRemoved = true;
+    }
+
+    if (filesAddedOrRemoved) {
+        m_cachedDirectories.insert(path);
+    }
+    if (filesAddedOrRemoved || filesChanged) {
+        handleTimer();
+    }
+}
+
+void FileSystemWatcher::Private::watchAgain(const QString &path)
+{
+    if (!m_watcher) {
+        return;
+    }
+    m_watcher->removePath(path);
+    m_watcher->addPath(path);
+}
+
+void FileSystemWatcher::Private::updateFileStates(const QStringList &paths)
+{
+    for (const QString &path : paths) {
+        if (const auto state = file_state(path)) {
+            m_fileStates.insert_or_assign(path, *state);
+        }
+    }
+}
+
 void FileSystemWatcher::Private::onTimeout()
 {
     std::set<QString> dirs;
@@ -226,7 +393,7 @@ void FileSystemWatcher::setEnabled(bool enable)
             for (const auto &path : paths) {
                 if (QFileInfo{path}.isDir()) {
                     qCDebug(LIBKLEO_LOG) << this << "- checking for new files in" << path;
-                    d->onDirectoryChanged(path);
+                    d->scanDirectory(path);
                 }
             }
         }
@@ -235,6 +402,8 @@ void FileSystemWatcher::setEnabled(bool enable)
         Q_ASSERT(d->m_watcher);
         delete d->m_watcher;
         d->m_watcher = nullptr;
+        d->m_scanTimer.stop();
+        d->m_pendingDirectories.clear();
     }
 }
 
@@ -261,13 +430,14 @@ int FileSystemWatcher::delay() const
 void FileSystemWatcher::blacklistFiles(const QStringList &paths)
 {
     d->m_blacklist += paths;
+    d->m_blacklistRegExp = compile_patterns(d->m_blacklist);
     QStringList blacklisted;
     d->m_paths.erase(kdtools::separate_if(d->m_paths.begin(),
                                           d->m_paths.end(),
                                           std::back_inserter(blacklisted),
                                           d->m_paths.begin(),
                                           [this](const QString &path) {
-                                              return is_blacklisted(path, d->m_blacklist);
+                                              return d->isBlacklisted(path);
                                           })
                          .second,
                      d->m_paths.end());
@@ -279,12 +449,30 @@ void FileSystemWatcher::blacklistFiles(const QStringList &paths)
 void FileSystemWatcher::whitelistFiles(const QStringList &patterns)
 {
     d->m_whitelist += patterns;
+    d->m_whitelistRegExp = compile_patterns(d->m_whitelist);
     // ### would be nice to add newly-matching paths here right away,
     // ### but it's not as simple as blacklisting above, esp. since we
     // ### don't want to subject addPath()'ed paths to whitelisting.
 }
 
-static QStringList resolve(const QStringList &paths, const QStringList &blacklist, const QStringList &whitelist)
+void FileSystemWatcher::setFileStateTracking(bool enable)
+{
+    if (d->m_trackFileStates == enable) {
+        return;
+    }
+    d->m_trackFileStates = enable;
+    d->m_fileStates.clear();
+    if (enable) {
+        d->updateFileStates(d->m_paths);
+    }
+}
+
+bool FileSystemWatcher::fileStateTracking() const
+{
+    return d->m_trackFileStates;
+}
+
+QStringList FileSystemWatcher::Private::resolve(const QStringList &paths) const
 {
     if (paths.empty()) {
         return QStringList();
@@ -292,10 +480,10 @@ static QStringList resolve(const QStringList &paths, const QStringList &blacklis
     QStringList result;
     for (const QString &path : paths) {
         if (QDir(path).exists()) {
-            result += list_dir_absolute(path, blacklist, whitelist);
+            result += listDirAbsolute(path);
         }
     }
-    return result + resolve(result, blacklist, whitelist);
+    return result + resolve(result);
 }
 
 void FileSystemWatcher::addPaths(const QStringList &paths)
@@ -303,12 +491,15 @@ void FileSystemWatcher::addPaths(const QStringList &paths)
     if (paths.empty()) {
         return;
     }
-    const QStringList newPaths = paths + resolve(paths, d->m_blacklist, d->m_whitelist);
+    const QStringList newPaths = paths + d->resolve(paths);
     for (const auto &path : newPaths) {
         qCDebug(LIBKLEO_LOG) << this << "- watching" << path;
     }
     d->m_paths += newPaths;
     d->m_seenPaths.insert(newPaths.begin(), newPaths.end());
+    if (d->m_trackFileStates) {
+        d->updateFileStates(newPaths);
+    }
     if (d->m_watcher && !newPaths.empty()) {
         d->m_watcher->addPaths(newPaths);
     }
@@ -326,6 +517,7 @@ void FileSystemWatcher::removePaths(const QStringList &paths)
     }
     for (const QString &i : paths) {
         d->m_paths.removeAll(i);
+        d->m_fileStates.erase(i);
     }
     if (d->m_watcher) {
         d->m_watcher->removePaths(paths);
@@ -55,6 +55,19 @@ public:
     void blacklistFiles(const QStringList &patterns);
     void whitelistFiles(const QStringList &patterns);
 
+    /**
+     * Enables or disables the tracking of the state (modification time, size,
+     * and inode) of the watched files. If enabled, then fileChanged() is only
+     * emitted if the state of a file changed (or the file was added or removed),
+     * files replaced by renaming another file over them are detected and
+     * watched again, and directoryChanged() is only emitted if files were added
+     * to or removed from a directory. Additionally, if a delay is set, then bursts
+     * of directory notifications (e.g. caused by lock files) are handled by a
+     * single scan of the directory. Disabled by default.
+     */
+    void setFileStateTracking(bool enable);
+    bool fileStateTracking() const;
+
     QStringList files() const;
     void removePaths(const QStringList &path);
     void removePath(const QString &path);
@@ -0,0 +1,91 @@
+/*
+    This file is part of libkleopatra, the KDE keymanagement library
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-libkleo.h>
+
+#include "fingerprint.h"
+
+#include <QByteArray>
+#include <QDebug>
+#include <QHashFunctions>
+#include <QString>
+
+#include <gpgme++/key.h>
+
+using namespace Kleo;
+
+namespace
+{
+constexpr char hexDigits[] = "0123456789ABCDEF";
+}
+
+Fingerprint Fingerprint::fromHex(const QString &hex)
+{
+    if (hex.size() != 2 * 20 && hex.size() != 2 * MaxSize) {
+        return {};
+    }
+    // a valid fingerprint consists only of Latin-1 characters; all other characters are mapped to '?'
+    const QByteArray latin1 = hex.toLatin1();
+    return fromHex(std::string_view{latin1.constData(), static_cast<std::size_t>(latin1.size())});
+}
+
+Fingerprint Fingerprint::fromKey(const GpgME::Key &key)
+{
+    return fromHex(key.primaryFingerprint());
+}
+
+Fingerprint Fingerprint::fromSubkey(const GpgME::Subkey &subkey)
+{
+    return fromHex(subkey.fingerprint());
+}
+
+std::string Fingerprint::toHex() const
+{
+    std::string hex;
+    hex.reserve(2 * mSize);
+    for (std::size_t i = 0; i < mSize; ++i) {
+        hex.push_back(hexDigits[mBytes[i] >> 4]);
+        hex.push_back(hexDigits[mBytes[i] & 0xF]);
+    }
+    return hex;
+}
+
+QString Fingerprint::toQString() const
+{
+    return QString::fromStdString(toHex());
+}
+
+std::size_t Fingerprint::hash() const noexcept
+{
+    // the bytes of a fingerprint are the output of a cryptographic hash function;
+    // therefore, the first bytes are a good enough hash value
+    std::size_t h = mSize;
+    std::memcpy(&h, mBytes.data(), std::min(sizeof(h), static_cast<std::size_t>(mSize)));
+    return h;
+}
+
+std::vector<Fingerprint> Kleo::toFingerprints(const QStringList &fingerprints)
+{
+    std::vector<Fingerprint> result;
+    result.reserve(fingerprints.size());
+    for (const auto &fpr : fingerprints) {
+        result.push_back(Fingerprint::fromHex(fpr));
+    }
+    return result;
+}
+
+std::size_t Kleo::qHash(const Fingerprint &fingerprint, std::size_t seed) noexcept
+{
+    return qHashBits(fingerprint.data(), fingerprint.size(), seed);
+}
+
+QDebug Kleo::operator<<(QDebug debug, const Fingerprint &fingerprint)
+{
+    const QDebugStateSaver saver(debug);
+    debug.nospace() << "Fingerprint(" << fingerprint.toHex().c_str() << ')';
+    return debug;
+}
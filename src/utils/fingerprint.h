@@ -0,0 +1,190 @@
+/*
+    This file is part of libkleopatra, the KDE keymanagement library
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "kleo_export.h"
+
+#include <QStringList>
+
+#include <algorithm>
+#include <array>
+#include <compare>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+class QDebug;
+
+namespace GpgME
+{
+class Key;
+class Subkey;
+}
+
+namespace Kleo
+{
+
+/**
+ * A fingerprint of an OpenPGP key or an X.509 certificate in binary form.
+ *
+ * Fingerprints are usually passed around as hex strings. Comparing hex strings
+ * requires a byte-wise (and often case-insensitive) comparison of 40 or 64
+ * characters. This class stores the fingerprint as 20 bytes (OpenPGP v4 keys
+ * and X.509 certificates) or as 32 bytes (OpenPGP v5/v6 keys) so that
+ * comparisons and hashing are cheap.
+ *
+ * The ordering is consistent with the ordering of upper-case hex strings, i.e.
+ * with the ordering of _detail::ByFingerprint for the fingerprints reported
+ * by gpgme.
+ */
+class KLEO_EXPORT Fingerprint
+{
+public:
+    static constexpr std::size_t MaxSize = 32;
+
+    constexpr Fingerprint() noexcept = default;
+
+    /**
+     * Parses the hex-encoded fingerprint @a hex. Upper-case and lower-case
+     * hex digits are accepted.
+     *
+     * Returns a null fingerprint if @a hex doesn't consist of exactly 40 or
+     * 64 hex digits.
+     */
+    static constexpr Fingerprint fromHex(std::string_view hex) noexcept
+    {
+        Fingerprint fpr;
+        if (hex.size() != 2 * 20 && hex.size() != 2 * MaxSize) {
+            return fpr;
+        }
+        for (std::size_t i = 0; i < hex.size(); i += 2) {
+            const int high = hexValue(hex[i]);
+            const int low = hexValue(hex[i + 1]);
+            if (high < 0 || low < 0) {
+                return {};
+            }
+            fpr.mBytes[i / 2] = static_cast<std::uint8_t>((high << 4) | low);
+        }
+        fpr.mSize = static_cast<std::uint8_t>(hex.size() / 2);
+        return fpr;
+    }
+
+    /**
+     * \overload
+     *
+     * Returns a null fingerprint if @a hex is a null pointer.
+     */
+    static Fingerprint fromHex(const char *hex) noexcept
+    {
+        return hex ? fromHex(std::string_view{hex}) : Fingerprint{};
+    }
+
+    static Fingerprint fromHex(const QString &hex);
+
+    /**
+     * Returns the fingerprint of the primary key of @a key.
+     */
+    static Fingerprint fromKey(const GpgME::Key &key);
+
+    /**
+     * Returns the fingerprint of @a subkey.
+     */
+    static Fingerprint fromSubkey(const GpgME::Subkey &subkey);
+
+    constexpr bool isNull() const noexcept
+    {
+        return mSize == 0;
+    }
+
+    /**
+     * Returns the number of bytes of the fingerprint, i.e. 0, 20, or 32.
+     */
+    constexpr std::size_t size() const noexcept
+    {
+        return mSize;
+    }
+
+    constexpr const std::uint8_t *data() const noexcept
+    {
+        return mBytes.data();
+    }
+
+    /**
+     * Returns the fingerprint as upper-case hex string (like gpgme does) or an
+     * empty string if the fingerprint is null.
+     */
+    std::string toHex() const;
+    QString toQString() const;
+
+    friend constexpr bool operator==(const Fingerprint &lhs, const Fingerprint &rhs) noexcept
+    {
+        // the unused bytes are always 0
+        return lhs.mSize == rhs.mSize && compareBytes(lhs, rhs, MaxSize) == 0;
+    }
+
+    friend constexpr std::strong_ordering operator<=>(const Fingerprint &lhs, const Fingerprint &rhs) noexcept
+    {
+        const int cmp = compareBytes(lhs, rhs, std::min(lhs.mSize, rhs.mSize));
+        if (cmp != 0) {
+            return cmp <=> 0;
+        }
+        return lhs.mSize <=> rhs.mSize;
+    }
+
+    std::size_t hash() const noexcept;
+
+private:
+    static constexpr int hexValue(char ch) noexcept
+    {
+        return (ch >= '0' && ch <= '9') ? ch - '0' //
+            : (ch >= 'A' && ch <= 'F')  ? ch - 'A' + 10
+            : (ch >= 'a' && ch <= 'f')  ? ch - 'a' + 10
+                                        : -1;
+    }
+
+    static constexpr int compareBytes(const Fingerprint &lhs, const Fingerprint &rhs, std::size_t n) noexcept
+    {
+        if (std::is_constant_evaluated()) {
+            for (std::size_t i = 0; i < n; ++i) {
+                if (lhs.mBytes[i] != rhs.mBytes[i]) {
+                    return lhs.mBytes[i] < rhs.mBytes[i] ? -1 : 1;
+                }
+            }
+            return 0;
+        }
+        return n ? std::memcmp(lhs.mBytes.data(), rhs.mBytes.data(), n) : 0;
+    }
+
+private:
+    std::array<std::uint8_t, MaxSize> mBytes{};
+    std::uint8_t mSize = 0;
+};
+
+/**
+ * Parses the hex-encoded @a fingerprints. Invalid fingerprints result in null
+ * fingerprints so that the result has the same size as @a fingerprints.
+ */
+KLEO_EXPORT std::vector<Fingerprint> toFingerprints(const QStringList &fingerprints);
+
+KLEO_EXPORT std::size_t qHash(const Fingerprint &fingerprint, std::size_t seed = 0) noexcept;
+
+KLEO_EXPORT QDebug operator<<(QDebug debug, const Fingerprint &fingerprint);
+
+}
+
+template<>
+struct std::hash<Kleo::Fingerprint> {
+    std::size_t operator()(const Kleo::Fingerprint &fingerprint) const noexcept
+    {
+        return fingerprint.hash();
+    }
+};
@@ -15,11 +15,11 @@
 #include "compat.h"
 #include "compliance.h"
 #include "cryptoconfig.h"
+#include "dncache_p.h"
 #include "gnupg.h"
 #include "keyhelpers.h"
 #include "systeminfo.h"
 
-#include <libkleo/dnattributes.h>
 #include <libkleo/keycache.h>
 #include <libkleo/keygroup.h>
 #include <libkleo/verification.h>
@@ -30,7 +30,6 @@
 #include <KLocalizedString>
 
 #include <QGpgME/CryptoConfig>
-#include <QGpgME/DN>
 #include <QGpgME/Protocol>
 
 #include <QDateTime>
@@ -157,13 +156,8 @@ QString Formatting::prettyName(int proto, const char *id, const char *name_, con
     }
 
     if (proto == GpgME::CMS) {
-        const QGpgME::DN subject(id);
-        const QString cn = subject[QStringLiteral("CN")].trimmed();
-        if (cn.isEmpty()) {
-            subject.setAttributeOrder(DNAttributes::order());
-            return subject.prettyDN();
-        }
-        return cn;
+        const auto subject = DNCache::lookup(id);
+        return subject.commonName.isEmpty() ? subject.prettyDN : subject.commonName;
     }
 
     return QString();
@@ -201,13 +195,8 @@ QString Formatting::prettyNameAndEMail(int proto, const QString &id, const QStri
     }
 
     if (proto == GpgME::CMS) {
-        const QGpgME::DN subject(id);
-        const QString cn = subject[QStringLiteral("CN")].trimmed();
-        if (cn.isEmpty()) {
-            subject.setAttributeOrder(DNAttributes::order());
-            return subject.prettyDN();
-        }
-        return cn;
+        const auto subject = DNCache::lookup(id.toUtf8().constData());
+        return subject.commonName.isEmpty() ? subject.prettyDN : subject.commonName;
     }
     return QString();
 }
@@ -301,15 +290,13 @@ QString Formatting::prettyEMail(const char *email_, const char *id)
     if (email_ && KEmailAddress::splitAddress(QString::fromUtf8(email_), name, email, comment) == KEmailAddress::AddressOk) {
         return email;
     } else {
-        return QGpgME::DN(id)[QStringLiteral("EMAIL")].trimmed();
+        return DNCache::lookup(id).email;
     }
 }
 
 QString Formatting::prettyDN(const char *utf8DN)
 {
-    QGpgME::DN dn{utf8DN};
-    dn.setAttributeOrder(DNAttributes::order());
-    return dn.prettyDN();
+    return DNCache::lookup(utf8DN).prettyDN;
 }
 
 //
@@ -1665,7 +1652,7 @@ QString Formatting::email(const GpgME::UserID &uid)
         if (id[0] == '<') {
             return stripAngleBrackets(id).toString();
         }
-        return QGpgME::DN(id)[QStringLiteral("EMAIL")].trimmed();
+        return DNCache::lookup(uid.id()).email;
     }
     return {};
 }
@@ -19,6 +19,8 @@
 #include "compat.h"
 #include "compliance.h"
 #include "cryptoconfig.h"
+#include "cryptoconfig_p.h"
+#include "gpgvverifier_p.h"
 #include "hex.h"
 
 #include <libkleo_debug.h>
@@ -34,6 +36,7 @@
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
+#include <QMutex>
 #include <QPointer>
 #include <QProcess>
 #include <QRegularExpression>
@@ -53,6 +56,8 @@
 
 #include <algorithm>
 #include <array>
+#include <map>
+#include <optional>
 
 using namespace GpgME;
 using namespace Qt::StringLiterals;
@@ -228,34 +233,96 @@ bool Kleo::versionIsAtLeast(const char *minimum, const char *actual)
     return !std::lexicographical_compare(std::begin(actual_version), std::end(actual_version), std::begin(minimum_version), std::end(minimum_version));
 }
 
-bool Kleo::engineIsVersion(int major, int minor, int patch, GpgME::Engine engine)
+namespace
 {
-    static QMap<Engine, std::array<int, 3>> cachedVersions;
-    const int required_version[] = {major, minor, patch};
-    // Gpgconf means spawning processes which is expensive on windows.
-    std::array<int, 3> actual_version;
-    if (!cachedVersions.contains(engine)) {
+// The versions of the GnuPG engines. The version of an engine is determined
+// once when it is needed for the first time, because querying it may spawn
+// a process (which is expensive on Windows), and is then kept until
+// refreshEngineCapabilities() is called.
+class EngineVersions
+{
+public:
+    static EngineVersions *instance()
+    {
+        static EngineVersions *self = new EngineVersions();
+        return self;
+    }
+
+    // Returns the version of the @p engine or std::nullopt if the engine is
+    // not available or if its version cannot be parsed.
+    std::optional<std::array<int, 3>> version(Engine engine)
+    {
+        quint64 generation;
+        {
+            QMutexLocker locker{&mMutex};
+            const auto it = mVersions.find(engine);
+            if (it != mVersions.end()) {
+                return it->second;
+            }
+            generation = mGeneration;
+        }
+
+        // query the version without holding the lock
+        const auto version = queryVersion(engine);
+
+        QMutexLocker locker{&mMutex};
+        if (generation == mGeneration) {
+            mVersions.insert_or_assign(engine, version);
+        }
+        return version;
+    }
+
+    void clear()
+    {
+        QMutexLocker locker{&mMutex};
+        ++mGeneration;
+        mVersions.clear();
+    }
+
+private:
+    static std::optional<std::array<int, 3>> queryVersion(Engine engine)
+    {
         const Error err = checkEngine(engine);
         if (err.code() == GPG_ERR_INV_ENGINE) {
             qCDebug(LIBKLEO_LOG) << "isVersion: invalid engine. '";
-            return false;
+            return std::nullopt;
         }
 
         const char *actual = GpgME::engineInfo(engine).version();
         bool ok;
-        actual_version = getVersionFromString(actual, ok);
+        const auto actual_version = getVersionFromString(actual, ok);
 
         qCDebug(LIBKLEO_LOG) << "Parsed" << actual << "as: " << actual_version[0] << '.' << actual_version[1] << '.' << actual_version[2] << '.';
         if (!ok) {
-            return false;
+            return std::nullopt;
         }
-        cachedVersions.insert(engine, actual_version);
-    } else {
-        actual_version = cachedVersions.value(engine);
+        return actual_version;
+    }
+
+private:
+    QMutex mMutex;
+    std::map<Engine, std::optional<std::array<int, 3>>> mVersions;
+    quint64 mGeneration = 0;
+};
+}
+
+bool Kleo::engineIsVersion(int major, int minor, int patch, GpgME::Engine engine)
+{
+    const int required_version[] = {major, minor, patch};
+    const auto actual_version = EngineVersions::instance()->version(engine);
+    if (!actual_version) {
+        return false;
     }
 
     // return ! ( actual_version < required_version )
-    return !std::lexicographical_compare(std::begin(actual_version), std::end(actual_version), std::begin(required_version), std::end(required_version));
+    return !std::lexicographical_compare(std::begin(*actual_version), std::end(*actual_version), std::begin(required_version), std::end(required_version));
+}
+
+void Kleo::refreshEngineCapabilities()
+{
+    EngineVersions::instance()->clear();
+    // the state of the compliance mode also depends on the version of GnuPG
+    Kleo::Private::cryptoConfigChanged();
 }
 
 const QString &Kleo::paperKeyInstallPath()
@@ -569,6 +636,10 @@ void Kleo::restartGpgAgent()
         return;
     }
 
+    // the connections to the old agent are useless after the restart
+    Kleo::Assuan::closeIdleConnections();
+    // the configuration may have been changed before the agent was restarted
+    Kleo::refreshEngineCapabilities();
     auto startAgent = []() {
         Kleo::launchGpgAgent(SkipCheckForRunningAgent);
     };
@@ -596,44 +667,40 @@ void Kleo::launchDirmngr()
 
 static const std::vector<std::string> &availableAlgorithmsOpenPGP()
 {
-    static std::vector<std::string> algos;
-    if (algos.empty()) {
-        algos.reserve(13);
-        algos = {
-            "brainpoolP256r1",
-            "brainpoolP384r1",
-            "brainpoolP512r1",
-            "curve25519",
-            "curve448",
-            "nistp256",
-            "nistp384",
-            "nistp521",
-            "rsa2048",
-            "rsa3072",
-            "rsa4096",
-            // "secp256k1", // Curve secp256k1 is explicitly ignored
-        };
-        if (Kleo::engineIsVersion(2, 5, 2)) {
-            algos.insert(algos.end(),
-                         {
-                             "ky768_bp256",
-                             "ky1024_bp384",
-                         });
-        }
-    }
-    return algos;
+    // both lists are initialized once in a thread-safe way; the references
+    // returned to the callers stay valid if the engine versions are refreshed
+    static const std::vector<std::string> algos = {
+        "brainpoolP256r1",
+        "brainpoolP384r1",
+        "brainpoolP512r1",
+        "curve25519",
+        "curve448",
+        "nistp256",
+        "nistp384",
+        "nistp521",
+        "rsa2048",
+        "rsa3072",
+        "rsa4096",
+        // "secp256k1", // Curve secp256k1 is explicitly ignored
+    };
+    static const std::vector<std::string> algosWithPQC = [](std::vector<std::string> algos) {
+        algos.insert(algos.end(),
+                     {
+                         "ky768_bp256",
+                         "ky1024_bp384",
+                     });
+        return algos;
+    }(algos);
+    return Kleo::engineIsVersion(2, 5, 2) ? algosWithPQC : algos;
 }
 
 static const std::vector<std::string> &availableAlgorithmsCMS()
 {
-    static std::vector<std::string> algos;
-    if (algos.empty()) {
-        algos = {
-            "rsa2048",
-            "rsa3072",
-            "rsa4096",
-        };
-    }
+    static const std::vector<std::string> algos = {
+        "rsa2048",
+        "rsa3072",
+        "rsa4096",
+    };
     return algos;
 }
 
@@ -679,18 +746,13 @@ bool Kleo::gpgvVerify(const QString &filePath, const QString &sigPath, const QSt
         qCDebug(LIBKLEO_LOG) << "Verifying" << filePath;
     }
 
-    const auto gpgvPath = QStandardPaths::findExecutable(QStringLiteral("gpgv"), additionalSearchPaths);
+    const auto gpgvPath = Kleo::Private::findGpgv(additionalSearchPaths);
     if (gpgvPath.isEmpty()) {
         qCDebug(LIBKLEO_LOG) << "Could not find gpgv";
         return false;
     }
 
-    QFileInfo sigFi;
-    if (!sigPath.isEmpty()) {
-        sigFi.setFile(sigPath);
-    } else {
-        sigFi.setFile(filePath + QStringLiteral(".sig"));
-    }
+    const QFileInfo sigFi{Kleo::Private::gpgvSignaturePath(filePath, sigPath)};
 
     if (!sigFi.isReadable()) {
         qCDebug(LIBKLEO_LOG) << "No signature found at" << sigFi.absoluteFilePath();
@@ -699,11 +761,7 @@ bool Kleo::gpgvVerify(const QString &filePath, const QString &sigPath, const QSt
 
     auto process = QProcess();
     process.setProgram(gpgvPath);
-    QStringList args;
-    if (!keyring.isEmpty()) {
-        args << QStringLiteral("--keyring") << keyring;
-    }
-    args << QStringLiteral("--") << sigFi.absoluteFilePath() << verifyFi.absoluteFilePath();
+    const QStringList args = Kleo::Private::gpgvArguments(keyring, sigFi.absoluteFilePath(), verifyFi.absoluteFilePath());
     process.setArguments(args);
     qCDebug(LIBKLEO_LOG).nospace() << "Starting gpgv (" << gpgvPath << ") with arguments " << args.join(QLatin1Char(' ')) << " ...";
     process.start();
@@ -43,7 +43,8 @@ KLEO_EXPORT const QString &paperKeyInstallPath();
  * searched for first.
  *
  * Blocks until the verification is done which can be indefinetly to
- * allow for very large files.
+ * allow for very large files. Use Kleo::GpgvVerifier to verify files
+ * without blocking or to verify many files in parallel.
  *
  * Returns true if the verification was successful, false if any problem
  * occured. */
@@ -64,6 +65,17 @@ KLEO_EXPORT int makeGnuPGError(int code);
 
 KLEO_EXPORT bool engineIsVersion(int major, int minor, int patch, GpgME::Engine = GpgME::GpgConfEngine);
 
+/** Discards the cached versions of the GnuPG engines, so that they are queried
+ *  again when they are needed next, and invalidates the state of the compliance
+ *  mode and the other values derived from the crypto config.
+ *  This is called by restartGpgAgent().
+ *  \note gpgme determines the versions of the engines only once per process.
+ *  Therefore, an upgrade of GnuPG is only recognized after a restart of the
+ *  application.
+ *  \sa engineIsVersion, availableAlgorithms, Kleo::DeVSCompliance::isActive
+ */
+KLEO_EXPORT void refreshEngineCapabilities();
+
 /** Returns true, if GnuPG knows which keyserver to use for keyserver
  *  operations.
  *
@@ -0,0 +1,308 @@
+/*
+    This file is part of libkleopatra
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-libkleo.h>
+
+#include "gpgvverifier.h"
+
+#include "gpgvverifier_p.h"
+
+#include <libkleo_debug.h>
+
+#include <KLocalizedString>
+
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QThread>
+
+#include <algorithm>
+#include <unordered_map>
+
+using namespace Kleo;
+
+QString Kleo::Private::findGpgv(const QStringList &additionalSearchPaths)
+{
+    static QMutex mutex;
+    static QHash<QStringList, QString> cachedPaths;
+
+    {
+        QMutexLocker locker{&mutex};
+        const auto it = cachedPaths.constFind(additionalSearchPaths);
+        if (it != cachedPaths.cend()) {
+            if (QFileInfo{*it}.isExecutable()) {
+                return *it;
+            }
+            // gpgv was removed (e.g. by an update); search it again
+            cachedPaths.erase(it);
+        }
+    }
+
+    const QString path = additionalSearchPaths.isEmpty() //
+        ? QStandardPaths::findExecutable(QStringLiteral("gpgv"))
+        : QStandardPaths::findExecutable(QStringLiteral("gpgv"), additionalSearchPaths);
+    if (!path.isEmpty()) {
+        // don't remember a failed search; gpgv may be installed later
+        QMutexLocker locker{&mutex};
+        cachedPaths.insert(additionalSearchPaths, path);
+    }
+    return path;
+}
+
+QString Kleo::Private::gpgvSignaturePath(const QString &filePath, const QString &signaturePath)
+{
+    return signaturePath.isEmpty() ? filePath + QStringLiteral(".sig") : signaturePath;
+}
+
+QStringList Kleo::Private::gpgvArguments(const QString &keyring, const QString &signaturePath, const QString &filePath)
+{
+    QStringList args;
+    if (!keyring.isEmpty()) {
+        args << QStringLiteral("--keyring") << keyring;
+    }
+    args << QStringLiteral("--") << QFileInfo{signaturePath}.absoluteFilePath() << QFileInfo{filePath}.absoluteFilePath();
+    return args;
+}
+
+class GpgvVerifier::Private
+{
+    friend class ::Kleo::GpgvVerifier;
+    GpgvVerifier *const q;
+
+public:
+    Private(GpgvVerifier *qq)
+        : q{qq}
+    {
+    }
+
+    ~Private()
+    {
+        // make sure that the processes don't report to the destroyed verifier
+        for (const auto &[index, process] : mProcesses) {
+            QObject::disconnect(process, nullptr, q, nullptr);
+            delete process;
+        }
+    }
+
+private:
+    void start(const std::vector<Task> &tasks);
+    void cancel();
+    void startNextProcesses();
+    bool checkFiles(Result &result);
+    void startProcess(std::size_t index);
+    void processFinished(std::size_t index, QProcess *process);
+    void finishIfDone();
+
+private:
+    QString mKeyring;
+    QStringList mAdditionalSearchPaths;
+    int mMaxConcurrentProcesses = QThread::idealThreadCount();
+    bool mRunning = false;
+    QString mGpgvPath;
+    std::vector<Result> mResults;
+    std::size_t mNextIndex = 0;
+    // the running gpgv processes by the index of the file they verify
+    std::unordered_map<std::size_t, QProcess *> mProcesses;
+};
+
+void GpgvVerifier::Private::start(const std::vector<Task> &tasks)
+{
+    if (mRunning) {
+        qCDebug(LIBKLEO_LOG) << "GpgvVerifier: The verification is already running";
+        return;
+    }
+    mRunning = true;
+    mResults.clear();
+    mResults.reserve(tasks.size());
+    for (const auto &task : tasks) {
+        mResults.push_back({.filePath = task.filePath, .signaturePath = Kleo::Private::gpgvSignaturePath(task.filePath, task.signaturePath)});
+    }
+    mNextIndex = 0;
+    mGpgvPath = Kleo::Private::findGpgv(mAdditionalSearchPaths);
+    if (mGpgvPath.isEmpty()) {
+        qCDebug(LIBKLEO_LOG) << "Could not find gpgv";
+    }
+    // start the processes from the event loop, so that all signals are emitted asynchronously
+    QMetaObject::invokeMethod(
+        q,
+        [this]() {
+            startNextProcesses();
+        },
+        Qt::QueuedConnection);
+}
+
+void GpgvVerifier::Private::cancel()
+{
+    if (!mRunning) {
+        return;
+    }
+    for (auto index = mNextIndex; index < mResults.size(); ++index) {
+        mResults[index].canceled = true;
+    }
+    mNextIndex = mResults.size();
+    for (const auto &[index, process] : mProcesses) {
+        mResults[index].canceled = true;
+        process->kill();
+    }
+    // without running processes there is nothing to wait for
+    finishIfDone();
+}
+
+void GpgvVerifier::Private::startNextProcesses()
+{
+    while (mNextIndex < mResults.size() && static_cast<int>(mProcesses.size()) < std::max(mMaxConcurrentProcesses, 1)) {
+        const auto index = mNextIndex++;
+        if (!checkFiles(mResults[index])) {
+            Q_EMIT q->fileVerified(static_cast<int>(index));
+            continue;
+        }
+        startProcess(index);
+    }
+    finishIfDone();
+}
+
+bool GpgvVerifier::Private::checkFiles(Result &result)
+{
+    if (mGpgvPath.isEmpty()) {
+        result.errorString = i18nc("@info", "Could not find gpgv.");
+        return false;
+    }
+    if (!QFileInfo{result.filePath}.isReadable()) {
+        qCDebug(LIBKLEO_LOG) << "GpgvVerifier:" << result.filePath << "is not readable";
+        result.errorString = i18nc("@info", "The file %1 is not readable.", result.filePath);
+        return false;
+    }
+    if (!QFileInfo{result.signaturePath}.isReadable()) {
+        qCDebug(LIBKLEO_LOG) << "No signature found at" << result.signaturePath;
+        result.errorString = i18nc("@info", "The signature %1 is not readable.", result.signaturePath);
+        return false;
+    }
+    return true;
+}
+
+void GpgvVerifier::Private::startProcess(std::size_t index)
+{
+    const auto &result = mResults[index];
+    auto process = new QProcess{q};
+    process->setProgram(mGpgvPath);
+    process->setArguments(Kleo::Private::gpgvArguments(mKeyring, result.signaturePath, result.filePath));
+    // collect the output while gpgv is running, so that the pipes don't fill up
+    QObject::connect(process, &QProcess::readyReadStandardOutput, q, [this, index, process]() {
+        mResults[index].standardOutput += process->readAllStandardOutput();
+    });
+    QObject::connect(process, &QProcess::readyReadStandardError, q, [this, index, process]() {
+        mResults[index].standardError += process->readAllStandardError();
+    });
+    QObject::connect(process, &QProcess::finished, q, [this, index, process]() {
+        processFinished(index, process);
+    });
+    QObject::connect(process, &QProcess::errorOccurred, q, [this, index, process](QProcess::ProcessError error) {
+        // finished() isn't emitted if the process couldn't be started
+        if (error == QProcess::FailedToStart) {
+            processFinished(index, process);
+        }
+    });
+    mProcesses.emplace(index, process);
+    qCDebug(LIBKLEO_LOG).nospace() << "Starting gpgv (" << mGpgvPath << ") with arguments " << process->arguments().join(QLatin1Char(' ')) << " ...";
+    process->start();
+}
+
+void GpgvVerifier::Private::processFinished(std::size_t index, QProcess *process)
+{
+    if (mProcesses.erase(index) == 0) {
+        return;
+    }
+    auto &result = mResults[index];
+    result.standardOutput += process->readAllStandardOutput();
+    result.standardError += process->readAllStandardError();
+    if (process->error() == QProcess::FailedToStart) {
+        qCDebug(LIBKLEO_LOG) << "Failed to execute gpgv" << process->errorString();
+        result.errorString = process->errorString();
+    } else if (process->exitStatus() == QProcess::NormalExit) {
+        result.exitCode = process->exitCode();
+        result.verified = !result.canceled && result.exitCode == 0;
+    }
+    if (!result.verified && !result.canceled) {
+        qCDebug(LIBKLEO_LOG) << "Failed to verify file" << result.filePath;
+        qCDebug(LIBKLEO_LOG) << "gpgv stderr:" << QString::fromUtf8(result.standardError);
+    }
+    process->deleteLater();
+
+    Q_EMIT q->fileVerified(static_cast<int>(index));
+    startNextProcesses();
+}
+
+void GpgvVerifier::Private::finishIfDone()
+{
+    if (!mRunning || mNextIndex < mResults.size() || !mProcesses.empty()) {
+        return;
+    }
+    mRunning = false;
+    Q_EMIT q->finished();
+}
+
+GpgvVerifier::GpgvVerifier(QObject *parent)
+    : QObject{parent}
+    , d{new Private{this}}
+{
+}
+
+GpgvVerifier::~GpgvVerifier() = default;
+
+void GpgvVerifier::setKeyring(const QString &keyring)
+{
+    d->mKeyring = keyring;
+}
+
+QString GpgvVerifier::keyring() const
+{
+    return d->mKeyring;
+}
+
+void GpgvVerifier::setAdditionalSearchPaths(const QStringList &additionalSearchPaths)
+{
+    d->mAdditionalSearchPaths = additionalSearchPaths;
+}
+
+QStringList GpgvVerifier::additionalSearchPaths() const
+{
+    return d->mAdditionalSearchPaths;
+}
+
+void GpgvVerifier::setMaxConcurrentProcesses(int maxConcurrentProcesses)
+{
+    d->mMaxConcurrentProcesses = maxConcurrentProcesses;
+}
+
+int GpgvVerifier::maxConcurrentProcesses() const
+{
+    return d->mMaxConcurrentProcesses;
+}
+
+void GpgvVerifier::start(const std::vector<Task> &tasks)
+{
+    d->start(tasks);
+}
+
+void GpgvVerifier::cancel()
+{
+    d->cancel();
+}
+
+bool GpgvVerifier::isRunning() const
+{
+    return d->mRunning;
+}
+
+std::vector<GpgvVerifier::Result> GpgvVerifier::results() const
+{
+    return d->mResults;
+}
+
+#include "moc_gpgvverifier.cpp"
@@ -0,0 +1,131 @@
+/*
+    This file is part of libkleopatra
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "kleo_export.h"
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+#include <vector>
+
+namespace Kleo
+{
+
+/**
+ * Verifies detached signatures of files with gpgv without blocking the
+ * calling thread.
+ *
+ * In contrast to Kleo::gpgvVerify() any number of files can be verified
+ * with one GpgvVerifier. Up to maxConcurrentProcesses() gpgv processes are
+ * run at the same time. The output of gpgv is collected while the processes
+ * are running. fileVerified() is emitted whenever the verification of a file
+ * has completed and finished() is emitted when all files have been verified
+ * or the verification was canceled.
+ *
+ * Example:
+ * \code
+ * auto verifier = new GpgvVerifier{this};
+ * verifier->setKeyring(keyring);
+ * connect(verifier, &GpgvVerifier::finished, this, [verifier]() {
+ *     for (const auto &result : verifier->results()) {
+ *         if (!result.verified) {
+ *             reportBadDownload(result.filePath);
+ *         }
+ *     }
+ *     verifier->deleteLater();
+ * });
+ * verifier->start({{.filePath = installerPath}, {.filePath = archivePath, .signaturePath = archiveSignaturePath}});
+ * \endcode
+ */
+class KLEO_EXPORT GpgvVerifier : public QObject
+{
+    Q_OBJECT
+public:
+    struct Task {
+        QString filePath;
+        /// the detached signature; filePath + ".sig" if empty
+        QString signaturePath;
+    };
+
+    struct Result {
+        QString filePath;
+        QString signaturePath;
+        /// true, if gpgv reported a good signature
+        bool verified = false;
+        /// true, if the verification was canceled before gpgv completed
+        bool canceled = false;
+        /// the exit code of gpgv or -1 if gpgv wasn't run or crashed
+        int exitCode = -1;
+        /// the reason why gpgv couldn't be run (e.g. a missing signature)
+        QString errorString;
+        QByteArray standardOutput;
+        QByteArray standardError;
+    };
+
+    explicit GpgvVerifier(QObject *parent = nullptr);
+    ~GpgvVerifier() override;
+
+    /**
+     * Sets the keyring the signatures are checked against. If no keyring is
+     * set, then gpgv uses its default keyring.
+     */
+    void setKeyring(const QString &keyring);
+    QString keyring() const;
+
+    /**
+     * Sets the folders gpgv is searched in. If no folders are set, then gpgv
+     * is searched in the folders of the PATH like gpgvVerify() does it.
+     */
+    void setAdditionalSearchPaths(const QStringList &additionalSearchPaths);
+    QStringList additionalSearchPaths() const;
+
+    /**
+     * Sets the maximum number of gpgv processes that are run at the same time.
+     * The default is QThread::idealThreadCount().
+     */
+    void setMaxConcurrentProcesses(int maxConcurrentProcesses);
+    int maxConcurrentProcesses() const;
+
+    /**
+     * Starts verifying the signatures of the files given by @p tasks. Does
+     * nothing if a verification is already running. The signals are emitted
+     * asynchronously, i.e. not before the control returns to the event loop.
+     */
+    void start(const std::vector<Task> &tasks);
+
+    /**
+     * Cancels the verification. Running gpgv processes are killed and the files
+     * that haven't been verified yet are marked as canceled. finished() is emitted
+     * when the killed processes have terminated or immediately if no gpgv process
+     * is running.
+     */
+    void cancel();
+
+    bool isRunning() const;
+
+    /**
+     * Returns the results of the verification in the same order as the tasks.
+     * The results of files that haven't been verified yet are incomplete.
+     */
+    std::vector<Result> results() const;
+
+Q_SIGNALS:
+    /** Emitted when the verification of the file with the given @p index has completed. */
+    void fileVerified(int index);
+    void finished();
+
+private:
+    class Private;
+    std::unique_ptr<Private> const d;
+};
+
+}
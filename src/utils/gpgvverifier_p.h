@@ -0,0 +1,38 @@
+/*
+    This file is part of libkleopatra
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+namespace Kleo::Private
+{
+
+/**
+ * Returns the path of gpgv. If @p additionalSearchPaths is empty, then gpgv
+ * is searched in the folders of the PATH. Otherwise, gpgv is only searched in
+ * @p additionalSearchPaths. Returns an empty string if gpgv wasn't found.
+ * The found path is cached per list of search paths as long as it points to
+ * an executable; failed searches are not cached.
+ * This function is thread-safe.
+ */
+QString findGpgv(const QStringList &additionalSearchPaths);
+
+/**
+ * Returns the path of the detached signature of the file @p filePath, i.e.
+ * @p signaturePath or, if it is empty, @p filePath with ".sig" appended.
+ */
+QString gpgvSignaturePath(const QString &filePath, const QString &signaturePath);
+
+/**
+ * Returns the arguments for verifying the file @p filePath with the signature
+ * @p signaturePath with gpgv. @p keyring is optional.
+ */
+QStringList gpgvArguments(const QString &keyring, const QString &signaturePath, const QString &filePath);
+
+}
@@ -16,91 +16,164 @@
 #include <QByteArray>
 #include <QString>
 
+#include <algorithm>
+#include <array>
+
 using namespace Kleo;
 
-static unsigned char unhex(unsigned char ch)
+namespace
 {
-    if (ch >= '0' && ch <= '9') {
-        return ch - '0';
+constexpr unsigned char invalidHexValue = 0xFF;
+
+// maps the hex digits to their values and all other characters to invalidHexValue
+constexpr auto hexValues = []() {
+    std::array<unsigned char, 256> values{};
+    for (auto &value : values) {
+        value = invalidHexValue;
     }
-    if (ch >= 'A' && ch <= 'F') {
-        return ch - 'A' + 10;
+    for (int ch = '0'; ch <= '9'; ++ch) {
+        values[ch] = ch - '0';
     }
-    if (ch >= 'a' && ch <= 'f') {
-        return ch - 'a' + 10;
+    for (int ch = 'A'; ch <= 'F'; ++ch) {
+        values[ch] = ch - 'A' + 10;
     }
-    const char cch = ch;
-    throw Kleo::Exception(gpg_error(GPG_ERR_ASS_SYNTAX), i18n("Invalid hex char '%1' in input stream.", QString::fromLatin1(&cch, 1)));
-}
-
-std::string Kleo::hexdecode(const std::string &in)
+    for (int ch = 'a'; ch <= 'f'; ++ch) {
+        values[ch] = ch - 'a' + 10;
+    }
+    return values;
+}();
+
+enum EncodingClass : unsigned char {
+    Copy,
+    EncodeAsPlus,
+    PercentEncode,
+};
+
+// the encoding of all characters as done by hexencode()
+constexpr auto encodingClasses = []() {
+    std::array<unsigned char, 256> classes{};
+    for (int ch = 0; ch < 256; ++ch) {
+        if ((ch >= '!' && ch <= '~') || ch > 0xA0) {
+            classes[ch] = Copy;
+        } else {
+            // space and all non-printable characters
+            classes[ch] = EncodeAsPlus;
+        }
+    }
+    for (const unsigned char ch : {'"', '#', '$', '%', '\'', '+', '='}) {
+        classes[ch] = PercentEncode;
+    }
+    return classes;
+}();
+
+enum class DecodeResult {
+    Ok,
+    PrematureEnd,
+    InvalidHexChar,
+};
+
+// appends the decoded input to out; runs of characters that don't need to be
+// decoded are appended at once
+DecodeResult percentDecode(std::string_view in, std::string &out, char &invalidChar)
 {
-    std::string result;
-    result.reserve(in.size());
-    for (std::string::const_iterator it = in.begin(), end = in.end(); it != end; ++it) {
-        if (*it == '%') {
+    out.reserve(out.size() + in.size());
+    auto it = in.begin();
+    const auto end = in.end();
+    while (it != end) {
+        const auto runEnd = std::find_if(it, end, [](char ch) {
+            return ch == '%' || ch == '+';
+        });
+        out.append(it, runEnd);
+        it = runEnd;
+        if (it == end) {
+            break;
+        }
+        if (*it == '+') {
+            out.push_back(' ');
             ++it;
-            unsigned char ch = '\0';
-            if (it == end) {
-                throw Exception(gpg_error(GPG_ERR_ASS_SYNTAX), i18n("Premature end of hex-encoded char in input stream"));
-            }
-            ch |= unhex(*it) << 4;
+            continue;
+        }
+        // percent-encoded char
+        unsigned char values[2];
+        for (auto &value : values) {
             ++it;
             if (it == end) {
-                throw Exception(gpg_error(GPG_ERR_ASS_SYNTAX), i18n("Premature end of hex-encoded char in input stream"));
+                return DecodeResult::PrematureEnd;
+            }
+            value = hexValues[static_cast<unsigned char>(*it)];
+            if (value == invalidHexValue) {
+                invalidChar = *it;
+                return DecodeResult::InvalidHexChar;
             }
-            ch |= unhex(*it);
-            result.push_back(ch);
-        } else if (*it == '+') {
-            result += ' ';
-        } else {
-            result.push_back(*it);
         }
+        out.push_back(static_cast<char>((values[0] << 4) | values[1]));
+        ++it;
     }
-    return result;
+    return DecodeResult::Ok;
 }
 
-std::string Kleo::hexencode(const std::string &in)
+std::string percentDecodeOrThrow(std::string_view in)
 {
     std::string result;
-    result.reserve(3 * in.size());
+    char invalidChar = '\0';
+    switch (percentDecode(in, result, invalidChar)) {
+    case DecodeResult::Ok:
+        break;
+    case DecodeResult::PrematureEnd:
+        throw Exception(gpg_error(GPG_ERR_ASS_SYNTAX), i18n("Premature end of hex-encoded char in input stream"));
+    case DecodeResult::InvalidHexChar:
+        throw Kleo::Exception(gpg_error(GPG_ERR_ASS_SYNTAX), i18n("Invalid hex char '%1' in input stream.", QString::fromLatin1(&invalidChar, 1)));
+    }
+    return result;
+}
 
+std::string percentEncode(std::string_view in)
+{
     static const char hex[] = "0123456789ABCDEF";
 
-    for (std::string::const_iterator it = in.begin(), end = in.end(); it != end; ++it) {
-        switch (const unsigned char ch = *it) {
-        default:
-            if ((ch >= '!' && ch <= '~') || ch > 0xA0) {
-                result += ch;
-                break;
-            }
-        // else fall through
-        case ' ':
-            result += '+';
+    std::string result;
+    result.reserve(3 * in.size());
+    auto it = in.begin();
+    const auto end = in.end();
+    while (it != end) {
+        const auto runEnd = std::find_if(it, end, [](char ch) {
+            return encodingClasses[static_cast<unsigned char>(ch)] != Copy;
+        });
+        result.append(it, runEnd);
+        it = runEnd;
+        if (it == end) {
             break;
-        case '"':
-        case '#':
-        case '$':
-        case '%':
-        case '\'':
-        case '+':
-        case '=':
+        }
+        const unsigned char ch = *it;
+        if (encodingClasses[ch] == EncodeAsPlus) {
+            result += '+';
+        } else {
             result += '%';
             result += hex[(ch & 0xF0) >> 4];
             result += hex[(ch & 0x0F)];
-            break;
         }
+        ++it;
     }
-
     return result;
 }
+}
+
+std::string Kleo::hexdecode(const std::string &in)
+{
+    return percentDecodeOrThrow(in);
+}
+
+std::string Kleo::hexencode(const std::string &in)
+{
+    return percentEncode(in);
+}
 
 std::string Kleo::hexdecode(const char *in)
 {
     if (!in) {
         return std::string();
     }
-    return hexdecode(std::string(in));
+    return percentDecodeOrThrow(in);
 }
 
 std::string Kleo::hexencode(const char *in)
@@ -108,7 +181,7 @@ std::string Kleo::hexencode(const char *in)
     if (!in) {
         return std::string();
     }
-    return hexencode(std::string(in));
+    return percentEncode(in);
 }
 
 QByteArray Kleo::hexdecode(const QByteArray &in)
@@ -116,7 +189,7 @@ QByteArray Kleo::hexdecode(const QByteArray &in)
     if (in.isNull()) {
         return QByteArray();
     }
-    const std::string result = hexdecode(std::string(in.constData()));
+    const std::string result = percentDecodeOrThrow(in.constData());
     return QByteArray(result.data(), result.size());
 }
 
@@ -125,6 +198,34 @@ QByteArray Kleo::hexencode(const QByteArray &in)
     if (in.isNull()) {
         return QByteArray();
     }
-    const std::string result = hexencode(std::string(in.constData()));
+    const std::string result = percentEncode(in.constData());
     return QByteArray(result.data(), result.size());
 }
+
+std::optional<std::string> Kleo::tryHexdecode(std::string_view in)
+{
+    std::string result;
+    char invalidChar;
+    if (percentDecode(in, result, invalidChar) != DecodeResult::Ok) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+std::optional<std::string> Kleo::hexToBinary(std::string_view hex)
+{
+    if (hex.size() % 2 != 0) {
+        return std::nullopt;
+    }
+    std::string result(hex.size() / 2, '\0');
+    for (std::size_t i = 0; i < result.size(); ++i) {
+        const unsigned char high = hexValues[static_cast<unsigned char>(hex[2 * i])];
+        const unsigned char low = hexValues[static_cast<unsigned char>(hex[2 * i + 1])];
+        if ((high | low) & 0xF0) {
+            // at least one of the characters is not a hex digit
+            return std::nullopt;
+        }
+        result[i] = static_cast<char>((high << 4) | low);
+    }
+    return result;
+}
@@ -9,7 +9,9 @@
 
 #include "kleo_export.h"
 
+#include <optional>
 #include <string>
+#include <string_view>
 
 class QByteArray;
 
@@ -25,4 +27,16 @@ KLEO_EXPORT std::string hexdecode(const std::string &s);
 KLEO_EXPORT QByteArray hexencode(const QByteArray &s);
 KLEO_EXPORT QByteArray hexdecode(const QByteArray &s);
 
+/**
+ * Non-throwing variant of hexdecode().
+ * Returns std::nullopt if @a s is not validly percent-encoded.
+ */
+KLEO_EXPORT std::optional<std::string> tryHexdecode(std::string_view s);
+
+/**
+ * Converts the plain hex string @a hex (e.g. a fingerprint) to binary.
+ * Returns std::nullopt if @a hex has an odd length or contains non-hex characters.
+ */
+KLEO_EXPORT std::optional<std::string> hexToBinary(std::string_view hex);
+
 }
@@ -0,0 +1,82 @@
+/*
+    This file is part of libkleopatra, the KDE keymanagement library
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QMutex>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace Kleo
+{
+
+namespace Private
+{
+
+/**
+ * Calls @a function for all indexes in [0, @a count) and waits until all
+ * calls have finished. The indexes are split into at most one contiguous
+ * chunk per ideal thread with at least @a minimumChunkSize indexes each. If
+ * this results in a single chunk, then @a function is called sequentially
+ * in the calling thread. Otherwise, the chunks are processed by the calling
+ * thread and by threads of the global thread pool; the calling thread only
+ * waits for chunks which are in progress, so that this can also be used from
+ * a thread of the global thread pool. @a function must be safe to call
+ * concurrently for different indexes.
+ */
+template<typename Function>
+void forEachIndexInParallel(std::size_t count, Function &&function, std::size_t minimumChunkSize = 1)
+{
+    const std::size_t maximumNumberOfChunks = std::max(1, QThread::idealThreadCount());
+    const std::size_t numberOfChunks = std::min(maximumNumberOfChunks, count / std::max<std::size_t>(minimumChunkSize, 1));
+    if (numberOfChunks <= 1) {
+        for (std::size_t i = 0; i < count; ++i) {
+            function(i);
+        }
+        return;
+    }
+    const std::size_t chunkSize = (count + numberOfChunks - 1) / numberOfChunks;
+
+    struct State {
+        std::atomic<std::size_t> nextChunk = 0;
+        QMutex mutex;
+        QWaitCondition allChunksFinished;
+        std::size_t finishedChunks = 0;
+    };
+    // tasks which start after all chunks have been claimed only access the state
+    const auto state = std::make_shared<State>();
+    const auto processChunks = [state, &function, count, chunkSize, numberOfChunks]() {
+        for (std::size_t chunk = state->nextChunk++; chunk < numberOfChunks; chunk = state->nextChunk++) {
+            const std::size_t end = std::min((chunk + 1) * chunkSize, count);
+            for (std::size_t i = chunk * chunkSize; i < end; ++i) {
+                function(i);
+            }
+            QMutexLocker locker{&state->mutex};
+            if (++state->finishedChunks == numberOfChunks) {
+                state->allChunksFinished.wakeAll();
+            }
+        }
+    };
+    for (std::size_t i = 1; i < numberOfChunks; ++i) {
+        QThreadPool::globalInstance()->start(processChunks);
+    }
+    processChunks();
+
+    QMutexLocker locker{&state->mutex};
+    while (state->finishedChunks < numberOfChunks) {
+        state->allChunksFinished.wait(&state->mutex);
+    }
+}
+
+}
+}
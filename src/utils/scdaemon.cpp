@@ -12,6 +12,7 @@
 
 #include "algorithm.h"
 #include "assuan.h"
+#include "assuan_p.h"
 #include "hex.h"
 #include "stringutils.h"
 
@@ -21,25 +22,22 @@
 #include <QGpgME/Debug>
 #endif
 
-#include <gpgme++/context.h>
+#include <gpgme++/defaultassuantransaction.h>
+#include <gpgme++/error.h>
 
 using namespace Kleo;
 using namespace GpgME;
 
 std::vector<std::string> Kleo::SCDaemon::getReaders(Error &err)
 {
-    auto c = Context::createForEngine(AssuanEngine, &err);
-    if (err) {
-        qCDebug(LIBKLEO_LOG) << "Creating context for Assuan engine failed:" << err;
-        return {};
-    }
-
-    auto assuanContext = std::shared_ptr<Context>(c.release());
+    // use a pooled connection because this is called repeatedly, e.g. when smartcards are polled
     const std::string command = "SCD GETINFO reader_list";
-    const std::string readers = Assuan::sendDataCommand(assuanContext, command, err);
-    if (err) {
+    const auto t = Assuan::Private::transactWithPooledConnection(command, std::make_unique<DefaultAssuanTransaction>(), err, true, &Assuan::Private::sleep);
+    if (err || !t) {
+        qCDebug(LIBKLEO_LOG) << __func__ << command << "failed:" << err;
         return {};
     }
+    const std::string readers = static_cast<DefaultAssuanTransaction *>(t.get())->data();
 
     std::vector<std::string_view> tmp = Kleo::split(readers, '\n');
     // remove empty entries; in particular, the last entry
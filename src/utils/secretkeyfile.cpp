@@ -0,0 +1,132 @@
+/*
+    This file is part of libkleopatra, the KDE keymanagement library
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-libkleo.h>
+
+#include "secretkeyfile_p.h"
+
+#include "gnupg.h"
+
+#include <libkleo_debug.h>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+
+#include <unordered_map>
+
+using namespace Kleo;
+
+namespace
+{
+std::vector<QByteArray> scanFile(const QString &path)
+{
+    QFile file{path};
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCDebug(LIBKLEO_LOG) << "Cannot open the private key file" << path << "for reading";
+        return {};
+    }
+    const qint64 size = file.size();
+    if (size == 0) {
+        qCDebug(LIBKLEO_LOG) << "The private key file" << path << "is empty";
+        return {};
+    }
+    if (uchar *data = file.map(0, size)) {
+        auto lines = SecretKeyFile::scanCardTokenLines(QByteArrayView{reinterpret_cast<const char *>(data), static_cast<qsizetype>(size)});
+        file.unmap(data);
+        return lines;
+    }
+    qCDebug(LIBKLEO_LOG) << "Cannot map the private key file" << path << "into memory:" << file.errorString();
+    return SecretKeyFile::scanCardTokenLines(file.readAll());
+}
+
+class Cache
+{
+public:
+    static Cache *instance()
+    {
+        static Cache *self = new Cache();
+        return self;
+    }
+
+    std::vector<QByteArray> cardTokenLines(const QString &keyGrip)
+    {
+        const QString path = QDir{gnupgPrivateKeysDirectory()}.filePath(keyGrip + QLatin1StringView(".key"));
+        const QFileInfo info{path};
+        if (!info.exists()) {
+            qCDebug(LIBKLEO_LOG) << "The private key file" << path << "does not exist";
+            QMutexLocker locker{&mMutex};
+            mEntries.erase(path);
+            return {};
+        }
+        const QDateTime lastModified = info.lastModified();
+        const qint64 size = info.size();
+        {
+            QMutexLocker locker{&mMutex};
+            const auto it = mEntries.find(path);
+            if (it != mEntries.end() && it->second.lastModified == lastModified && it->second.size == size) {
+                return it->second.lines;
+            }
+        }
+
+        // scan the file without holding the lock
+        auto lines = scanFile(path);
+
+        QMutexLocker locker{&mMutex};
+        mEntries.insert_or_assign(path, Entry{lastModified, size, lines});
+        return lines;
+    }
+
+private:
+    struct Entry {
+        QDateTime lastModified;
+        qint64 size = 0;
+        std::vector<QByteArray> lines;
+    };
+
+    QMutex mMutex;
+    // the results keyed by the path of the private key file
+    std::unordered_map<QString, Entry> mEntries;
+};
+}
+
+std::vector<QByteArray> SecretKeyFile::cardTokenLines(const QString &keyGrip)
+{
+    if (keyGrip.isEmpty()) {
+        return {};
+    }
+    return Cache::instance()->cardTokenLines(keyGrip);
+}
+
+std::vector<QByteArray> SecretKeyFile::scanCardTokenLines(QByteArrayView content)
+{
+    std::vector<QByteArray> lines;
+    // files in the old format consist of a single S-expression which has no room for tokens
+    if (content.startsWith('(')) {
+        return lines;
+    }
+    qsizetype pos = 0;
+    while (pos < content.size()) {
+        qsizetype end = content.indexOf('\n', pos);
+        if (end < 0) {
+            end = content.size();
+        }
+        QByteArrayView line = content.sliced(pos, end - pos);
+        pos = end + 1;
+        // continuation lines (e.g. of the Key item) start with white space and are skipped by this check
+        if (!line.startsWith("Token:")) {
+            continue;
+        }
+        if (line.endsWith('\r')) {
+            line.chop(1);
+        }
+        lines.push_back(line.toByteArray());
+    }
+    return lines;
+}
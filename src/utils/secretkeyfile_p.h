@@ -0,0 +1,48 @@
+/*
+    This file is part of libkleopatra, the KDE keymanagement library
+    SPDX-FileCopyrightText: 2026 g10 Code GmbH
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+
+#include <vector>
+
+namespace Kleo
+{
+
+/**
+ * Scanning of the private key files of gpg-agent for card tokens.
+ *
+ * The "Token" lines of a private key file tell on which smart cards the key
+ * is stored. KeyCache needs them for all secret subkeys on every update of
+ * the cache. The results are cached per key file and are only computed again
+ * if the modification time or the size of the file changed.
+ */
+namespace SecretKeyFile
+{
+
+/**
+ * Returns the "Token" lines (without line break) of the private key file
+ * for the keygrip @a keyGrip. Returns an empty list if the file doesn't
+ * exist or if the key isn't stored on a card.
+ * This function is thread-safe.
+ */
+std::vector<QByteArray> cardTokenLines(const QString &keyGrip);
+
+/**
+ * Returns the "Token" lines (without line break) of the content @a content
+ * of a private key file. Continuation lines are skipped without looking at
+ * them, and files in the old S-expression format aren't scanned at all
+ * because they cannot contain tokens.
+ */
+std::vector<QByteArray> scanCardTokenLines(QByteArrayView content);
+
+}
+
+}
@@ -10,12 +10,27 @@
 
 #include "test.h"
 
+#include "assuancommand_p.h"
 #include "cryptoconfig_p.h"
 
+#include <QMutex>
 #include <QString>
+#include <QWaitCondition>
 
 using namespace Kleo::Tests;
 
+FakeCryptoConfigBoolValue::FakeCryptoConfigBoolValue(const char *componentName, const char *entryName, bool fakeValue)
+    : mComponentName(componentName)
+    , mEntryName(entryName)
+{
+    Kleo::Private::setFakeCryptoConfigBoolValue(mComponentName, mEntryName, fakeValue);
+}
+
+FakeCryptoConfigBoolValue::~FakeCryptoConfigBoolValue()
+{
+    Kleo::Private::clearFakeCryptoConfigBoolValue(mComponentName, mEntryName);
+}
+
 FakeCryptoConfigIntValue::FakeCryptoConfigIntValue(const char *componentName, const char *entryName, int fakeValue)
     : mComponentName(componentName)
     , mEntryName(entryName)
@@ -39,3 +54,117 @@ FakeCryptoConfigStringValue::~FakeCryptoConfigStringValue()
 {
     Kleo::Private::clearFakeCryptoConfigStringValue(mComponentName, mEntryName);
 }
+
+AssuanRetriesOnHold::AssuanRetriesOnHold()
+{
+    Kleo::Private::setAssuanCommandRetriesOnHold(true);
+}
+
+AssuanRetriesOnHold::~AssuanRetriesOnHold()
+{
+    Kleo::Private::setAssuanCommandRetriesOnHold(false);
+}
+
+void AssuanRetriesOnHold::release()
+{
+    Kleo::Private::releaseAssuanCommandRetries();
+}
+
+int AssuanRetriesOnHold::waitCount() const
+{
+    return Kleo::Private::assuanCommandRetryWaitCount();
+}
+
+int AssuanRetriesOnHold::waitingCommands() const
+{
+    return Kleo::Private::assuanCommandsWaitingForRetry();
+}
+
+namespace
+{
+std::vector<Kleo::Private::CryptoConfigValue> toCryptoConfigValues(const std::vector<FakeGpgConf::Option> &options)
+{
+    using Kleo::Private::CryptoConfigValue;
+    std::vector<CryptoConfigValue> values;
+    values.reserve(options.size());
+    for (const auto &option : options) {
+        CryptoConfigValue value{option.componentName, option.entryName};
+        if (const auto boolValue = std::get_if<bool>(&option.value)) {
+            value.type = CryptoConfigValue::Bool;
+            value.boolValue = *boolValue;
+        } else if (const auto intValue = std::get_if<int>(&option.value)) {
+            value.type = CryptoConfigValue::Int;
+            value.intValue = *intValue;
+        } else {
+            value.type = CryptoConfigValue::String;
+            value.stringValue = std::get<QString>(option.value);
+        }
+        values.push_back(value);
+    }
+    return values;
+}
+}
+
+class FakeGpgConf::Private
+{
+public:
+    std::vector<Kleo::Private::CryptoConfigValue> load()
+    {
+        QMutexLocker locker{&mutex};
+        while (!unblocked && finishedLoads == 0) {
+            condition.wait(&mutex);
+        }
+        if (finishedLoads > 0) {
+            --finishedLoads;
+        }
+        ++loadCount;
+        return values;
+    }
+
+    std::vector<Kleo::Private::CryptoConfigValue> values;
+    mutable QMutex mutex;
+    QWaitCondition condition;
+    int finishedLoads = 0;
+    int loadCount = 0;
+    bool unblocked = false;
+};
+
+FakeGpgConf::FakeGpgConf(const std::vector<Option> &options)
+    : d{std::make_shared<Private>()}
+{
+    d->values = toCryptoConfigValues(options);
+    Kleo::Private::setCryptoConfigLoader([d = d]() {
+        return d->load();
+    });
+}
+
+FakeGpgConf::~FakeGpgConf()
+{
+    Kleo::Private::setCryptoConfigLoader({});
+    // don't block a load which is still in progress
+    QMutexLocker locker{&d->mutex};
+    d->unblocked = true;
+    d->condition.wakeAll();
+}
+
+void FakeGpgConf::setOptions(const std::vector<Option> &options)
+{
+    {
+        QMutexLocker locker{&d->mutex};
+        d->values = toCryptoConfigValues(options);
+    }
+    Kleo::Private::cryptoConfigChanged();
+}
+
+void FakeGpgConf::finishLoading()
+{
+    QMutexLocker locker{&d->mutex};
+    ++d->finishedLoads;
+    d->condition.wakeAll();
+}
+
+int FakeGpgConf::loadCount() const
+{
+    QMutexLocker locker{&d->mutex};
+    return d->loadCount;
+}
@@ -10,9 +10,12 @@
 
 #include "kleo_export.h"
 
-#include <string>
+#include <QString>
 
-class QString;
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
 
 namespace Kleo
 {
@@ -20,6 +23,17 @@ namespace Kleo
 namespace Tests
 {
 
+class KLEO_EXPORT FakeCryptoConfigBoolValue
+{
+public:
+    FakeCryptoConfigBoolValue(const char *componentName, const char *entryName, bool fakeValue);
+    ~FakeCryptoConfigBoolValue();
+
+private:
+    std::string mComponentName;
+    std::string mEntryName;
+};
+
 class KLEO_EXPORT FakeCryptoConfigIntValue
 {
 public:
@@ -42,6 +56,75 @@ private:
     std::string mEntryName;
 };
 
+/**
+ * Puts the retries of AssuanCommand for connecting to the agent on hold while
+ * an instance of this class exists, i.e. instead of waiting for the retry
+ * delay the commands wait until release() is called or until they are
+ * canceled. This allows testing the behavior while waiting for the agent
+ * without depending on timing.
+ */
+class KLEO_EXPORT AssuanRetriesOnHold
+{
+public:
+    AssuanRetriesOnHold();
+    ~AssuanRetriesOnHold();
+
+    /**
+     * Lets the commands which are currently waiting retry once.
+     */
+    void release();
+
+    /**
+     * Returns how often commands started to wait for a retry.
+     */
+    int waitCount() const;
+
+    /**
+     * Returns the number of commands which are currently waiting for a retry.
+     */
+    int waitingCommands() const;
+};
+
+/**
+ * Stand-in for gpgconf which is used for preloading the crypto config (see
+ * Kleo::preloadCryptoConfig()) while an instance of this class exists.
+ * It reports the given options. Loading the crypto config doesn't finish
+ * before finishLoading() is called, so that the behavior while loading can
+ * be tested.
+ */
+class KLEO_EXPORT FakeGpgConf
+{
+public:
+    struct Option {
+        std::string componentName;
+        std::string entryName;
+        std::variant<bool, int, QString> value;
+    };
+
+    explicit FakeGpgConf(const std::vector<Option> &options);
+    ~FakeGpgConf();
+
+    /**
+     * Replaces the reported options and tells libkleo that the configuration
+     * has changed, i.e. it simulates a modification of the configuration files.
+     */
+    void setOptions(const std::vector<Option> &options);
+
+    /**
+     * Lets one pending or future loading of the crypto config finish.
+     */
+    void finishLoading();
+
+    /**
+     * Returns how often the crypto config was loaded with this stand-in.
+     */
+    int loadCount() const;
+
+private:
+    class Private;
+    std::shared_ptr<Private> d;
+};
+
 }
 
 }